@@ -0,0 +1,50 @@
+# Turns compiled SPIR-V into a header of constexpr arrays, so the engine can load its shaders without touching the
+# filesystem. Run as a script by the Shaders target:
+#   cmake -DOUTPUT=<header> -DSPIRV_FILES=<a.spv|b.spv|...> -P EmbedShaders.cmake
+
+string(REPLACE "|" ";" SPIRV_FILES "${SPIRV_FILES}")
+list(LENGTH SPIRV_FILES SHADER_COUNT)
+
+## the index is searched by file name, so sort on that rather than on the whole path
+set(FILE_NAMES "")
+foreach (SPIRV ${SPIRV_FILES})
+    get_filename_component(FILE_NAME ${SPIRV} NAME)
+    list(APPEND FILE_NAMES ${FILE_NAME})
+    set(SPIRV_PATH_${FILE_NAME} ${SPIRV})
+endforeach (SPIRV)
+list(SORT FILE_NAMES)
+
+## 8 words to a line, spelled out as string(REPEAT) needs CMake 3.15
+set(WORD "0x[0-9a-f]+, ")
+set(LINE "${WORD}${WORD}${WORD}${WORD}${WORD}${WORD}${WORD}${WORD}")
+
+set(ARRAYS "")
+set(INDEX "")
+foreach (FILE_NAME ${FILE_NAMES})
+    set(SPIRV ${SPIRV_PATH_${FILE_NAME}})
+    string(MAKE_C_IDENTIFIER "${FILE_NAME}" IDENTIFIER)
+    string(TOUPPER "EMBEDDED_${IDENTIFIER}" IDENTIFIER)
+
+    ## glslang writes little endian words, so flip each group of 4 bytes into a word, 8 words to a line
+    file(READ ${SPIRV} HEX HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])"
+            "0x\\4\\3\\2\\1, " WORDS "${HEX}")
+    string(REGEX REPLACE "(${LINE})" "\\1\n    " WORDS "${WORDS}")
+    string(REPLACE " \n" "\n" WORDS "${WORDS}")
+    string(STRIP "${WORDS}" WORDS)
+
+    string(APPEND ARRAYS "inline constexpr uint32_t ${IDENTIFIER}[] = {\n    ${WORDS}\n};\n\n")
+    string(APPEND INDEX "    EmbeddedShader{\"${FILE_NAME}\", ${IDENTIFIER}, sizeof(${IDENTIFIER})},\n")
+endforeach (FILE_NAME)
+
+set(HEADER "// generated from the compiled shaders by cmake/EmbedShaders.cmake, don't edit\n")
+string(APPEND HEADER "#pragma once\n\n#include <array>\n#include <cstdint>\n\nnamespace vulkan_engine\n{\n")
+string(APPEND HEADER "${ARRAYS}")
+string(APPEND HEADER "// sorted by name\n")
+string(APPEND HEADER "inline constexpr std::array<EmbeddedShader, ${SHADER_COUNT}> EMBEDDED_SHADERS = {\n${INDEX}};\n")
+string(APPEND HEADER "} // namespace vulkan_engine\n")
+
+## only touch the header when the shaders actually changed, so nothing recompiles needlessly
+file(WRITE "${OUTPUT}.tmp" "${HEADER}")
+configure_file("${OUTPUT}.tmp" "${OUTPUT}" COPYONLY)
+file(REMOVE "${OUTPUT}.tmp")
@@ -1,10 +1,13 @@
 #version 450
 
+// vertex shader input
+layout (location = 0) in vec3 inColour;
+
 // output write
 layout (location = 0) out vec4 outFragColour;
 
 void main()
 {
-    // return red
-    outFragColour = vec4(1.0f, 0.0f, 0.0f, 1.0f);
+    // return the colour the vertex shader picked
+    outFragColour = vec4(inColour, 1.0f);
 }
\ No newline at end of file
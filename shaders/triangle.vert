@@ -1,5 +1,19 @@
 #version 450
 
+// picks between the rainbow and the plain red triangle. It is a specialisation constant, so each variant gets its own
+// pipeline compiled with the unused side of the branch stripped out
+layout (constant_id = 0) const bool USE_VERTEX_COLOURS = false;
+
+// per-draw data, written into the frame allocator as each draw is recorded and bound with a dynamic offset
+layout (set = 0, binding = 0) uniform DrawData
+{
+    vec2 offset; // in clip space
+    vec2 scale;
+} drawData;
+
+//output variable to the fragment shader
+layout (location = 0) out vec3 outColor;
+
 void main()
 {
     // const array of positions for the triangle
@@ -9,6 +23,23 @@ void main()
     vec3(0.0f, -1.0f, 0.0f)
     );
 
+    // const array of colours for each of the triangle's vertices
+    const vec3 colours[3] = vec3[3](
+    vec3(1.0f, 0.0f, 0.0f), // red
+    vec3(0.0f, 1.0f, 0.0f), // green
+    vec3(0.0f, 0.0f, 1.0f)// blue
+    );
+
     // output the position of each vertex
-    gl_Position = vec4(positions[gl_VertexIndex], 1.0f);
+    gl_Position = vec4(positions[gl_VertexIndex].xy * drawData.scale + drawData.offset, 0.0f, 1.0f);
+
+    // update out colour
+    if (USE_VERTEX_COLOURS)
+    {
+        outColor = colours[gl_VertexIndex];
+    }
+    else
+    {
+        outColor = vec3(1.0f, 0.0f, 0.0f); // red
+    }
 }
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vulkan_engine
+{
+// value rounded up to the next multiple of alignment, which must not be 0
+inline uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace vulkan_engine
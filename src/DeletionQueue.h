@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace vulkan_engine
+{
+// Holds on to clean-up work for GPU objects that frames in flight may still reference. Each entry is tagged with the
+// last frame that could have used the object and only runs once that frame has finished on the GPU, so nothing ever
+// has to wait for the device to go idle
+class DeletionQueue
+{
+  public:
+    void push(int64_t lastUsedFrame, std::function<void()> &&deleter)
+    {
+        _entries.emplace_back(lastUsedFrame, std::move(deleter));
+    }
+
+    // run (and forget) every deleter whose frame has completed
+    void flush(int64_t completedFrame)
+    {
+        auto first_pending = std::stable_partition(_entries.begin(), _entries.end(), [=](const auto &entry) {
+            return entry.first <= completedFrame;
+        });
+
+        for (auto it = _entries.begin(); it != first_pending; ++it)
+        {
+            it->second();
+        }
+
+        _entries.erase(_entries.begin(), first_pending);
+    }
+
+    // run everything, only valid once the device is idle
+    void flush_all()
+    {
+        for (auto &entry : _entries)
+        {
+            entry.second();
+        }
+
+        _entries.clear();
+    }
+
+  private:
+    std::vector<std::pair<int64_t, std::function<void()>>> _entries;
+};
+} // namespace vulkan_engine
@@ -0,0 +1,24 @@
+#include "DeviceExtensions.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vulkan_engine
+{
+std::vector<VkExtensionProperties> supported_device_extensions(VkPhysicalDevice physicalDevice)
+{
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extension_count, extensions.data());
+
+    return extensions;
+}
+
+bool has_device_extension(const std::vector<VkExtensionProperties> &extensions, const char *name)
+{
+    return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties &extension) {
+        return std::strcmp(extension.extensionName, name) == 0;
+    });
+}
+} // namespace vulkan_engine
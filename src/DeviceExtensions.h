@@ -0,0 +1,13 @@
+#pragma once
+
+#include "VulkanTypes.h"
+
+#include <vector>
+
+namespace vulkan_engine
+{
+// every extension physicalDevice supports
+std::vector<VkExtensionProperties> supported_device_extensions(VkPhysicalDevice physicalDevice);
+
+bool has_device_extension(const std::vector<VkExtensionProperties> &extensions, const char *name);
+} // namespace vulkan_engine
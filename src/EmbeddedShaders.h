@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace vulkan_engine
+{
+// a compiled shader built into the executable
+struct EmbeddedShader
+{
+    std::string_view name; // the .spv file it came from, e.g. "triangle.vert.spv"
+    const uint32_t *code;
+    size_t size; // in bytes
+};
+} // namespace vulkan_engine
+
+// generated by the Shaders target from every compiled shader, defines EMBEDDED_SHADERS
+#include "EmbeddedShaderBundle.h"
+
+namespace vulkan_engine
+{
+// the compiled-in shader built from the .spv file called name, or null if there isn't one. Works at compile time too,
+// so a shader the engine can't do without can be checked for with a static_assert
+constexpr const EmbeddedShader *find_embedded_shader(std::string_view name)
+{
+    // EMBEDDED_SHADERS is sorted by name, so binary search it
+    size_t first = 0;
+    size_t last = EMBEDDED_SHADERS.size();
+    while (first < last)
+    {
+        const size_t middle = first + (last - first) / 2;
+        if (EMBEDDED_SHADERS[middle].name < name)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+    return first < EMBEDDED_SHADERS.size() && EMBEDDED_SHADERS[first].name == name ? &EMBEDDED_SHADERS[first] : nullptr;
+}
+} // namespace vulkan_engine
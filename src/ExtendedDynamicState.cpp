@@ -0,0 +1,210 @@
+#include "ExtendedDynamicState.h"
+
+#include <VkBootstrap.h>
+
+#include "DeviceExtensions.h"
+#include "VulkanInitialisers.h"
+
+namespace vulkan_engine
+{
+namespace
+{
+// with dynamic topology the pipeline only fixes the topology class, any topology within it can be set when recording
+VkPrimitiveTopology topology_class_representative(VkPrimitiveTopology topology)
+{
+    switch (topology)
+    {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+        return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+        return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+        return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+    default:
+        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    }
+}
+} // namespace
+
+std::vector<const char *> ExtendedDynamicState::desired_extensions()
+{
+    return {VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME,
+            VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME};
+}
+
+void ExtendedDynamicState::enable_supported_features(VkPhysicalDevice physicalDevice,
+                                                     vkb::DeviceBuilder &deviceBuilder)
+{
+    // vk-bootstrap only enables the desired extensions the device has, so check for ourselves which ones those are
+    const std::vector<VkExtensionProperties> extensions = supported_device_extensions(physicalDevice);
+
+    _extended_dynamic_state_features = {}; // initialise struct to 0's
+    _extended_dynamic_state_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    _extended_dynamic_state2_features = {}; // initialise struct to 0's
+    _extended_dynamic_state2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+    _extended_dynamic_state3_features = {}; // initialise struct to 0's
+    _extended_dynamic_state3_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+
+    // only chain in the structs for extensions that exist, querying an unknown struct is invalid
+    VkPhysicalDeviceFeatures2 supported_features = {}; // initialise struct to 0's
+    supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    void **next = &supported_features.pNext;
+    if (has_device_extension(extensions, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME))
+    {
+        *next = &_extended_dynamic_state_features;
+        next = &_extended_dynamic_state_features.pNext;
+    }
+    if (has_device_extension(extensions, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME))
+    {
+        *next = &_extended_dynamic_state2_features;
+        next = &_extended_dynamic_state2_features.pNext;
+    }
+    if (has_device_extension(extensions, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME))
+    {
+        *next = &_extended_dynamic_state3_features;
+        next = &_extended_dynamic_state3_features.pNext;
+    }
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supported_features);
+
+    _extended_dynamic_state = _extended_dynamic_state_features.extendedDynamicState;
+    _extended_dynamic_state2 = _extended_dynamic_state2_features.extendedDynamicState2;
+    _dynamic_polygon_mode = _extended_dynamic_state3_features.extendedDynamicState3PolygonMode;
+
+    // enable exactly what we are going to use, and nothing else
+    if (_extended_dynamic_state)
+    {
+        _extended_dynamic_state_features = {}; // initialise struct to 0's
+        _extended_dynamic_state_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+        _extended_dynamic_state_features.extendedDynamicState = VK_TRUE;
+        deviceBuilder.add_pNext(&_extended_dynamic_state_features);
+    }
+
+    if (_extended_dynamic_state2)
+    {
+        _extended_dynamic_state2_features = {}; // initialise struct to 0's
+        _extended_dynamic_state2_features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+        _extended_dynamic_state2_features.extendedDynamicState2 = VK_TRUE;
+        deviceBuilder.add_pNext(&_extended_dynamic_state2_features);
+    }
+
+    if (_dynamic_polygon_mode)
+    {
+        _extended_dynamic_state3_features = {}; // initialise struct to 0's
+        _extended_dynamic_state3_features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+        _extended_dynamic_state3_features.extendedDynamicState3PolygonMode = VK_TRUE;
+        deviceBuilder.add_pNext(&_extended_dynamic_state3_features);
+    }
+}
+
+void ExtendedDynamicState::load_functions(VkDevice device)
+{
+    if (_extended_dynamic_state)
+    {
+        _cmd_set_cull_mode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT");
+        _cmd_set_front_face = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(device, "vkCmdSetFrontFaceEXT");
+        _cmd_set_primitive_topology =
+            (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveTopologyEXT");
+        _cmd_set_depth_test_enable =
+            (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT");
+        _cmd_set_depth_write_enable =
+            (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT");
+        _cmd_set_depth_compare_op =
+            (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT");
+    }
+
+    if (_extended_dynamic_state2)
+    {
+        _cmd_set_primitive_restart_enable =
+            (PFN_vkCmdSetPrimitiveRestartEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveRestartEnableEXT");
+        _cmd_set_rasterizer_discard_enable =
+            (PFN_vkCmdSetRasterizerDiscardEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetRasterizerDiscardEnableEXT");
+        _cmd_set_depth_bias_enable =
+            (PFN_vkCmdSetDepthBiasEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthBiasEnableEXT");
+    }
+
+    if (_dynamic_polygon_mode)
+    {
+        _cmd_set_polygon_mode = (PFN_vkCmdSetPolygonModeEXT)vkGetDeviceProcAddr(device, "vkCmdSetPolygonModeEXT");
+    }
+}
+
+void ExtendedDynamicState::configure_pipeline(PipelineBuilder &builder, const RasterState &state) const
+{
+    bake_pipeline_state(builder, state);
+
+    // replace anything that will be set dynamically with a fixed value, the driver ignores it anyway
+    if (_extended_dynamic_state)
+    {
+        builder.dynamic_states.insert(builder.dynamic_states.end(),
+                                      {VK_DYNAMIC_STATE_CULL_MODE, VK_DYNAMIC_STATE_FRONT_FACE,
+                                       VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+                                       VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP});
+
+        builder.rasteriser.cullMode = VK_CULL_MODE_NONE;
+        builder.rasteriser.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        builder.input_assembly.topology = topology_class_representative(state.topology);
+        builder.depth_stencil.depthTestEnable = VK_FALSE;
+        builder.depth_stencil.depthWriteEnable = VK_FALSE;
+        builder.depth_stencil.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+    }
+
+    if (_extended_dynamic_state2)
+    {
+        builder.dynamic_states.insert(builder.dynamic_states.end(),
+                                      {VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE,
+                                       VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE, VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE});
+    }
+
+    if (_dynamic_polygon_mode)
+    {
+        builder.dynamic_states.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+        builder.rasteriser.polygonMode = VK_POLYGON_MODE_FILL;
+    }
+}
+
+void ExtendedDynamicState::bake_pipeline_state(PipelineBuilder &builder, const RasterState &state)
+{
+    // viewport and scissor are always set when recording, so a resized swapchain doesn't need new pipelines
+    builder.dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+    builder.input_assembly = vulkan_engine::initialisers::input_assembly_create_info(state.topology);
+
+    builder.rasteriser = vulkan_engine::initialisers::rasterisation_state_create_info(state.polygon_mode);
+    builder.rasteriser.cullMode = state.cull_mode;
+    builder.rasteriser.frontFace = state.front_face;
+
+    builder.depth_stencil = vulkan_engine::initialisers::depth_stencil_create_info(state.depth_test, state.depth_write,
+                                                                                   state.depth_compare_op);
+}
+
+void ExtendedDynamicState::apply(VkCommandBuffer commandBuffer, const RasterState &state) const
+{
+    if (_extended_dynamic_state)
+    {
+        _cmd_set_cull_mode(commandBuffer, state.cull_mode);
+        _cmd_set_front_face(commandBuffer, state.front_face);
+        _cmd_set_primitive_topology(commandBuffer, state.topology);
+        _cmd_set_depth_test_enable(commandBuffer, state.depth_test ? VK_TRUE : VK_FALSE);
+        _cmd_set_depth_write_enable(commandBuffer, state.depth_write ? VK_TRUE : VK_FALSE);
+        _cmd_set_depth_compare_op(commandBuffer, state.depth_test ? state.depth_compare_op : VK_COMPARE_OP_ALWAYS);
+    }
+
+    if (_extended_dynamic_state2)
+    {
+        // these are dynamic once the extension is in use, so they have to be set even though we never change them
+        _cmd_set_primitive_restart_enable(commandBuffer, VK_FALSE);
+        _cmd_set_rasterizer_discard_enable(commandBuffer, VK_FALSE);
+        _cmd_set_depth_bias_enable(commandBuffer, VK_FALSE);
+    }
+
+    if (_dynamic_polygon_mode)
+    {
+        _cmd_set_polygon_mode(commandBuffer, state.polygon_mode);
+    }
+}
+} // namespace vulkan_engine
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "PipelineBuilder.h"
+#include "VulkanTypes.h"
+
+#include <vector>
+
+namespace vkb
+{
+class DeviceBuilder;
+}
+
+namespace vulkan_engine
+{
+// the rasterisation state a draw wants. Depending on what the device supports, each part is either set while
+// recording or baked into the pipeline
+struct RasterState
+{
+    VkPolygonMode polygon_mode{VK_POLYGON_MODE_FILL};
+    VkCullModeFlags cull_mode{VK_CULL_MODE_NONE};
+    VkFrontFace front_face{VK_FRONT_FACE_CLOCKWISE};
+    VkPrimitiveTopology topology{VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST};
+    bool depth_test{false};
+    bool depth_write{false};
+    VkCompareOp depth_compare_op{VK_COMPARE_OP_LESS_OR_EQUAL};
+};
+
+// Wraps VK_EXT_extended_dynamic_state, _2 and _3 (polygon mode only). Whatever the device supports is made dynamic,
+// so pipelines that only differ in that state collapse into one and the state is set on the command buffer instead.
+// Without the extensions everything still works, it just needs a pipeline per raster state.
+class ExtendedDynamicState
+{
+  public:
+    // the device extensions to ask vk-bootstrap for, they are only enabled when available
+    static std::vector<const char *> desired_extensions();
+
+    // check what the physical device supports and chain the matching feature structs into the device. This object
+    // must outlive deviceBuilder.build()
+    void enable_supported_features(VkPhysicalDevice physicalDevice, vkb::DeviceBuilder &deviceBuilder);
+
+    // load the extension entry points once the device exists
+    void load_functions(VkDevice device);
+
+    // set up builder for state, leaving anything dynamic at a fixed default so equivalent pipelines share a key
+    void configure_pipeline(PipelineBuilder &builder, const RasterState &state) const;
+
+    // bake all of state into builder, as if nothing beyond viewport and scissor was dynamic
+    static void bake_pipeline_state(PipelineBuilder &builder, const RasterState &state);
+
+    // record the dynamic parts of state. Must be called in every command buffer that draws, including secondaries
+    void apply(VkCommandBuffer commandBuffer, const RasterState &state) const;
+
+    bool has_extended_dynamic_state() const
+    {
+        return _extended_dynamic_state;
+    }
+
+    bool has_extended_dynamic_state2() const
+    {
+        return _extended_dynamic_state2;
+    }
+
+    bool has_dynamic_polygon_mode() const
+    {
+        return _dynamic_polygon_mode;
+    }
+
+  private:
+    bool _extended_dynamic_state{false};
+    bool _extended_dynamic_state2{false};
+    bool _dynamic_polygon_mode{false};
+
+    // chained into device creation, so they live as long as this object
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT _extended_dynamic_state_features{};
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT _extended_dynamic_state2_features{};
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT _extended_dynamic_state3_features{};
+
+    PFN_vkCmdSetCullModeEXT _cmd_set_cull_mode{nullptr};
+    PFN_vkCmdSetFrontFaceEXT _cmd_set_front_face{nullptr};
+    PFN_vkCmdSetPrimitiveTopologyEXT _cmd_set_primitive_topology{nullptr};
+    PFN_vkCmdSetDepthTestEnableEXT _cmd_set_depth_test_enable{nullptr};
+    PFN_vkCmdSetDepthWriteEnableEXT _cmd_set_depth_write_enable{nullptr};
+    PFN_vkCmdSetDepthCompareOpEXT _cmd_set_depth_compare_op{nullptr};
+    PFN_vkCmdSetPrimitiveRestartEnableEXT _cmd_set_primitive_restart_enable{nullptr};
+    PFN_vkCmdSetRasterizerDiscardEnableEXT _cmd_set_rasterizer_discard_enable{nullptr};
+    PFN_vkCmdSetDepthBiasEnableEXT _cmd_set_depth_bias_enable{nullptr};
+    PFN_vkCmdSetPolygonModeEXT _cmd_set_polygon_mode{nullptr};
+};
+} // namespace vulkan_engine
@@ -0,0 +1,79 @@
+#include "FrameAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "Alignment.h"
+
+namespace vulkan_engine
+{
+
+bool FrameAllocator::init(GpuAllocator *gpuAllocator, const VkPhysicalDeviceLimits &limits, uint32_t frameCount,
+                          VkDeviceSize frameSize)
+{
+    _gpu_allocator = gpuAllocator;
+    _frame_count = frameCount;
+
+    // every allocation is rounded up to the alignment, so as long as each region starts aligned every offset handed
+    // out is too, without any fix-up on the hot path. Both limits are powers of two, the larger is a multiple of both
+    _alignment = std::max<VkDeviceSize>(
+        {limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, 1});
+    _frame_size = align_up(frameSize, _alignment);
+
+    VkBufferCreateInfo buffer_info = {}; // initialise struct to 0's
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = _frame_size * frameCount;
+    buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (!_gpu_allocator->create_buffer(buffer_info, MemoryPool::uniform, &_buffer) || _buffer.mapped == nullptr)
+    {
+        std::cout << "Failed to create the " << buffer_info.size << " byte per-frame data buffer" << std::endl;
+        cleanup();
+        return false;
+    }
+
+    begin_frame(0);
+    return true;
+}
+
+void FrameAllocator::cleanup()
+{
+    if (_buffer.buffer != VK_NULL_HANDLE)
+    {
+        _gpu_allocator->destroy_buffer(_buffer);
+    }
+    _buffer = {};
+}
+
+void FrameAllocator::begin_frame(uint32_t frameIndex)
+{
+    _peak_usage = std::max(_peak_usage, std::min<VkDeviceSize>(_frame_used, _frame_size));
+    _frame_start = _frame_size * (frameIndex % _frame_count);
+    _frame_used = 0;
+}
+
+bool FrameAllocator::allocate(VkDeviceSize size, FrameAllocation *outAllocation)
+{
+    const VkDeviceSize aligned_size = align_up(size, _alignment);
+    const VkDeviceSize offset = _frame_used.fetch_add(aligned_size, std::memory_order_relaxed);
+    if (offset + aligned_size > _frame_size)
+    {
+        _failed_allocations++;
+        return false;
+    }
+
+    outAllocation->data = static_cast<char *>(_buffer.mapped) + _frame_start + offset;
+    outAllocation->offset = static_cast<uint32_t>(_frame_start + offset);
+    return true;
+}
+
+void FrameAllocator::flush()
+{
+    const VkDeviceSize used = std::min<VkDeviceSize>(_frame_used, _frame_size);
+    if (used > 0)
+    {
+        _gpu_allocator->flush(_buffer, _frame_start, used);
+    }
+}
+} // namespace vulkan_engine
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "GpuAllocator.h"
+#include "VulkanTypes.h"
+
+#include <atomic>
+#include <cstring>
+
+namespace vulkan_engine
+{
+// a block of per-frame data, valid until the frame it was allocated in has finished on the GPU
+struct FrameAllocation
+{
+    void *data{nullptr}; // where to write it, in mapped memory
+    uint32_t offset{0};  // the dynamic offset to bind it with
+};
+
+// Hands out the uniform and storage data shaders read each frame, e.g. per-draw transforms. One persistently mapped
+// buffer from the uniform pool is split into a region per frame in flight, and each region is a linear allocator:
+// allocating is a single atomic add, and the whole region is reset at once when its frame slot comes round again (by
+// which point the GPU has finished reading it). Shaders see the data through a dynamic uniform or storage buffer
+// descriptor pointing at buffer(), with the allocation's offset passed to vkCmdBindDescriptorSets, so one descriptor
+// set serves every draw of every frame.
+//
+// allocate() may be called from any thread, e.g. by the workers recording secondary command buffers, and never locks
+// or allocates memory. begin_frame() and flush() are only called from the main thread, when nothing is allocating.
+class FrameAllocator
+{
+  public:
+    // frameSize is how much each frame may allocate, any more than that fails. Offsets are aligned for both uniform
+    // and storage buffer descriptors
+    bool init(GpuAllocator *gpuAllocator, const VkPhysicalDeviceLimits &limits, uint32_t frameCount,
+              VkDeviceSize frameSize);
+
+    void cleanup();
+
+    // start allocating from the region for this frame slot, throwing away whatever it held. The GPU must have finished
+    // the last frame that used the slot
+    void begin_frame(uint32_t frameIndex);
+
+    // size bytes from the current frame's region, false once it is full
+    bool allocate(VkDeviceSize size, FrameAllocation *outAllocation);
+
+    // allocate space for value and copy it in
+    template <typename T> bool push(const T &value, uint32_t *outOffset)
+    {
+        FrameAllocation allocation;
+        if (!allocate(sizeof(T), &allocation))
+        {
+            return false;
+        }
+
+        std::memcpy(allocation.data, &value, sizeof(T));
+        *outOffset = allocation.offset;
+        return true;
+    }
+
+    // make this frame's writes visible to the device, before submitting anything that reads them
+    void flush();
+
+    VkBuffer buffer() const
+    {
+        return _buffer.buffer;
+    }
+
+    // what every offset is a multiple of, enough for both uniform and storage buffer descriptors
+    VkDeviceSize alignment() const
+    {
+        return _alignment;
+    }
+
+    VkDeviceSize frame_size() const
+    {
+        return _frame_size;
+    }
+
+    // the most any frame has used so far, and how many allocations didn't fit
+    VkDeviceSize peak_usage() const
+    {
+        return _peak_usage;
+    }
+
+    uint64_t failed_allocations() const
+    {
+        return _failed_allocations;
+    }
+
+  private:
+    GpuAllocator *_gpu_allocator{nullptr};
+    AllocatedBuffer _buffer;
+
+    VkDeviceSize _alignment{1};
+    VkDeviceSize _frame_size{0};
+    uint32_t _frame_count{0};
+
+    // the current frame's region, and how much of it has been handed out. The latter may run past _frame_size when
+    // allocations fail
+    VkDeviceSize _frame_start{0};
+    std::atomic<VkDeviceSize> _frame_used{0};
+
+    VkDeviceSize _peak_usage{0};
+    std::atomic<uint64_t> _failed_allocations{0};
+};
+} // namespace vulkan_engine
@@ -0,0 +1,309 @@
+// the one translation unit that compiles VMA's implementation
+#define VMA_IMPLEMENTATION
+#include "GpuAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace vulkan_engine
+{
+namespace
+{
+// block sizes are a trade-off between how often we call vkAllocateMemory and how much memory sits unused in the last
+// block of each pool
+constexpr VkDeviceSize VERTEX_INDEX_BLOCK_SIZE = 64ull * 1024 * 1024;
+constexpr VkDeviceSize UNIFORM_BLOCK_SIZE = 16ull * 1024 * 1024;
+constexpr VkDeviceSize STAGING_BLOCK_SIZE = 32ull * 1024 * 1024;
+constexpr VkDeviceSize RENDER_TARGET_BLOCK_SIZE = 128ull * 1024 * 1024;
+
+// anything over this fraction of a block gets memory of its own, it would waste too much of the block it ends up in
+constexpr VkDeviceSize DEDICATED_BLOCK_FRACTION = 2;
+
+double to_mib(VkDeviceSize bytes)
+{
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+} // namespace
+
+void GpuAllocator::init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t apiVersion)
+{
+    _device = device;
+
+    // every vkAllocateMemory and vkFreeMemory VMA makes goes through these, so we can count them
+    VmaDeviceMemoryCallbacks memory_callbacks = {}; // initialise struct to 0's
+    memory_callbacks.pfnAllocate = on_allocate;
+    memory_callbacks.pfnFree = on_free;
+    memory_callbacks.pUserData = this;
+
+    // with 1.1 VMA asks the driver which resources it would rather give dedicated memory, through the core
+    // vkGet*MemoryRequirements2
+    VmaAllocatorCreateInfo allocator_info = {}; // initialise struct to 0's
+    allocator_info.instance = instance;
+    allocator_info.physicalDevice = physicalDevice;
+    allocator_info.device = device;
+    allocator_info.vulkanApiVersion = apiVersion;
+    allocator_info.pDeviceMemoryCallbacks = &memory_callbacks;
+    VK_CHECK(vmaCreateAllocator(&allocator_info, &_allocator));
+
+    // each pool lives in the memory type VMA would pick for a typical resource of its kind
+    VkBufferCreateInfo example_buffer = {}; // initialise struct to 0's
+    example_buffer.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    example_buffer.size = 65536;
+
+    example_buffer.usage =
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    create_pool(MemoryPool::vertex_index, "vertex/index", VMA_MEMORY_USAGE_GPU_ONLY, 0, VERTEX_INDEX_BLOCK_SIZE,
+                &example_buffer, nullptr);
+
+    example_buffer.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    create_pool(MemoryPool::uniform, "uniform", VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                UNIFORM_BLOCK_SIZE, &example_buffer, nullptr);
+
+    example_buffer.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    create_pool(MemoryPool::staging, "staging", VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                STAGING_BLOCK_SIZE, &example_buffer, nullptr);
+
+    VkImageCreateInfo example_image = {}; // initialise struct to 0's
+    example_image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    example_image.imageType = VK_IMAGE_TYPE_2D;
+    example_image.format = VK_FORMAT_R8G8B8A8_UNORM;
+    example_image.extent = {1024, 1024, 1};
+    example_image.mipLevels = 1;
+    example_image.arrayLayers = 1;
+    example_image.samples = VK_SAMPLE_COUNT_1_BIT;
+    example_image.tiling = VK_IMAGE_TILING_OPTIMAL;
+    example_image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    create_pool(MemoryPool::render_target, "render target", VMA_MEMORY_USAGE_GPU_ONLY, 0, RENDER_TARGET_BLOCK_SIZE,
+                nullptr, &example_image);
+}
+
+void GpuAllocator::cleanup()
+{
+    if (_allocator == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    for (Pool &pool : _pools)
+    {
+        if (pool.pool != VK_NULL_HANDLE)
+        {
+            vmaDestroyPool(_allocator, pool.pool);
+            pool.pool = VK_NULL_HANDLE;
+        }
+    }
+
+    vmaDestroyAllocator(_allocator);
+    _allocator = VK_NULL_HANDLE;
+}
+
+void GpuAllocator::create_pool(MemoryPool kind, const char *name, VmaMemoryUsage usage,
+                               VmaAllocationCreateFlags flags, VkDeviceSize blockSize,
+                               const VkBufferCreateInfo *exampleBuffer, const VkImageCreateInfo *exampleImage)
+{
+    Pool &pool = _pools[static_cast<size_t>(kind)];
+    pool.name = name;
+    pool.usage = usage;
+    pool.flags = flags;
+    pool.block_size = blockSize;
+
+    VmaAllocationCreateInfo allocation_info = {}; // initialise struct to 0's
+    allocation_info.usage = usage;
+    allocation_info.flags = flags;
+
+    const VkResult found =
+        exampleBuffer != nullptr
+            ? vmaFindMemoryTypeIndexForBufferInfo(_allocator, exampleBuffer, &allocation_info, &pool.memory_type)
+            : vmaFindMemoryTypeIndexForImageInfo(_allocator, exampleImage, &allocation_info, &pool.memory_type);
+    if (found != VK_SUCCESS)
+    {
+        // everything of this kind goes to VMA's default pools instead
+        std::cout << "No memory type for the " << name << " pool" << std::endl;
+        return;
+    }
+
+    // blocks are only allocated once something needs them, and freed again once empty
+    VmaPoolCreateInfo pool_info = {}; // initialise struct to 0's
+    pool_info.memoryTypeIndex = pool.memory_type;
+    pool_info.blockSize = blockSize;
+    VK_CHECK(vmaCreatePool(_allocator, &pool_info, &pool.pool));
+    vmaSetPoolName(_allocator, pool.pool, name);
+}
+
+VmaAllocationCreateInfo GpuAllocator::allocation_info(Pool &pool, const VkMemoryRequirements &requirements,
+                                                      const VkMemoryDedicatedRequirements &dedicated) const
+{
+    VmaAllocationCreateInfo allocation_info = {}; // initialise struct to 0's
+    allocation_info.usage = pool.usage;
+    allocation_info.flags = pool.flags;
+
+    // the driver knows best, e.g. some want render targets on their own for compression. Otherwise only big
+    // resources are worth a vkAllocateMemory of their own
+    if (dedicated.requiresDedicatedAllocation || dedicated.prefersDedicatedAllocation ||
+        requirements.size > pool.block_size / DEDICATED_BLOCK_FRACTION)
+    {
+        allocation_info.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        pool.dedicated_allocations++;
+        return allocation_info;
+    }
+
+    // e.g. a depth image may not be allowed in the memory type the pool picked for colour images
+    if (pool.pool == VK_NULL_HANDLE || (requirements.memoryTypeBits & (1u << pool.memory_type)) == 0)
+    {
+        pool.fallback_allocations++;
+        return allocation_info;
+    }
+
+    allocation_info.pool = pool.pool;
+    return allocation_info;
+}
+
+bool GpuAllocator::create_buffer(const VkBufferCreateInfo &createInfo, MemoryPool pool, AllocatedBuffer *outBuffer)
+{
+    VkBuffer buffer;
+    if (vkCreateBuffer(_device, &createInfo, nullptr, &buffer) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    VkMemoryDedicatedRequirements dedicated = {}; // initialise struct to 0's
+    dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 requirements = {}; // initialise struct to 0's
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicated;
+
+    VkBufferMemoryRequirementsInfo2 requirements_info = {}; // initialise struct to 0's
+    requirements_info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    requirements_info.buffer = buffer;
+    vkGetBufferMemoryRequirements2(_device, &requirements_info, &requirements);
+
+    const VmaAllocationCreateInfo allocation_create_info =
+        allocation_info(_pools[static_cast<size_t>(pool)], requirements.memoryRequirements, dedicated);
+
+    VmaAllocation allocation;
+    VmaAllocationInfo info;
+    if (vmaAllocateMemoryForBuffer(_allocator, buffer, &allocation_create_info, &allocation, &info) != VK_SUCCESS)
+    {
+        vkDestroyBuffer(_device, buffer, nullptr);
+        return false;
+    }
+
+    if (vmaBindBufferMemory(_allocator, allocation, buffer) != VK_SUCCESS)
+    {
+        vmaFreeMemory(_allocator, allocation);
+        vkDestroyBuffer(_device, buffer, nullptr);
+        return false;
+    }
+
+    outBuffer->buffer = buffer;
+    outBuffer->allocation = allocation;
+    outBuffer->size = createInfo.size;
+    outBuffer->mapped = info.pMappedData;
+    return true;
+}
+
+void GpuAllocator::destroy_buffer(const AllocatedBuffer &buffer)
+{
+    vkDestroyBuffer(_device, buffer.buffer, nullptr);
+    vmaFreeMemory(_allocator, buffer.allocation);
+}
+
+bool GpuAllocator::create_image(const VkImageCreateInfo &createInfo, MemoryPool pool, AllocatedImage *outImage)
+{
+    VkImage image;
+    if (vkCreateImage(_device, &createInfo, nullptr, &image) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    VkMemoryDedicatedRequirements dedicated = {}; // initialise struct to 0's
+    dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 requirements = {}; // initialise struct to 0's
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicated;
+
+    VkImageMemoryRequirementsInfo2 requirements_info = {}; // initialise struct to 0's
+    requirements_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    requirements_info.image = image;
+    vkGetImageMemoryRequirements2(_device, &requirements_info, &requirements);
+
+    const VmaAllocationCreateInfo allocation_create_info =
+        allocation_info(_pools[static_cast<size_t>(pool)], requirements.memoryRequirements, dedicated);
+
+    VmaAllocation allocation;
+    if (vmaAllocateMemoryForImage(_allocator, image, &allocation_create_info, &allocation, nullptr) != VK_SUCCESS)
+    {
+        vkDestroyImage(_device, image, nullptr);
+        return false;
+    }
+
+    if (vmaBindImageMemory(_allocator, allocation, image) != VK_SUCCESS)
+    {
+        vmaFreeMemory(_allocator, allocation);
+        vkDestroyImage(_device, image, nullptr);
+        return false;
+    }
+
+    outImage->image = image;
+    outImage->allocation = allocation;
+    return true;
+}
+
+void GpuAllocator::destroy_image(const AllocatedImage &image)
+{
+    vkDestroyImage(_device, image.image, nullptr);
+    vmaFreeMemory(_allocator, image.allocation);
+}
+
+void GpuAllocator::flush(const AllocatedBuffer &buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    // a no-op for host coherent memory
+    vmaFlushAllocation(_allocator, buffer.allocation, offset, size);
+}
+
+void GpuAllocator::print_stats() const
+{
+    std::cout << "GPU memory: " << _device_memory_count << " device memory allocations (peak "
+              << _peak_device_memory_count << ")" << std::endl;
+
+    for (const Pool &pool : _pools)
+    {
+        std::cout << "  " << pool.name << " pool";
+        if (pool.pool == VK_NULL_HANDLE)
+        {
+            std::cout << ": not created";
+        }
+        else
+        {
+            VmaPoolStats stats;
+            vmaGetPoolStats(_allocator, pool.pool, &stats);
+            std::cout << " (memory type " << pool.memory_type << "): " << stats.allocationCount << " allocations in "
+                      << stats.blockCount << " blocks, " << to_mib(stats.size - stats.unusedSize) << " of "
+                      << to_mib(stats.size) << " MiB used, largest free range " << to_mib(stats.unusedRangeSizeMax)
+                      << " MiB";
+        }
+        std::cout << ", " << pool.dedicated_allocations << " dedicated and " << pool.fallback_allocations
+                  << " outside the pool so far" << std::endl;
+    }
+}
+
+void VKAPI_PTR GpuAllocator::on_allocate(VmaAllocator allocator, uint32_t memoryType, VkDeviceMemory memory,
+                                         VkDeviceSize size, void *userData)
+{
+    auto *gpu_allocator = static_cast<GpuAllocator *>(userData);
+    const uint32_t count = ++gpu_allocator->_device_memory_count;
+
+    uint32_t peak = gpu_allocator->_peak_device_memory_count;
+    while (count > peak && !gpu_allocator->_peak_device_memory_count.compare_exchange_weak(peak, count))
+    {
+    }
+}
+
+void VKAPI_PTR GpuAllocator::on_free(VmaAllocator allocator, uint32_t memoryType, VkDeviceMemory memory,
+                                     VkDeviceSize size, void *userData)
+{
+    static_cast<GpuAllocator *>(userData)->_device_memory_count--;
+}
+} // namespace vulkan_engine
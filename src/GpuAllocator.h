@@ -0,0 +1,112 @@
+#pragma once
+
+#include "VulkanTypes.h"
+
+#include <vk_mem_alloc.h>
+
+#include <array>
+#include <atomic>
+
+namespace vulkan_engine
+{
+// the kinds of memory we allocate, each from a pool of its own
+enum class MemoryPool
+{
+    vertex_index,  // device local vertex and index buffers, filled by transfers
+    uniform,       // host visible uniform buffers, persistently mapped and rewritten every frame
+    staging,       // host visible transfer sources, persistently mapped
+    render_target, // device local colour and depth attachments
+    count
+};
+
+struct AllocatedBuffer
+{
+    VkBuffer buffer{VK_NULL_HANDLE};
+    VmaAllocation allocation{VK_NULL_HANDLE};
+    VkDeviceSize size{0};
+    void *mapped{nullptr}; // set for buffers from the uniform and staging pools
+};
+
+struct AllocatedImage
+{
+    VkImage image{VK_NULL_HANDLE};
+    VmaAllocation allocation{VK_NULL_HANDLE};
+};
+
+// Every buffer and image the engine creates gets its memory through here. Each kind of resource has a VMA pool of large
+// blocks that many resources are sub-allocated from, so vkAllocateMemory is called once per block rather than once per
+// resource (drivers may only allow a few thousand allocations at all). A resource that the driver would rather have
+// memory of its own for, or that is so big it would waste much of a block, gets a dedicated allocation instead.
+// Resources a pool's memory type can't hold fall back to VMA's default pools.
+//
+// VMA is internally synchronised, so resources may be created and destroyed from any thread.
+class GpuAllocator
+{
+  public:
+    void init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t apiVersion);
+
+    // destroy the pools and the allocator. Every resource must have been destroyed by now
+    void cleanup();
+
+    bool create_buffer(const VkBufferCreateInfo &createInfo, MemoryPool pool, AllocatedBuffer *outBuffer);
+    void destroy_buffer(const AllocatedBuffer &buffer);
+
+    bool create_image(const VkImageCreateInfo &createInfo, MemoryPool pool, AllocatedImage *outImage);
+    void destroy_image(const AllocatedImage &image);
+
+    // write the host writes to a mapped buffer out to the device, needed when its memory isn't host coherent
+    void flush(const AllocatedBuffer &buffer, VkDeviceSize offset, VkDeviceSize size);
+
+    // blocks, allocations and bytes in use for each pool, and how many vkAllocateMemory calls they took
+    void print_stats() const;
+
+    // live VkDeviceMemory objects, across the pools, dedicated allocations and VMA's own pools
+    uint32_t device_memory_count() const
+    {
+        return _device_memory_count;
+    }
+
+    VmaAllocator allocator() const
+    {
+        return _allocator;
+    }
+
+  private:
+    struct Pool
+    {
+        const char *name{""};
+        VmaPool pool{VK_NULL_HANDLE};
+        uint32_t memory_type{0};
+        VmaMemoryUsage usage{VMA_MEMORY_USAGE_UNKNOWN};
+        VmaAllocationCreateFlags flags{0};
+        VkDeviceSize block_size{0};
+
+        // how many allocations have bypassed the pool so far, either for dedicated memory or because the pool's memory
+        // type didn't suit
+        std::atomic<uint32_t> dedicated_allocations{0};
+        std::atomic<uint32_t> fallback_allocations{0};
+    };
+
+    // create the pool for one kind of resource in whichever memory type VMA picks for the given example
+    void create_pool(MemoryPool kind, const char *name, VmaMemoryUsage usage, VmaAllocationCreateFlags flags,
+                     VkDeviceSize blockSize, const VkBufferCreateInfo *exampleBuffer,
+                     const VkImageCreateInfo *exampleImage);
+
+    // how to allocate memory with these requirements for the given pool, deciding between the pool itself, a
+    // dedicated allocation and VMA's default pools
+    VmaAllocationCreateInfo allocation_info(Pool &pool, const VkMemoryRequirements &requirements,
+                                            const VkMemoryDedicatedRequirements &dedicated) const;
+
+    static void VKAPI_PTR on_allocate(VmaAllocator allocator, uint32_t memoryType, VkDeviceMemory memory,
+                                      VkDeviceSize size, void *userData);
+    static void VKAPI_PTR on_free(VmaAllocator allocator, uint32_t memoryType, VkDeviceMemory memory,
+                                  VkDeviceSize size, void *userData);
+
+    VkDevice _device{VK_NULL_HANDLE};
+    VmaAllocator _allocator{VK_NULL_HANDLE};
+    std::array<Pool, static_cast<size_t>(MemoryPool::count)> _pools;
+
+    std::atomic<uint32_t> _device_memory_count{0};
+    std::atomic<uint32_t> _peak_device_memory_count{0};
+};
+} // namespace vulkan_engine
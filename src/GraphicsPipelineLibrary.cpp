@@ -0,0 +1,55 @@
+#include "GraphicsPipelineLibrary.h"
+
+#include <VkBootstrap.h>
+
+#include "DeviceExtensions.h"
+
+namespace vulkan_engine
+{
+std::vector<const char *> GraphicsPipelineLibrary::desired_extensions()
+{
+    return {VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME};
+}
+
+void GraphicsPipelineLibrary::enable_supported_features(VkPhysicalDevice physicalDevice,
+                                                        vkb::DeviceBuilder &deviceBuilder)
+{
+    // querying an unknown struct is invalid, so only ask when both extensions exist
+    const std::vector<VkExtensionProperties> extensions = supported_device_extensions(physicalDevice);
+    if (!has_device_extension(extensions, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) ||
+        !has_device_extension(extensions, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME))
+    {
+        return;
+    }
+
+    _features = {}; // initialise struct to 0's
+    _features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 supported_features = {}; // initialise struct to 0's
+    supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported_features.pNext = &_features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supported_features);
+
+    _supported = _features.graphicsPipelineLibrary;
+    if (!_supported)
+    {
+        return;
+    }
+
+    VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT library_properties = {}; // initialise struct to 0's
+    library_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2 properties = {}; // initialise struct to 0's
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &library_properties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    _fast_linking = library_properties.graphicsPipelineLibraryFastLinking;
+
+    // enable exactly what we are going to use, and nothing else
+    _features = {}; // initialise struct to 0's
+    _features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+    _features.graphicsPipelineLibrary = VK_TRUE;
+    deviceBuilder.add_pNext(&_features);
+}
+} // namespace vulkan_engine
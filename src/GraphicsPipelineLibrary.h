@@ -0,0 +1,45 @@
+#pragma once
+
+#include "VulkanTypes.h"
+
+#include <vector>
+
+namespace vkb
+{
+class DeviceBuilder;
+}
+
+namespace vulkan_engine
+{
+// Device support for VK_EXT_graphics_pipeline_library, which lets a pipeline be compiled as four separate parts
+// (vertex input, pre-rasterisation shaders, fragment shader and fragment output) and linked together later. Linking
+// precompiled parts is much cheaper than compiling a whole pipeline, see PipelineRegistry::enable_pipeline_libraries()
+class GraphicsPipelineLibrary
+{
+  public:
+    // the device extensions to ask vk-bootstrap for, they are only enabled when available
+    static std::vector<const char *> desired_extensions();
+
+    // check whether the physical device supports pipeline libraries and if so enable them. This object must outlive
+    // deviceBuilder.build()
+    void enable_supported_features(VkPhysicalDevice physicalDevice, vkb::DeviceBuilder &deviceBuilder);
+
+    bool is_supported() const
+    {
+        return _supported;
+    }
+
+    // whether linking without optimisation is guaranteed to be quick, as opposed to merely quicker than a full compile
+    bool has_fast_linking() const
+    {
+        return _fast_linking;
+    }
+
+  private:
+    bool _supported{false};
+    bool _fast_linking{false};
+
+    // chained into device creation, so it lives as long as this object
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT _features{};
+};
+} // namespace vulkan_engine
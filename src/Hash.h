@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vulkan_engine
+{
+// 64-bit FNV-1a. Quick and good enough to tell files and shaders apart, but not collision resistant, so anything that
+// must never mix two inputs up compares them in full as well
+inline uint64_t hash_bytes(const void *data, size_t size)
+{
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+} // namespace vulkan_engine
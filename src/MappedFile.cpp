@@ -0,0 +1,160 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vulkan_engine
+{
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)),
+      _file(std::exchange(other._file, nullptr)), _mapping(std::exchange(other._mapping, nullptr))
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+        _file = std::exchange(other._file, nullptr);
+        _mapping = std::exchange(other._mapping, nullptr);
+    }
+
+    return *this;
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const char *filePath)
+{
+    close();
+
+    HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    // an empty file can't be mapped, but it is still a file we opened
+    _file = file;
+    _size = static_cast<size_t>(file_size.QuadPart);
+    if (_size == 0)
+    {
+        return true;
+    }
+
+    _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping == nullptr)
+    {
+        close();
+        return false;
+    }
+
+    _data = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (_data == nullptr)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (_data != nullptr)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != nullptr)
+    {
+        CloseHandle(_mapping);
+    }
+    if (_file != nullptr)
+    {
+        CloseHandle(_file);
+    }
+
+    _data = nullptr;
+    _size = 0;
+    _file = nullptr;
+    _mapping = nullptr;
+}
+#else
+bool MappedFile::open(const char *filePath)
+{
+    close();
+
+    const int fd = ::open(filePath, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // an empty file can't be mapped, but it is still a file we opened
+    _size = static_cast<size_t>(file_stat.st_size);
+    if (_size == 0)
+    {
+        ::close(fd);
+        return true;
+    }
+
+    // the mapping keeps its own reference to the file, so the descriptor isn't needed past this point
+    void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        _size = 0;
+        return false;
+    }
+
+    // the whole file is about to be read front to back
+    madvise(data, _size, MADV_SEQUENTIAL);
+
+    _data = data;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (_data != nullptr)
+    {
+        munmap(_data, _size);
+    }
+
+    _data = nullptr;
+    _size = 0;
+}
+#endif
+} // namespace vulkan_engine
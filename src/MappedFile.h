@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+namespace vulkan_engine
+{
+// A whole file mapped read-only into memory, so it can be read (or handed to the driver) straight from the page cache
+// without being copied into a buffer first. The mapping is released by close() or when the object is destroyed
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    // map filePath, replacing whatever was mapped before. The mapping starts on a page boundary
+    bool open(const char *filePath);
+
+    void close();
+
+    // null for an empty file
+    const void *data() const
+    {
+        return _data;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+  private:
+    void *_data{nullptr};
+    size_t _size{0};
+
+    // the Windows file and mapping handles, which have to stay open as long as the view does
+    void *_file{nullptr};
+    void *_mapping{nullptr};
+};
+} // namespace vulkan_engine
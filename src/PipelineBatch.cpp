@@ -0,0 +1,74 @@
+#include "PipelineBatch.h"
+
+#include <algorithm>
+#include <future>
+#include <iostream>
+
+namespace vulkan_engine
+{
+size_t PipelineBatch::add(const PipelineBuilder &builder, VkRenderPass pass)
+{
+    _builders.push_back(builder);
+    _passes.push_back(pass);
+    return _builders.size() - 1;
+}
+
+std::vector<VkPipeline> PipelineBatch::build(VkDevice device, VkPipelineCache pipelineCache,
+                                             ThreadPool *threadPool /*= nullptr*/, size_t chunkSize /*= 0*/) const
+{
+    std::vector<VkPipeline> pipelines(_builders.size(), VK_NULL_HANDLE);
+    if (pipelines.empty())
+    {
+        return pipelines;
+    }
+
+    if (threadPool == nullptr || threadPool->thread_count() == 0)
+    {
+        build_range(device, pipelineCache, 0, pipelines.size(), pipelines.data());
+        return pipelines;
+    }
+
+    if (chunkSize == 0)
+    {
+        chunkSize = (pipelines.size() + threadPool->thread_count() - 1) / threadPool->thread_count();
+    }
+
+    // each chunk writes to its own slice of the result, and the pipeline cache is internally synchronised
+    std::vector<std::future<void>> chunks;
+    for (size_t first = 0; first < pipelines.size(); first += chunkSize)
+    {
+        const size_t count = std::min(chunkSize, pipelines.size() - first);
+        VkPipeline *out_pipelines = pipelines.data() + first;
+        chunks.push_back(threadPool->submit([this, device, pipelineCache, first, count, out_pipelines]() {
+            build_range(device, pipelineCache, first, count, out_pipelines);
+        }));
+    }
+
+    for (std::future<void> &chunk : chunks)
+    {
+        chunk.wait();
+    }
+
+    return pipelines;
+}
+
+void PipelineBatch::build_range(VkDevice device, VkPipelineCache pipelineCache, size_t first, size_t count,
+                                VkPipeline *outPipelines) const
+{
+    // the create infos point into these, so they are sized up front and never reallocated
+    std::vector<PipelineCreateInfo> create_infos(count);
+    std::vector<VkGraphicsPipelineCreateInfo> pipeline_infos(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        _builders[first + i].fill_create_info(_passes[first + i], &create_infos[i]);
+        pipeline_infos[i] = create_infos[i].pipeline_info;
+    }
+
+    // if any pipeline fails the driver sets just that one to VK_NULL_HANDLE, the rest are still created
+    if (vkCreateGraphicsPipelines(device, pipelineCache, static_cast<uint32_t>(count), pipeline_infos.data(), nullptr,
+                                  outPipelines) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create some of a batch of " << count << " graphics pipelines" << std::endl;
+    }
+}
+} // namespace vulkan_engine
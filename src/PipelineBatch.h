@@ -0,0 +1,38 @@
+#pragma once
+
+#include "PipelineBuilder.h"
+#include "ThreadPool.h"
+#include "VulkanTypes.h"
+
+#include <vector>
+
+namespace vulkan_engine
+{
+// Collects several pipeline states and creates them with as few vkCreateGraphicsPipelines calls as possible. Handing
+// the driver many create infos at once lets it spread the compiles over its own threads, and splitting the batch
+// across our worker threads covers drivers that don't.
+class PipelineBatch
+{
+  public:
+    // queue the pipeline for builder, returning its index in build()'s result. The builder is copied
+    size_t add(const PipelineBuilder &builder, VkRenderPass pass);
+
+    size_t size() const
+    {
+        return _builders.size();
+    }
+
+    // create every queued pipeline, VK_NULL_HANDLE for any that failed. With a thread pool the batch is split into
+    // calls of chunkSize pipelines (0 spreads it evenly over the workers) made on the workers
+    std::vector<VkPipeline> build(VkDevice device, VkPipelineCache pipelineCache, ThreadPool *threadPool = nullptr,
+                                  size_t chunkSize = 0) const;
+
+  private:
+    // create pipelines [first, first + count) in a single call
+    void build_range(VkDevice device, VkPipelineCache pipelineCache, size_t first, size_t count,
+                     VkPipeline *outPipelines) const;
+
+    std::vector<PipelineBuilder> _builders;
+    std::vector<VkRenderPass> _passes;
+};
+} // namespace vulkan_engine
@@ -1,15 +1,48 @@
 #include "PipelineBuilder.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
+#include "StateKey.h"
+
 namespace vulkan_engine
 {
+namespace
+{
+// the pipeline library part a shader stage is compiled into
+VkGraphicsPipelineLibraryFlagsEXT library_part(VkShaderStageFlagBits stage)
+{
+    return stage == VK_SHADER_STAGE_FRAGMENT_BIT ? VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT
+                                                 : VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+}
+} // namespace
 
-VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
+VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass,
+                                           VkPipelineCache pipelineCache /*= VK_NULL_HANDLE*/) const
+{
+    PipelineCreateInfo create_info;
+    fill_create_info(pass, &create_info);
+
+    // create the pipeline object and handle any errors. With a pipeline cache the driver can skip compiling anything
+    // it has seen before
+    VkPipeline new_pipeline;
+    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &create_info.pipeline_info, nullptr, &new_pipeline) !=
+        VK_SUCCESS)
+    {
+        std::cout << "Failed to create graphics pipeline" << std::endl;
+        return VK_NULL_HANDLE;
+    }
+
+    return new_pipeline;
+}
+
+void PipelineBuilder::fill_create_info(VkRenderPass pass, PipelineCreateInfo *outCreateInfo) const
 {
     // make viewport state from our stored viewport and scissor
     // currently doesn't support multiple viewports or scissors
-    VkPipelineViewportStateCreateInfo viewport_state = {}; // initialise struct to 0's
+    VkPipelineViewportStateCreateInfo &viewport_state = outCreateInfo->viewport_state;
+    viewport_state = {}; // initialise struct to 0's
     viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_state.pNext = nullptr;
 
@@ -19,7 +52,8 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
     viewport_state.pScissors = &scissor;
 
     // setup some dummy colour blending. Not using transparent objects yet though
-    VkPipelineColorBlendStateCreateInfo colour_blending = {}; // initialise struct to 0's
+    VkPipelineColorBlendStateCreateInfo &colour_blending = outCreateInfo->colour_blending;
+    colour_blending = {}; // initialise struct to 0's
     colour_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colour_blending.pNext = nullptr;
 
@@ -28,8 +62,18 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
     colour_blending.attachmentCount = 1;
     colour_blending.pAttachments = &colour_blend_attachment;
 
+    // anything listed as dynamic is ignored in the structs above and must be set on the command buffer instead
+    VkPipelineDynamicStateCreateInfo &dynamic_state = outCreateInfo->dynamic_state;
+    dynamic_state = {}; // initialise struct to 0's
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.pNext = nullptr;
+
+    dynamic_state.dynamicStateCount = dynamic_states.size();
+    dynamic_state.pDynamicStates = dynamic_states.data();
+
     // build the pipeline config
-    VkGraphicsPipelineCreateInfo pipeline_info = {}; // initialise struct to 0's
+    VkGraphicsPipelineCreateInfo &pipeline_info = outCreateInfo->pipeline_info;
+    pipeline_info = {}; // initialise struct to 0's
     pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipeline_info.pNext = nullptr;
 
@@ -40,20 +84,225 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
     pipeline_info.pViewportState = &viewport_state;
     pipeline_info.pRasterizationState = &rasteriser;
     pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pDepthStencilState = &depth_stencil;
     pipeline_info.pColorBlendState = &colour_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
     pipeline_info.layout = pipeline_layout;
     pipeline_info.renderPass = pass;
     pipeline_info.subpass = 0;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+}
 
-    // create the pipeline object and handle any errors
-    VkPipeline new_pipeline;
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &new_pipeline) != VK_SUCCESS)
+VkPipeline PipelineBuilder::build_library(VkDevice device, VkRenderPass pass, VkGraphicsPipelineLibraryFlagsEXT parts,
+                                          VkPipelineCache pipelineCache /*= VK_NULL_HANDLE*/) const
+{
+    PipelineCreateInfo create_info;
+    fill_create_info(pass, &create_info);
+
+    // the driver ignores state belonging to other parts, but the shader stages have to be picked out ourselves
+    std::vector<VkPipelineShaderStageCreateInfo> library_stages;
+    for (const VkPipelineShaderStageCreateInfo &stage : shader_stages)
     {
-        std::cout << "Failed to create graphics pipeline" << std::endl;
+        if ((library_part(stage.stage) & parts) != 0)
+        {
+            library_stages.push_back(stage);
+        }
+    }
+    create_info.pipeline_info.stageCount = static_cast<uint32_t>(library_stages.size());
+    create_info.pipeline_info.pStages = library_stages.data();
+
+    VkGraphicsPipelineLibraryCreateInfoEXT library_info = {}; // initialise struct to 0's
+    library_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+    library_info.pNext = nullptr;
+    library_info.flags = parts;
+
+    // keep what the driver needs to optimise across libraries, so an optimised link is possible later
+    create_info.pipeline_info.pNext = &library_info;
+    create_info.pipeline_info.flags =
+        VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+    VkPipeline library;
+    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &create_info.pipeline_info, nullptr, &library) !=
+        VK_SUCCESS)
+    {
+        std::cout << "Failed to create graphics pipeline library" << std::endl;
         return VK_NULL_HANDLE;
     }
 
-    return new_pipeline;
+    return library;
+}
+
+VkPipeline PipelineBuilder::link_libraries(VkDevice device, VkPipelineLayout layout,
+                                           const std::vector<VkPipeline> &libraries, bool optimise,
+                                           VkPipelineCache pipelineCache /*= VK_NULL_HANDLE*/)
+{
+    VkPipelineLibraryCreateInfoKHR library_info = {}; // initialise struct to 0's
+    library_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    library_info.pNext = nullptr;
+    library_info.libraryCount = static_cast<uint32_t>(libraries.size());
+    library_info.pLibraries = libraries.data();
+
+    // everything else comes from the libraries
+    VkGraphicsPipelineCreateInfo pipeline_info = {}; // initialise struct to 0's
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.pNext = &library_info;
+    pipeline_info.flags = optimise ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+    pipeline_info.layout = layout;
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS)
+    {
+        std::cout << "Failed to link graphics pipeline libraries" << std::endl;
+        return VK_NULL_HANDLE;
+    }
+
+    return pipeline;
+}
+
+std::string PipelineBuilder::state_key(VkRenderPass pass) const
+{
+    return library_key(pass, ALL_PIPELINE_LIBRARY_PARTS);
+}
+
+std::string PipelineBuilder::library_key(VkRenderPass pass, VkGraphicsPipelineLibraryFlagsEXT parts) const
+{
+    std::string key;
+    key.reserve(256);
+
+    append_to_key(key, parts);
+
+    // vertex input is the only part that doesn't depend on the render pass or the layout
+    if ((parts & ~VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) != 0)
+    {
+        append_to_key(key, pass);
+    }
+    if ((parts & (VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT |
+                  VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)) != 0)
+    {
+        append_to_key(key, pipeline_layout);
+    }
+
+    for (size_t i = 0; i < shader_stages.size(); ++i)
+    {
+        const VkPipelineShaderStageCreateInfo &stage = shader_stages[i];
+        if ((library_part(stage.stage) & parts) == 0)
+        {
+            continue;
+        }
+
+        append_to_key(key, stage.flags);
+        append_to_key(key, stage.stage);
+        if (i < shader_code_keys.size())
+        {
+            const std::vector<uint32_t> &code = *shader_code_keys[i].code;
+            append_to_key(key, static_cast<uint64_t>(code.size()));
+            key.append(reinterpret_cast<const char *>(code.data()), code.size() * sizeof(uint32_t));
+        }
+        else
+        {
+            append_to_key(key, stage.module);
+        }
+        key.append(stage.pName, std::strlen(stage.pName) + 1);
+
+        // specialisation constants change the compiled code just as much as the module does
+        const VkSpecializationInfo *specialisation = stage.pSpecializationInfo;
+        append_to_key(key, specialisation != nullptr ? specialisation->mapEntryCount : 0u);
+        if (specialisation != nullptr)
+        {
+            for (uint32_t i = 0; i < specialisation->mapEntryCount; ++i)
+            {
+                append_to_key(key, specialisation->pMapEntries[i].constantID);
+                append_to_key(key, specialisation->pMapEntries[i].offset);
+                append_to_key(key, specialisation->pMapEntries[i].size);
+            }
+            key.append(static_cast<const char *>(specialisation->pData), specialisation->dataSize);
+        }
+    }
+
+    if ((parts & VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) != 0)
+    {
+        append_to_key(key, vertex_input_info.vertexBindingDescriptionCount);
+        for (uint32_t i = 0; i < vertex_input_info.vertexBindingDescriptionCount; ++i)
+        {
+            append_to_key(key, vertex_input_info.pVertexBindingDescriptions[i]);
+        }
+
+        append_to_key(key, vertex_input_info.vertexAttributeDescriptionCount);
+        for (uint32_t i = 0; i < vertex_input_info.vertexAttributeDescriptionCount; ++i)
+        {
+            append_to_key(key, vertex_input_info.pVertexAttributeDescriptions[i]);
+        }
+
+        append_to_key(key, input_assembly.topology);
+        append_to_key(key, input_assembly.primitiveRestartEnable);
+    }
+
+    if ((parts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT) != 0)
+    {
+        // dynamic viewport and scissor values are ignored by the driver, so they mustn't split otherwise equal
+        // pipelines
+        const auto is_dynamic = [this](VkDynamicState state) {
+            return std::find(dynamic_states.begin(), dynamic_states.end(), state) != dynamic_states.end();
+        };
+        if (!is_dynamic(VK_DYNAMIC_STATE_VIEWPORT))
+        {
+            append_to_key(key, viewport);
+        }
+        if (!is_dynamic(VK_DYNAMIC_STATE_SCISSOR))
+        {
+            append_to_key(key, scissor);
+        }
+
+        append_to_key(key, rasteriser.depthClampEnable);
+        append_to_key(key, rasteriser.rasterizerDiscardEnable);
+        append_to_key(key, rasteriser.polygonMode);
+        append_to_key(key, rasteriser.cullMode);
+        append_to_key(key, rasteriser.frontFace);
+        append_to_key(key, rasteriser.depthBiasEnable);
+        append_to_key(key, rasteriser.depthBiasConstantFactor);
+        append_to_key(key, rasteriser.depthBiasClamp);
+        append_to_key(key, rasteriser.depthBiasSlopeFactor);
+        append_to_key(key, rasteriser.lineWidth);
+    }
+
+    if ((parts & (VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT |
+                  VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)) != 0)
+    {
+        append_to_key(key, multisampling.rasterizationSamples);
+        append_to_key(key, multisampling.sampleShadingEnable);
+        append_to_key(key, multisampling.minSampleShading);
+        append_to_key(key, multisampling.alphaToCoverageEnable);
+        append_to_key(key, multisampling.alphaToOneEnable);
+    }
+
+    if ((parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) != 0)
+    {
+        append_to_key(key, depth_stencil.depthTestEnable);
+        append_to_key(key, depth_stencil.depthWriteEnable);
+        append_to_key(key, depth_stencil.depthCompareOp);
+        append_to_key(key, depth_stencil.depthBoundsTestEnable);
+        append_to_key(key, depth_stencil.stencilTestEnable);
+    }
+
+    if ((parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT) != 0)
+    {
+        append_to_key(key, colour_blend_attachment);
+    }
+
+    append_to_key(key, dynamic_states.size());
+    for (VkDynamicState state : dynamic_states)
+    {
+        append_to_key(key, state);
+    }
+
+    return key;
+}
+
+void PipelineBuilder::set_specialisation(const VkSpecializationInfo *specialisationInfo)
+{
+    for (VkPipelineShaderStageCreateInfo &stage : shader_stages)
+    {
+        stage.pSpecializationInfo = specialisationInfo;
+    }
 }
 } // namespace vulkan_engine
\ No newline at end of file
@@ -2,14 +2,70 @@
 
 #include "vulkan/vulkan.h"
 
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace vulkan_engine
 {
+// every part of a pipeline that VK_EXT_graphics_pipeline_library can build as a separate library
+constexpr VkGraphicsPipelineLibraryFlagsEXT ALL_PIPELINE_LIBRARY_PARTS =
+    VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT |
+    VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT |
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT |
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+
+// identifies a shader module's code, for pipeline keys that have to outlive the module. Keys hold the whole code, as
+// the hash alone could mix two shaders up
+struct ShaderCodeKey
+{
+    uint64_t hash;
+    std::shared_ptr<const std::vector<uint32_t>> code;
+
+    bool operator==(const ShaderCodeKey &other) const
+    {
+        return hash == other.hash && (code == other.code || *code == *other.code);
+    }
+};
+
+// a pipeline create info along with the state structs it points at that aren't stored in the builder. It points into
+// itself and its builder, so neither may move while it is in use
+struct PipelineCreateInfo
+{
+    VkPipelineViewportStateCreateInfo viewport_state;
+    VkPipelineColorBlendStateCreateInfo colour_blending;
+    VkPipelineDynamicStateCreateInfo dynamic_state;
+    VkGraphicsPipelineCreateInfo pipeline_info;
+};
+
 class PipelineBuilder
 {
   public:
-    VkPipeline build_pipeline(VkDevice device, VkRenderPass pass);
+    VkPipeline build_pipeline(VkDevice device, VkRenderPass pass, VkPipelineCache pipelineCache = VK_NULL_HANDLE) const;
+
+    // fill in everything vkCreateGraphicsPipelines needs for this builder's pipeline, without creating it
+    void fill_create_info(VkRenderPass pass, PipelineCreateInfo *outCreateInfo) const;
+
+    // a byte string capturing everything that build_pipeline would bake into the pipeline, so two builders with the
+    // same key produce interchangeable pipelines
+    std::string state_key(VkRenderPass pass) const;
+
+    // build only the given parts of this builder's pipeline as a pipeline library, to be linked with link_libraries().
+    // Needs VK_EXT_graphics_pipeline_library
+    VkPipeline build_library(VkDevice device, VkRenderPass pass, VkGraphicsPipelineLibraryFlagsEXT parts,
+                             VkPipelineCache pipelineCache = VK_NULL_HANDLE) const;
+
+    // like state_key(), but only covering what the given library parts bake in
+    std::string library_key(VkRenderPass pass, VkGraphicsPipelineLibraryFlagsEXT parts) const;
+
+    // link libraries covering every part into a complete pipeline. Without optimise this is fast but the result may
+    // run slower than a monolithic pipeline, with it the driver optimises across the parts (as slow as a full compile)
+    static VkPipeline link_libraries(VkDevice device, VkPipelineLayout layout, const std::vector<VkPipeline> &libraries,
+                                     bool optimise, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+
+    // give every shader stage the same specialisation constants. specialisationInfo has to outlive any use of the
+    // builder
+    void set_specialisation(const VkSpecializationInfo *specialisationInfo);
 
     std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
     VkPipelineVertexInputStateCreateInfo vertex_input_info;
@@ -17,8 +73,14 @@ class PipelineBuilder
     VkRect2D scissor;
     VkPipelineRasterizationStateCreateInfo rasteriser;
     VkPipelineMultisampleStateCreateInfo multisampling;
+    VkPipelineDepthStencilStateCreateInfo depth_stencil;
     VkPipelineInputAssemblyStateCreateInfo input_assembly;
     VkPipelineColorBlendAttachmentState colour_blend_attachment;
     VkPipelineLayout pipeline_layout;
+    std::vector<VkDynamicState> dynamic_states; // state that is set while recording instead of baked in
+
+    // when set, one per shader stage, keyed in place of the stages' module handles. A destroyed module's handle may be
+    // reused for different code, so builders whose modules can go before their pipelines do must set these
+    std::vector<ShaderCodeKey> shader_code_keys;
 };
 } // namespace vulkan_engine
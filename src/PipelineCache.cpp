@@ -0,0 +1,188 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "Hash.h"
+
+namespace vulkan_engine
+{
+void PipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties &properties, const std::string &filePath)
+{
+    _device = device;
+    _properties = properties;
+    _file_path = filePath;
+
+    std::vector<char> initial_data;
+    if (!_file_path.empty())
+    {
+        std::string reason;
+        _is_warm = read_cache_file(&initial_data, &reason);
+        if (!_is_warm)
+        {
+            std::cout << "Not using pipeline cache " << _file_path << ": " << reason << std::endl;
+        }
+    }
+
+    VkPipelineCacheCreateInfo cache_info = {}; // initialise struct to 0's
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.pNext = nullptr;
+    cache_info.initialDataSize = initial_data.size();
+    cache_info.pInitialData = initial_data.empty() ? nullptr : initial_data.data();
+
+    VK_CHECK(vkCreatePipelineCache(_device, &cache_info, nullptr, &_cache));
+}
+
+bool PipelineCache::save() const
+{
+    if (_file_path.empty())
+    {
+        return false;
+    }
+
+    // ask for the size first, then the data
+    size_t data_size = 0;
+    if (vkGetPipelineCacheData(_device, _cache, &data_size, nullptr) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    std::vector<char> data(data_size);
+    if (vkGetPipelineCacheData(_device, _cache, &data_size, data.data()) != VK_SUCCESS)
+    {
+        return false;
+    }
+    data.resize(data_size);
+
+    FileHeader header = make_header();
+    header.data_size = data.size();
+    header.data_hash = hash_bytes(data.data(), data.size());
+
+    // write everything to a temporary file first and only swap it in once it's complete, so the cache on disk is
+    // always either the old one or the new one
+    const std::string temp_path = _file_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cout << "Failed to open " << temp_path << " for writing" << std::endl;
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(data.data(), data.size());
+        file.flush();
+        if (!file.good())
+        {
+            std::cout << "Failed to write pipeline cache to " << temp_path << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, _file_path, error);
+    if (error)
+    {
+        std::cout << "Failed to replace " << _file_path << ": " << error.message() << std::endl;
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+
+    std::cout << "Saved " << data.size() << " bytes of pipeline cache to " << _file_path << std::endl;
+    return true;
+}
+
+void PipelineCache::cleanup()
+{
+    vkDestroyPipelineCache(_device, _cache, nullptr);
+    _cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::read_cache_file(std::vector<char> *outData, std::string *outReason) const
+{
+    std::ifstream file(_file_path, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+    {
+        *outReason = "no cache file yet";
+        return false;
+    }
+
+    const auto file_size = (size_t)file.tellg();
+    file.seekg(0);
+
+    FileHeader header;
+    if (file_size < sizeof(header) || !file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+    {
+        *outReason = "file is too small";
+        return false;
+    }
+
+    // our own header says which device and driver wrote the data
+    const FileHeader expected = make_header();
+    if (header.magic != expected.magic || header.version != expected.version)
+    {
+        *outReason = "not a pipeline cache file";
+        return false;
+    }
+
+    if (header.vendor_id != expected.vendor_id || header.device_id != expected.device_id ||
+        std::memcmp(header.pipeline_cache_uuid, expected.pipeline_cache_uuid, VK_UUID_SIZE) != 0)
+    {
+        *outReason = "written for a different GPU";
+        return false;
+    }
+
+    if (header.driver_version != expected.driver_version)
+    {
+        *outReason = "written by a different driver version";
+        return false;
+    }
+
+    if (header.data_size != file_size - sizeof(header))
+    {
+        *outReason = "file is truncated";
+        return false;
+    }
+
+    std::vector<char> data(header.data_size);
+    if (!file.read(data.data(), data.size()) || hash_bytes(data.data(), data.size()) != header.data_hash)
+    {
+        *outReason = "file is corrupt";
+        return false;
+    }
+
+    // and the driver's own header, at the start of the data, has to agree with it
+    VkPipelineCacheHeaderVersionOne vulkan_header;
+    if (data.size() < sizeof(vulkan_header))
+    {
+        *outReason = "cache data is too small";
+        return false;
+    }
+    std::memcpy(&vulkan_header, data.data(), sizeof(vulkan_header));
+
+    if (vulkan_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        vulkan_header.vendorID != _properties.vendorID || vulkan_header.deviceID != _properties.deviceID ||
+        std::memcmp(vulkan_header.pipelineCacheUUID, _properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        *outReason = "cache data doesn't match this device";
+        return false;
+    }
+
+    *outData = std::move(data);
+    return true;
+}
+
+PipelineCache::FileHeader PipelineCache::make_header() const
+{
+    FileHeader header = {}; // initialise struct to 0's
+    header.magic = FILE_MAGIC;
+    header.version = FILE_VERSION;
+    header.vendor_id = _properties.vendorID;
+    header.device_id = _properties.deviceID;
+    header.driver_version = _properties.driverVersion;
+    std::memcpy(header.pipeline_cache_uuid, _properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+} // namespace vulkan_engine
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "VulkanTypes.h"
+
+#include <string>
+#include <vector>
+
+namespace vulkan_engine
+{
+// A VkPipelineCache that persists between runs. The data is stored behind a small header of our own that records which
+// GPU and driver produced it, so a cache from another device (or a driver update) is thrown away rather than handed to
+// a driver that may not validate it properly. Saving goes through a temporary file, so a crash mid-write can never
+// leave a truncated cache behind.
+class PipelineCache
+{
+  public:
+    // create the cache, seeding it from filePath when the file matches this device. An empty filePath keeps the
+    // cache in memory only
+    void init(VkDevice device, const VkPhysicalDeviceProperties &properties, const std::string &filePath);
+
+    // write the cache contents back to disk
+    bool save() const;
+
+    void cleanup();
+
+    VkPipelineCache cache() const
+    {
+        return _cache;
+    }
+
+    // true when the cache was seeded from disk, i.e. pipelines should mostly be cache hits
+    bool is_warm() const
+    {
+        return _is_warm;
+    }
+
+  private:
+    // everything we need to decide whether the data on disk is still usable
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendor_id;
+        uint32_t device_id;
+        uint32_t driver_version;
+        uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+        uint64_t data_size;
+        uint64_t data_hash;
+    };
+
+    static constexpr uint32_t FILE_MAGIC = 0x43505643; // "CVPC"
+    static constexpr uint32_t FILE_VERSION = 1;
+
+    // load the file, returning its cache data if it was written for this device. Otherwise says why not
+    bool read_cache_file(std::vector<char> *outData, std::string *outReason) const;
+
+    // fill in the header fields that identify this device and driver
+    FileHeader make_header() const;
+
+    VkDevice _device{VK_NULL_HANDLE};
+    VkPhysicalDeviceProperties _properties{};
+    std::string _file_path;
+
+    VkPipelineCache _cache{VK_NULL_HANDLE};
+    bool _is_warm{false};
+};
+} // namespace vulkan_engine
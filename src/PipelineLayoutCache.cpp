@@ -0,0 +1,253 @@
+#include "PipelineLayoutCache.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+#include "StateKey.h"
+#include "VulkanInitialisers.h"
+
+namespace vulkan_engine
+{
+namespace
+{
+// only the draw data is bound with a dynamic offset, everything else (arrays of buffers included) keeps its type
+VkDescriptorType layout_type(const SpirvDescriptorBinding &reflected)
+{
+    if (reflected.set != PipelineLayoutCache::DRAW_DATA_SET ||
+        reflected.binding != PipelineLayoutCache::DRAW_DATA_BINDING || reflected.count != 1)
+    {
+        return reflected.type;
+    }
+
+    switch (reflected.type)
+    {
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    default:
+        return reflected.type;
+    }
+}
+} // namespace
+
+void PipelineLayoutCache::init(VkDevice device, const VkPhysicalDeviceLimits &limits)
+{
+    _device = device;
+    _max_push_constants_size = limits.maxPushConstantsSize;
+    _max_dynamic_uniform_buffers = limits.maxDescriptorSetUniformBuffersDynamic;
+    _max_dynamic_storage_buffers = limits.maxDescriptorSetStorageBuffersDynamic;
+}
+
+void PipelineLayoutCache::cleanup()
+{
+    for (const auto &pipeline_layout : _pipeline_layouts)
+    {
+        vkDestroyPipelineLayout(_device, pipeline_layout.second, nullptr);
+    }
+    for (const auto &set_layout : _set_layouts)
+    {
+        vkDestroyDescriptorSetLayout(_device, set_layout.second, nullptr);
+    }
+
+    _pipeline_layouts.clear();
+    _pipeline_set_layouts.clear();
+    _set_layouts.clear();
+    _set_layout_bindings.clear();
+}
+
+VkPipelineLayout PipelineLayoutCache::get_or_create(const std::vector<const SpirvReflection *> &stages)
+{
+    // set -> binding -> the merged binding. Ordered maps keep both sorted, so equal interfaces give equal keys
+    std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+    VkPushConstantRange push_constants = {}; // initialise struct to 0's
+
+    for (const SpirvReflection *stage : stages)
+    {
+        for (const SpirvDescriptorBinding &reflected : stage->descriptor_bindings)
+        {
+            auto inserted = sets[reflected.set].emplace(reflected.binding, VkDescriptorSetLayoutBinding{});
+            VkDescriptorSetLayoutBinding &binding = inserted.first->second;
+            const VkDescriptorType type = layout_type(reflected);
+            if (inserted.second)
+            {
+                binding.binding = reflected.binding;
+                binding.descriptorType = type;
+                binding.descriptorCount = reflected.count;
+            }
+            else if (binding.descriptorType != type)
+            {
+                std::cout << "Shader stages disagree on the type of set " << reflected.set << " binding "
+                          << reflected.binding << ", using the first" << std::endl;
+            }
+
+            binding.descriptorCount = std::max(binding.descriptorCount, reflected.count);
+            binding.stageFlags |= stage->stage;
+        }
+
+        // one range shared by every stage is enough for the small blocks push constants are used for
+        if (stage->push_constant_size > 0)
+        {
+            push_constants.stageFlags |= stage->stage;
+            push_constants.size = std::max(push_constants.size, stage->push_constant_size);
+        }
+    }
+
+    // the spec only guarantees 128 bytes, report shaders that ask for more than this device has rather than failing
+    // layout creation
+    if (push_constants.size > _max_push_constants_size)
+    {
+        std::cout << "Shaders need " << push_constants.size << " bytes of push constants but the device only has "
+                  << _max_push_constants_size << std::endl;
+        return VK_NULL_HANDLE;
+    }
+
+    // the limits cover every set in the layout, and are as low as 8 uniform and 4 storage buffers
+    uint32_t dynamic_uniform_buffers = 0;
+    uint32_t dynamic_storage_buffers = 0;
+    for (const auto &set : sets)
+    {
+        for (const auto &binding : set.second)
+        {
+            if (binding.second.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+            {
+                dynamic_uniform_buffers += binding.second.descriptorCount;
+            }
+            else if (binding.second.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+            {
+                dynamic_storage_buffers += binding.second.descriptorCount;
+            }
+        }
+    }
+    if (dynamic_uniform_buffers > _max_dynamic_uniform_buffers ||
+        dynamic_storage_buffers > _max_dynamic_storage_buffers)
+    {
+        std::cout << "Shaders need " << dynamic_uniform_buffers << " dynamic uniform and " << dynamic_storage_buffers
+                  << " dynamic storage buffers but the device only has " << _max_dynamic_uniform_buffers << " and "
+                  << _max_dynamic_storage_buffers << std::endl;
+        return VK_NULL_HANDLE;
+    }
+
+    // sets are numbered from 0 with no gaps, any set no stage uses gets an empty layout
+    std::vector<VkDescriptorSetLayout> set_layouts;
+    if (!sets.empty())
+    {
+        set_layouts.resize(sets.rbegin()->first + 1);
+        for (uint32_t set = 0; set < set_layouts.size(); ++set)
+        {
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            auto it = sets.find(set);
+            if (it != sets.end())
+            {
+                for (const auto &binding : it->second)
+                {
+                    bindings.push_back(binding.second);
+                }
+            }
+            set_layouts[set] = get_or_create_set_layout(bindings);
+        }
+    }
+
+    // set layouts are already deduplicated, so their handles stand in for their contents
+    std::string key;
+    for (VkDescriptorSetLayout set_layout : set_layouts)
+    {
+        append_to_key(key, set_layout);
+    }
+    append_to_key(key, push_constants.stageFlags);
+    append_to_key(key, push_constants.size);
+
+    auto it = _pipeline_layouts.find(key);
+    if (it != _pipeline_layouts.end())
+    {
+        return it->second;
+    }
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = vulkan_engine::initialisers::pipeline_layout_create_info();
+    pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+    pipeline_layout_info.pSetLayouts = set_layouts.data();
+    if (push_constants.size > 0)
+    {
+        pipeline_layout_info.pushConstantRangeCount = 1;
+        pipeline_layout_info.pPushConstantRanges = &push_constants;
+    }
+
+    VkPipelineLayout pipeline_layout;
+    VK_CHECK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &pipeline_layout));
+    _pipeline_layouts.emplace(std::move(key), pipeline_layout);
+    _pipeline_set_layouts.emplace(pipeline_layout, std::move(set_layouts));
+    return pipeline_layout;
+}
+
+const std::vector<VkDescriptorSetLayout> &PipelineLayoutCache::set_layouts(VkPipelineLayout pipelineLayout) const
+{
+    static const std::vector<VkDescriptorSetLayout> none;
+    auto it = _pipeline_set_layouts.find(pipelineLayout);
+    return it != _pipeline_set_layouts.end() ? it->second : none;
+}
+
+const std::vector<VkDescriptorSetLayoutBinding> &PipelineLayoutCache::bindings(VkDescriptorSetLayout setLayout) const
+{
+    static const std::vector<VkDescriptorSetLayoutBinding> none;
+    auto it = _set_layout_bindings.find(setLayout);
+    return it != _set_layout_bindings.end() ? it->second : none;
+}
+
+std::vector<VkDescriptorPoolSize> PipelineLayoutCache::pool_sizes(VkDescriptorSetLayout setLayout) const
+{
+    std::vector<VkDescriptorPoolSize> sizes;
+    for (const VkDescriptorSetLayoutBinding &binding : bindings(setLayout))
+    {
+        // a pool size can't be empty
+        if (binding.descriptorCount == 0)
+        {
+            continue;
+        }
+
+        auto size = std::find_if(sizes.begin(), sizes.end(), [&](const VkDescriptorPoolSize &candidate) {
+            return candidate.type == binding.descriptorType;
+        });
+        if (size == sizes.end())
+        {
+            sizes.push_back({binding.descriptorType, binding.descriptorCount});
+        }
+        else
+        {
+            size->descriptorCount += binding.descriptorCount;
+        }
+    }
+    return sizes;
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::get_or_create_set_layout(
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings)
+{
+    // immutable samplers aren't reflected, so everything else in a binding makes up the key
+    std::string key;
+    for (const VkDescriptorSetLayoutBinding &binding : bindings)
+    {
+        append_to_key(key, binding.binding);
+        append_to_key(key, binding.descriptorType);
+        append_to_key(key, binding.descriptorCount);
+        append_to_key(key, binding.stageFlags);
+    }
+
+    auto it = _set_layouts.find(key);
+    if (it != _set_layouts.end())
+    {
+        return it->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {}; // initialise struct to 0's
+    set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    set_layout_info.pBindings = bindings.data();
+
+    VkDescriptorSetLayout set_layout;
+    VK_CHECK(vkCreateDescriptorSetLayout(_device, &set_layout_info, nullptr, &set_layout));
+    _set_layouts.emplace(std::move(key), set_layout);
+    _set_layout_bindings.emplace(set_layout, bindings);
+    return set_layout;
+}
+} // namespace vulkan_engine
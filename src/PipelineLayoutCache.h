@@ -0,0 +1,69 @@
+#pragma once
+
+#include "SpirvReflection.h"
+#include "VulkanTypes.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vulkan_engine
+{
+// Builds pipeline layouts from what the shaders using them say they need, rather than by hand. The stages' descriptor
+// bindings are merged (a binding used by several stages is visible to all of them) and push constants become one range
+// covering every stage that has any. The per-draw data is fed from the FrameAllocator through a dynamic offset, so the
+// buffer at DRAW_DATA_SET/DRAW_DATA_BINDING gets the dynamic descriptor type and every other binding keeps the type
+// the shader declared. Descriptor set layouts and pipeline layouts are both cached by their contents, so shaders with
+// the same interface share them, and everything is destroyed together at cleanup.
+//
+// Only used from the main thread, so it is not synchronised.
+class PipelineLayoutCache
+{
+  public:
+    // SPIR-V can't say which buffer is bound with a dynamic offset, so shaders declare their draw data here
+    static constexpr uint32_t DRAW_DATA_SET = 0;
+    static constexpr uint32_t DRAW_DATA_BINDING = 0;
+
+    // layouts are checked against the device's push constant size and dynamic buffer limits
+    void init(VkDevice device, const VkPhysicalDeviceLimits &limits);
+
+    void cleanup();
+
+    // the layout for a pipeline made of the reflected stages, creating it (and its set layouts) if needed. Returns
+    // VK_NULL_HANDLE when the stages' push constants or dynamic buffers don't fit in the device's limits
+    VkPipelineLayout get_or_create(const std::vector<const SpirvReflection *> &stages);
+
+    // the set layout for the given bindings, which must be sorted by binding number
+    VkDescriptorSetLayout get_or_create_set_layout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+
+    // the set layouts a pipeline layout from get_or_create() was made with, to allocate descriptor sets for it
+    const std::vector<VkDescriptorSetLayout> &set_layouts(VkPipelineLayout pipelineLayout) const;
+
+    // the bindings a set layout from get_or_create_set_layout() was made with, sorted by binding number
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings(VkDescriptorSetLayout setLayout) const;
+
+    // how many descriptors of each type one set of the given layout takes, to size a descriptor pool for it
+    std::vector<VkDescriptorPoolSize> pool_sizes(VkDescriptorSetLayout setLayout) const;
+
+    size_t pipeline_layout_count() const
+    {
+        return _pipeline_layouts.size();
+    }
+
+    size_t set_layout_count() const
+    {
+        return _set_layouts.size();
+    }
+
+  private:
+    VkDevice _device{VK_NULL_HANDLE};
+    uint32_t _max_push_constants_size{0};
+    uint32_t _max_dynamic_uniform_buffers{0};
+    uint32_t _max_dynamic_storage_buffers{0};
+
+    std::unordered_map<std::string, VkDescriptorSetLayout> _set_layouts;
+    std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSetLayoutBinding>> _set_layout_bindings;
+    std::unordered_map<std::string, VkPipelineLayout> _pipeline_layouts;
+    std::unordered_map<VkPipelineLayout, std::vector<VkDescriptorSetLayout>> _pipeline_set_layouts;
+};
+} // namespace vulkan_engine
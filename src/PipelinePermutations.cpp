@@ -0,0 +1,175 @@
+#include "PipelinePermutations.h"
+
+#include <utility>
+
+namespace vulkan_engine
+{
+namespace
+{
+// point info at values, with outMapEntries resized to match. Constants are packed one after the other, constant_id i at
+// offset 4 * i
+void fill_specialisation_info(const SpecialisationValues &values, std::vector<VkSpecializationMapEntry> *outMapEntries,
+                              VkSpecializationInfo *outInfo)
+{
+    outMapEntries->resize(values.size());
+    for (uint32_t i = 0; i < outMapEntries->size(); ++i)
+    {
+        (*outMapEntries)[i].constantID = i;
+        (*outMapEntries)[i].offset = i * sizeof(uint32_t);
+        (*outMapEntries)[i].size = sizeof(uint32_t);
+    }
+
+    outInfo->mapEntryCount = static_cast<uint32_t>(outMapEntries->size());
+    outInfo->pMapEntries = outMapEntries->data();
+    outInfo->dataSize = values.size() * sizeof(uint32_t);
+    outInfo->pData = values.data();
+}
+} // namespace
+
+Specialisation::Specialisation(SpecialisationValues values) : _values(std::move(values))
+{
+    fill_specialisation_info(_values, &_map_entries, &_info);
+}
+
+void PipelinePermutations::init(PipelineRegistry *registry, size_t capacity)
+{
+    _registry = registry;
+    _capacity = capacity;
+}
+
+void PipelinePermutations::cleanup()
+{
+    _lookup.clear();
+    _variants.clear();
+    _evicted.clear();
+}
+
+VkPipeline PipelinePermutations::get_or_build(const PipelineBuilder &builder, VkRenderPass pass,
+                                              const SpecialisationValues &values)
+{
+    PipelineBuilder specialised_builder;
+    use_variant(builder, pass, values, &specialised_builder);
+
+    VkPipeline pipeline = _registry->get_or_build(specialised_builder, pass);
+    evict_cold_variants(_capacity);
+    return pipeline;
+}
+
+std::vector<VkPipeline> PipelinePermutations::get_or_build_all(const PipelineBuilder &builder, VkRenderPass pass,
+                                                              const std::vector<SpecialisationValues> &valueSets,
+                                                              ThreadPool *threadPool /*= nullptr*/)
+{
+    // nothing is evicted until the batch is built, so every specialisation the builders point at stays put
+    std::vector<PipelineBuilder> specialised_builders(valueSets.size());
+    for (size_t i = 0; i < valueSets.size(); ++i)
+    {
+        use_variant(builder, pass, valueSets[i], &specialised_builders[i]);
+    }
+
+    std::vector<VkPipeline> pipelines = _registry->get_or_build_all(specialised_builders, pass, threadPool);
+    evict_cold_variants(_capacity);
+    return pipelines;
+}
+
+PipelineHandle PipelinePermutations::build_async(const PipelineBuilder &builder, VkRenderPass pass,
+                                                 const SpecialisationValues &values, ThreadPool &threadPool,
+                                                 std::string *outKey /*= nullptr*/)
+{
+    PipelineBuilder specialised_builder;
+    const Variant &variant = use_variant(builder, pass, values, &specialised_builder);
+    if (outKey != nullptr)
+    {
+        *outKey = variant.key;
+    }
+
+    PipelineHandle handle = _registry->build_async(specialised_builder, pass, threadPool);
+    evict_cold_variants(_capacity);
+    return handle;
+}
+
+bool PipelinePermutations::remove(const std::string &key, VkPipeline *outPipeline)
+{
+    *outPipeline = VK_NULL_HANDLE;
+    auto it = _lookup.find(key);
+    if (it == _lookup.end())
+    {
+        // already evicted, along with its pipeline
+        return true;
+    }
+
+    if (!_registry->remove(key, outPipeline))
+    {
+        return false;
+    }
+
+    _variants.erase(it->second);
+    _lookup.erase(it);
+    return true;
+}
+
+std::vector<VkPipeline> PipelinePermutations::take_evicted()
+{
+    return std::exchange(_evicted, {});
+}
+
+PipelinePermutations::Variant &PipelinePermutations::use_variant(const PipelineBuilder &builder, VkRenderPass pass,
+                                                                 const SpecialisationValues &values,
+                                                                 PipelineBuilder *outBuilder)
+{
+    // the key covers the whole pipeline state and not just the values, so a builder that has changed since (e.g. a
+    // different raster state) gets a variant of its own. It is worked out with the caller's values in place, through
+    // map entries reused from lookup to lookup, so finding an existing variant doesn't allocate one
+    VkSpecializationInfo lookup_info = {}; // initialise struct to 0's
+    fill_specialisation_info(values, &_lookup_map_entries, &lookup_info);
+    *outBuilder = builder;
+    outBuilder->set_specialisation(&lookup_info);
+    std::string key = outBuilder->state_key(pass);
+
+    auto it = _lookup.find(key);
+    if (it != _lookup.end())
+    {
+        _variants.splice(_variants.begin(), _variants, it->second);
+    }
+    else
+    {
+        _variants.emplace_front(values);
+        _variants.front().key = key;
+        _lookup.emplace(std::move(key), _variants.begin());
+    }
+
+    // the builder mustn't be left pointing at lookup_info, which goes away when we return
+    outBuilder->set_specialisation(_variants.front().specialisation.info());
+    return _variants.front();
+}
+
+bool PipelinePermutations::trim(size_t keep)
+{
+    evict_cold_variants(keep);
+    return _variants.size() <= keep;
+}
+
+void PipelinePermutations::evict_cold_variants(size_t capacity)
+{
+    auto it = _variants.end();
+    while (_variants.size() > capacity && it != _variants.begin())
+    {
+        --it;
+
+        // a variant still compiling in the background keeps its place, its specialisation data is in use
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (!_registry->remove(it->key, &pipeline))
+        {
+            continue;
+        }
+
+        if (pipeline != VK_NULL_HANDLE)
+        {
+            _evicted.push_back(pipeline);
+            _evictions++;
+        }
+
+        _lookup.erase(it->key);
+        it = _variants.erase(it);
+    }
+}
+} // namespace vulkan_engine
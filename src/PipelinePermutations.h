@@ -0,0 +1,116 @@
+#pragma once
+
+#include "PipelineBuilder.h"
+#include "PipelineRegistry.h"
+#include "ThreadPool.h"
+#include "VulkanTypes.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vulkan_engine
+{
+// values for a shader's specialisation constants, where values[i] feeds constant_id i. Bool, int and float constants
+// are all 32 bits wide, so a uint32_t covers each of them
+using SpecialisationValues = std::vector<uint32_t>;
+
+// a VkSpecializationInfo together with the data it points at. It points into itself, so it can't be copied or moved
+class Specialisation
+{
+  public:
+    explicit Specialisation(SpecialisationValues values);
+
+    Specialisation(const Specialisation &) = delete;
+    Specialisation &operator=(const Specialisation &) = delete;
+
+    const VkSpecializationInfo *info() const
+    {
+        return &_info;
+    }
+
+  private:
+    SpecialisationValues _values;
+    std::vector<VkSpecializationMapEntry> _map_entries;
+    VkSpecializationInfo _info{};
+};
+
+// Turns one set of shader modules into as many pipeline variants as there are specialisation constant values, compiling
+// each variant the first time it is asked for. Only the most recently used variants are kept, once there are more than
+// capacity of them the coldest is dropped from the registry and handed back to be destroyed. Asking for it again later
+// rebuilds it, which the pipeline cache usually makes cheap.
+class PipelinePermutations
+{
+  public:
+    void init(PipelineRegistry *registry, size_t capacity);
+
+    // forget every variant, the registry still owns (and destroys) any that haven't been evicted
+    void cleanup();
+
+    // the pipeline for builder with its shader stages specialised by values, building it if needed
+    VkPipeline get_or_build(const PipelineBuilder &builder, VkRenderPass pass, const SpecialisationValues &values);
+
+    // several variants of builder at once, with whichever need building created as one batch
+    std::vector<VkPipeline> get_or_build_all(const PipelineBuilder &builder, VkRenderPass pass,
+                                             const std::vector<SpecialisationValues> &valueSets,
+                                             ThreadPool *threadPool = nullptr);
+
+    // as get_or_build(), but a pipeline that needs building is compiled on threadPool. outKey, when given, is set to
+    // the variant's key for remove()
+    PipelineHandle build_async(const PipelineBuilder &builder, VkRenderPass pass, const SpecialisationValues &values,
+                               ThreadPool &threadPool, std::string *outKey = nullptr);
+
+    // drop the variant with this key, e.g. one that turned out to be unusable, handing its pipeline (if it has one)
+    // back to be destroyed once nothing uses it. False (and kept) while it is still compiling
+    bool remove(const std::string &key, VkPipeline *outPipeline);
+
+    // pipelines evicted since the last call. Frames in flight may still be using them, so the caller destroys them
+    // once those have finished
+    std::vector<VkPipeline> take_evicted();
+
+    // drop all but the keep most recently used variants, e.g. once the shaders behind the others are stale. False if
+    // some had to stay because they are still compiling in the background
+    bool trim(size_t keep);
+
+    size_t resident_count() const
+    {
+        return _variants.size();
+    }
+
+    uint64_t evictions() const
+    {
+        return _evictions;
+    }
+
+  private:
+    struct Variant
+    {
+        explicit Variant(const SpecialisationValues &values) : specialisation(values)
+        {
+        }
+
+        std::string key; // the registry key of the specialised pipeline
+        Specialisation specialisation;
+    };
+
+    // find (or add) the variant for values and mark it as the most recently used. outBuilder is set up to build it
+    Variant &use_variant(const PipelineBuilder &builder, VkRenderPass pass, const SpecialisationValues &values,
+                         PipelineBuilder *outBuilder);
+
+    // drop the coldest variants until there are no more than capacity of them
+    void evict_cold_variants(size_t capacity);
+
+    PipelineRegistry *_registry{nullptr};
+    size_t _capacity{0};
+
+    // most recently used at the front. List nodes never move, so the specialisation data a background build points
+    // at stays put
+    std::list<Variant> _variants;
+    std::unordered_map<std::string, std::list<Variant>::iterator> _lookup;
+    std::vector<VkSpecializationMapEntry> _lookup_map_entries; // reused by every lookup, so they don't allocate
+
+    std::vector<VkPipeline> _evicted;
+    uint64_t _evictions{0};
+};
+} // namespace vulkan_engine
@@ -0,0 +1,367 @@
+#include "PipelineRegistry.h"
+
+#include "PipelineBatch.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace vulkan_engine
+{
+bool PipelineHandle::is_ready() const
+{
+    return _entry != nullptr && _entry->ready.load(std::memory_order_acquire);
+}
+
+VkPipeline PipelineHandle::get_or(VkPipeline fallback) const
+{
+    if (!is_ready())
+    {
+        return fallback;
+    }
+
+    VkPipeline pipeline = _entry->pipeline.load(std::memory_order_acquire);
+    return pipeline != VK_NULL_HANDLE ? pipeline : fallback;
+}
+
+void PipelineRegistry::init(VkDevice device, VkPipelineCache pipelineCache)
+{
+    _device = device;
+    _pipeline_cache = pipelineCache;
+}
+
+void PipelineRegistry::cleanup()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto &entry : _pipelines)
+    {
+        vkDestroyPipeline(_device, entry.second->pipeline, nullptr);
+    }
+
+    // nobody collected these, so nobody is using the pipelines they replaced
+    for (const PipelineUpgrade &upgrade : _upgrades)
+    {
+        vkDestroyPipeline(_device, upgrade.old_pipeline, nullptr);
+    }
+
+    _pipelines.clear();
+    _upgrades.clear();
+
+    // only once every pipeline linked from them is gone
+    std::lock_guard<std::mutex> library_lock(_library_mutex);
+    for (auto &library : _libraries)
+    {
+        vkDestroyPipeline(_device, library.second.get(), nullptr);
+    }
+
+    _libraries.clear();
+}
+
+void PipelineRegistry::enable_pipeline_libraries(ThreadPool *optimisePool)
+{
+    _optimise_pool = optimisePool;
+}
+
+std::vector<PipelineUpgrade> PipelineRegistry::take_upgrades()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return std::exchange(_upgrades, {});
+}
+
+VkPipeline PipelineRegistry::get_or_build(const PipelineBuilder &builder, VkRenderPass pass)
+{
+    const auto request_time = std::chrono::steady_clock::now();
+    const std::string key = builder.state_key(pass);
+
+    bool is_new = false;
+    std::shared_ptr<Entry> entry = find_or_insert(key, &is_new);
+    if (is_new)
+    {
+        build(entry, key, builder, pass, request_time, false);
+    }
+    else
+    {
+        // somebody else asked first, and may still be building it in the background
+        entry->built.wait();
+    }
+
+    return entry->pipeline;
+}
+
+PipelineHandle PipelineRegistry::build_async(const PipelineBuilder &builder, VkRenderPass pass,
+                                             ThreadPool &threadPool)
+{
+    const auto request_time = std::chrono::steady_clock::now();
+    std::string key = builder.state_key(pass);
+
+    bool is_new = false;
+    std::shared_ptr<Entry> entry = find_or_insert(key, &is_new);
+    if (is_new)
+    {
+        // the builder is copied so the caller is free to reuse theirs straight away
+        threadPool.submit([this, entry, key = std::move(key), builder, pass, request_time]() {
+            build(entry, key, builder, pass, request_time, true);
+        });
+    }
+
+    return PipelineHandle(entry);
+}
+
+std::vector<VkPipeline> PipelineRegistry::get_or_build_all(const std::vector<PipelineBuilder> &builders,
+                                                          VkRenderPass pass, ThreadPool *threadPool /*= nullptr*/)
+{
+    const auto request_time = std::chrono::steady_clock::now();
+
+    // everything that isn't in the registry yet goes into a single batch
+    std::vector<std::shared_ptr<Entry>> entries(builders.size());
+    std::vector<std::string> batch_keys;
+    std::vector<size_t> batch_builders;
+    PipelineBatch batch;
+    for (size_t i = 0; i < builders.size(); ++i)
+    {
+        std::string key = builders[i].state_key(pass);
+
+        bool is_new = false;
+        entries[i] = find_or_insert(key, &is_new);
+        if (is_new)
+        {
+            batch.add(builders[i], pass);
+            batch_keys.push_back(std::move(key));
+            batch_builders.push_back(i);
+        }
+    }
+
+    if (batch.size() > 0 && _optimise_pool != nullptr)
+    {
+        // linking precompiled parts is already cheap, so there's nothing to gain from batching
+        for (size_t i = 0; i < batch_keys.size(); ++i)
+        {
+            build(entries[batch_builders[i]], batch_keys[i], builders[batch_builders[i]], pass, request_time, false);
+        }
+    }
+    else if (batch.size() > 0)
+    {
+        const auto compile_start = std::chrono::steady_clock::now();
+        const std::vector<VkPipeline> pipelines = batch.build(_device, _pipeline_cache, threadPool);
+        const std::chrono::duration<double, std::milli> compile_time = std::chrono::steady_clock::now() - compile_start;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _compile_stats.batches++;
+        }
+
+        // the driver doesn't say how long each pipeline took, so they share the batch's time equally
+        for (size_t i = 0; i < pipelines.size(); ++i)
+        {
+            publish(*entries[batch_builders[i]], batch_keys[i], pipelines[i], compile_time.count() / pipelines.size(),
+                    request_time, false);
+        }
+    }
+
+    // the rest were already built, or are being built by someone else
+    std::vector<VkPipeline> pipelines(builders.size());
+    for (size_t i = 0; i < builders.size(); ++i)
+    {
+        entries[i]->built.wait();
+        pipelines[i] = entries[i]->pipeline;
+    }
+
+    return pipelines;
+}
+
+PipelineCompileStats PipelineRegistry::compile_stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _compile_stats;
+}
+
+size_t PipelineRegistry::pipeline_count()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _pipelines.size();
+}
+
+bool PipelineRegistry::remove(const std::string &key, VkPipeline *outPipeline)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    *outPipeline = VK_NULL_HANDLE;
+    auto it = _pipelines.find(key);
+    if (it == _pipelines.end())
+    {
+        return true;
+    }
+
+    if (!it->second->ready.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    *outPipeline = it->second->pipeline.load(std::memory_order_acquire);
+    _pipelines.erase(it);
+    return true;
+}
+
+std::shared_ptr<PipelineRegistry::Entry> PipelineRegistry::find_or_insert(const std::string &key, bool *outIsNew)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const auto existing = _pipelines.find(key);
+    if (existing != _pipelines.end())
+    {
+        _hits++;
+        *outIsNew = false;
+        return existing->second;
+    }
+
+    _misses++;
+    *outIsNew = true;
+
+    auto entry = std::make_shared<Entry>();
+    entry->built = entry->built_promise.get_future().share();
+    _pipelines.emplace(key, entry);
+    return entry;
+}
+
+void PipelineRegistry::build(const std::shared_ptr<Entry> &entry, const std::string &key,
+                             const PipelineBuilder &builder, VkRenderPass pass,
+                             std::chrono::steady_clock::time_point requestTime, bool async)
+{
+    const auto compile_start = std::chrono::steady_clock::now();
+    VkPipeline pipeline = _optimise_pool != nullptr ? build_from_libraries(entry, key, builder, pass)
+                                                    : builder.build_pipeline(_device, pass, _pipeline_cache);
+    const std::chrono::duration<double, std::milli> compile_time = std::chrono::steady_clock::now() - compile_start;
+
+    publish(*entry, key, pipeline, compile_time.count(), requestTime, async);
+}
+
+VkPipeline PipelineRegistry::build_from_libraries(const std::shared_ptr<Entry> &entry, const std::string &key,
+                                                  const PipelineBuilder &builder, VkRenderPass pass)
+{
+    std::vector<VkPipeline> libraries;
+    for (VkGraphicsPipelineLibraryFlagsEXT part : {VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+                                                   VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+                                                   VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+                                                   VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT})
+    {
+        VkPipeline library = get_or_build_library(builder, pass, part);
+        if (library == VK_NULL_HANDLE)
+        {
+            return VK_NULL_HANDLE;
+        }
+        libraries.push_back(library);
+    }
+
+    VkPipeline pipeline = PipelineBuilder::link_libraries(_device, builder.pipeline_layout, libraries, false);
+    if (pipeline == VK_NULL_HANDLE)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    // the libraries outlive every pipeline linked from them, so the optimised link can use them whenever it runs
+    _optimise_pool->submit([this, entry, key, libraries, layout = builder.pipeline_layout]() {
+        // the fast linked pipeline has to be published before it can be replaced
+        entry->built.wait();
+
+        const auto optimise_start = std::chrono::steady_clock::now();
+        VkPipeline optimised = PipelineBuilder::link_libraries(_device, layout, libraries, true, _pipeline_cache);
+        const std::chrono::duration<double, std::milli> optimise_time =
+            std::chrono::steady_clock::now() - optimise_start;
+        if (optimised == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _compile_stats.optimised_links++;
+        _compile_stats.total_optimise_ms += optimise_time.count();
+
+        // if the pipeline was removed while we were optimising it, the optimised one isn't wanted either
+        const auto it = _pipelines.find(key);
+        if (it == _pipelines.end() || it->second != entry)
+        {
+            _upgrades.push_back({optimised, VK_NULL_HANDLE});
+            return;
+        }
+
+        _upgrades.push_back({entry->pipeline.load(std::memory_order_acquire), optimised});
+        entry->pipeline.store(optimised, std::memory_order_release);
+    });
+
+    return pipeline;
+}
+
+VkPipeline PipelineRegistry::get_or_build_library(const PipelineBuilder &builder, VkRenderPass pass,
+                                                  VkGraphicsPipelineLibraryFlagsEXT part)
+{
+    const std::string key = builder.library_key(pass, part);
+
+    // claim the part under the lock, but compile it outside, so libraries for different parts build in parallel
+    std::promise<VkPipeline> built_promise;
+    std::shared_future<VkPipeline> existing_library;
+    {
+        std::lock_guard<std::mutex> lock(_library_mutex);
+        const auto existing = _libraries.find(key);
+        if (existing != _libraries.end())
+        {
+            existing_library = existing->second;
+        }
+        else
+        {
+            _libraries.emplace(key, built_promise.get_future().share());
+        }
+    }
+
+    // somebody else is compiling it (or already has), so wait for theirs instead of compiling it again
+    if (existing_library.valid())
+    {
+        return existing_library.get();
+    }
+
+    VkPipeline library = builder.build_library(_device, pass, part, _pipeline_cache);
+    if (library == VK_NULL_HANDLE)
+    {
+        // failed parts aren't remembered, so a later request gets to try again
+        {
+            std::lock_guard<std::mutex> lock(_library_mutex);
+            _libraries.erase(key);
+        }
+        built_promise.set_value(VK_NULL_HANDLE);
+        return VK_NULL_HANDLE;
+    }
+    built_promise.set_value(library);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _compile_stats.libraries++;
+    return library;
+}
+
+void PipelineRegistry::publish(Entry &entry, const std::string &key, VkPipeline pipeline, double compileMs,
+                               std::chrono::steady_clock::time_point requestTime, bool async)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (pipeline == VK_NULL_HANDLE)
+        {
+            // failed builds aren't remembered, so a later request gets to try again
+            _pipelines.erase(key);
+        }
+
+        _compile_stats.compiles++;
+        _compile_stats.total_compile_ms += compileMs;
+        _compile_stats.max_compile_ms = std::max(_compile_stats.max_compile_ms, compileMs);
+
+        if (async)
+        {
+            const std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - requestTime;
+            _compile_stats.async_compiles++;
+            _compile_stats.total_latency_ms += latency.count();
+            _compile_stats.max_latency_ms = std::max(_compile_stats.max_latency_ms, latency.count());
+        }
+    }
+
+    entry.pipeline.store(pipeline, std::memory_order_release);
+    entry.ready.store(true, std::memory_order_release);
+    entry.built_promise.set_value();
+}
+} // namespace vulkan_engine
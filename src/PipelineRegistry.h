@@ -0,0 +1,173 @@
+#pragma once
+
+#include "PipelineBuilder.h"
+#include "ThreadPool.h"
+#include "VulkanTypes.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vulkan_engine
+{
+// compile timings for pipelines that missed the registry
+struct PipelineCompileStats
+{
+    uint64_t compiles{0};
+    double total_compile_ms{0}; // time spent inside vkCreateGraphicsPipelines
+    double max_compile_ms{0};
+    uint64_t async_compiles{0};
+    double total_latency_ms{0}; // request to ready, including time queued behind other builds
+    double max_latency_ms{0};
+    uint64_t batches{0}; // get_or_build_all() calls that had something to build
+    uint64_t libraries{0};       // pipeline library parts compiled
+    uint64_t optimised_links{0}; // fast linked pipelines replaced by an optimised link
+    double total_optimise_ms{0};
+};
+
+// a pipeline the registry has replaced. Wherever old_pipeline is used, new_pipeline should be used instead, and
+// old_pipeline destroyed once nothing in flight uses it. new_pipeline is VK_NULL_HANDLE if the pipeline was removed
+// from the registry in the meantime, in which case old_pipeline only needs destroying
+struct PipelineUpgrade
+{
+    VkPipeline old_pipeline;
+    VkPipeline new_pipeline;
+};
+
+// A pipeline that may still be compiling. Polling it never blocks, so it can be checked every frame
+class PipelineHandle
+{
+  public:
+    PipelineHandle() = default;
+
+    bool valid() const
+    {
+        return _entry != nullptr;
+    }
+
+    // true once the pipeline has been built (or failed to build)
+    bool is_ready() const;
+
+    // the built pipeline, or fallback while it is still compiling or if it failed
+    VkPipeline get_or(VkPipeline fallback) const;
+
+  private:
+    friend class PipelineRegistry;
+
+    struct Entry
+    {
+        std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+        std::atomic<bool> ready{false};
+        std::promise<void> built_promise; // fulfilled by whoever builds the pipeline
+        std::shared_future<void> built;   // lets a synchronous request wait for an in-flight build
+    };
+
+    explicit PipelineHandle(std::shared_ptr<Entry> entry) : _entry(std::move(entry))
+    {
+    }
+
+    std::shared_ptr<Entry> _entry;
+};
+
+// Sits in front of PipelineBuilder and hands out one VkPipeline per unique pipeline state. Requests are keyed on the
+// builder's full state (shaders, fixed-function state, layout and render pass), so asking for the same pipeline twice
+// is a hash lookup rather than a second compile. Builds can either happen immediately or be queued on worker threads,
+// and the registry owns every pipeline it creates.
+//
+// With pipeline libraries enabled, each pipeline is fast linked from separately compiled parts, which are shared with
+// every other pipeline that has the same state for that part. A new combination of already seen parts is then ready
+// almost immediately, and an optimised link replaces it in the background (see take_upgrades()).
+class PipelineRegistry
+{
+  public:
+    void init(VkDevice device, VkPipelineCache pipelineCache);
+
+    // destroys every pipeline handed out. Any background builds must have finished
+    void cleanup();
+
+    // build pipelines by linking VK_EXT_graphics_pipeline_library parts, with the optimised links done on
+    // optimisePool. The device must have the extension enabled
+    void enable_pipeline_libraries(ThreadPool *optimisePool);
+
+    // pipelines replaced since the last call, by optimised links of pipeline libraries
+    std::vector<PipelineUpgrade> take_upgrades();
+
+    // return the pipeline for this state, building it on first use (or waiting for a background build of it)
+    VkPipeline get_or_build(const PipelineBuilder &builder, VkRenderPass pass);
+
+    // queue the pipeline for this state to be built on threadPool, returning straight away. Anything the builder
+    // points at (shader modules, vertex input descriptions, specialisation data) must stay alive until it is ready
+    PipelineHandle build_async(const PipelineBuilder &builder, VkRenderPass pass, ThreadPool &threadPool);
+
+    // the pipelines for several states at once, with any that need building created as one batch (split over
+    // threadPool when given) rather than one driver call each
+    std::vector<VkPipeline> get_or_build_all(const std::vector<PipelineBuilder> &builders, VkRenderPass pass,
+                                             ThreadPool *threadPool = nullptr);
+
+    uint64_t hits() const
+    {
+        return _hits;
+    }
+
+    uint64_t misses() const
+    {
+        return _misses;
+    }
+
+    PipelineCompileStats compile_stats();
+
+    // how many distinct pipelines have been built
+    size_t pipeline_count();
+
+    // forget the pipeline for key, handing it back for the caller to destroy once nothing uses it anymore. Returns
+    // false (and keeps it) while it is still being built
+    bool remove(const std::string &key, VkPipeline *outPipeline);
+
+  private:
+    using Entry = PipelineHandle::Entry;
+
+    // find the entry for key, or add a new one. outIsNew is set when the caller is responsible for building it
+    std::shared_ptr<Entry> find_or_insert(const std::string &key, bool *outIsNew);
+
+    // compile the pipeline for entry, publish it and record how long it took
+    void build(const std::shared_ptr<Entry> &entry, const std::string &key, const PipelineBuilder &builder,
+               VkRenderPass pass, std::chrono::steady_clock::time_point requestTime, bool async);
+
+    // fast link the pipeline for builder from its library parts (compiling any we haven't seen), and queue the
+    // optimised link
+    VkPipeline build_from_libraries(const std::shared_ptr<Entry> &entry, const std::string &key,
+                                    const PipelineBuilder &builder, VkRenderPass pass);
+
+    // the library for one part of builder's pipeline, compiling it on first use
+    VkPipeline get_or_build_library(const PipelineBuilder &builder, VkRenderPass pass,
+                                    VkGraphicsPipelineLibraryFlagsEXT part);
+
+    // hand a freshly compiled pipeline to entry's waiters and record how long it took
+    void publish(Entry &entry, const std::string &key, VkPipeline pipeline, double compileMs,
+                 std::chrono::steady_clock::time_point requestTime, bool async);
+
+    VkDevice _device{VK_NULL_HANDLE};
+    VkPipelineCache _pipeline_cache{VK_NULL_HANDLE};
+
+    // worker threads add entries too, so the map and stats are behind a lock
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> _pipelines;
+
+    std::atomic<uint64_t> _hits{0};
+    std::atomic<uint64_t> _misses{0};
+    PipelineCompileStats _compile_stats;
+
+    // only set with pipeline libraries enabled
+    ThreadPool *_optimise_pool{nullptr};
+    std::vector<PipelineUpgrade> _upgrades; // behind _mutex
+
+    // libraries are keyed on the state of the part they cover. The first request for a part inserts its future and
+    // compiles it outside the lock, later ones wait on the future, so each part is only ever compiled once
+    std::mutex _library_mutex;
+    std::unordered_map<std::string, std::shared_future<VkPipeline>> _libraries;
+};
+} // namespace vulkan_engine
@@ -0,0 +1,153 @@
+#include "PresentThread.h"
+
+namespace vulkan_engine
+{
+void PresentThread::init(VkDevice device, VkQueue presentQueue, std::mutex *queueMutex)
+{
+    _device = device;
+    _present_queue = presentQueue;
+    _queue_mutex = queueMutex;
+
+    _running = true;
+    _thread = std::thread(&PresentThread::thread_main, this);
+}
+
+void PresentThread::cleanup()
+{
+    if (!_thread.joinable())
+    {
+        return;
+    }
+
+    wait_idle();
+
+    _running = false;
+    notify();
+    _thread.join();
+}
+
+void PresentThread::request_acquire(VkSwapchainKHR swapchain, VkSemaphore semaphore)
+{
+    push_request({Request::Type::acquire, swapchain, semaphore, 0});
+}
+
+void PresentThread::request_present(VkSwapchainKHR swapchain, VkSemaphore waitSemaphore, uint32_t imageIndex)
+{
+    push_request({Request::Type::present, swapchain, waitSemaphore, imageIndex});
+}
+
+AcquireResult PresentThread::wait_for_acquire()
+{
+    AcquireResult result = {};
+    while (!_acquired.try_pop(result))
+    {
+        wait_until([this]() { return !_acquired.empty(); });
+    }
+
+    return result;
+}
+
+void PresentThread::wait_for_presents(uint64_t presentCount)
+{
+    wait_until([this, presentCount]() { return _presents_completed >= presentCount; });
+}
+
+void PresentThread::wait_idle()
+{
+    wait_until([this]() { return _requests_processed == _requests_pushed; });
+}
+
+bool PresentThread::take_swapchain_out_of_date()
+{
+    return _swapchain_out_of_date.exchange(false);
+}
+
+void PresentThread::push_request(const Request &request)
+{
+    // the main thread never has more than a couple of requests outstanding, so this only spins if something is
+    // badly wrong
+    while (!_requests.try_push(request))
+    {
+        std::this_thread::yield();
+    }
+
+    _requests_pushed++;
+    notify();
+}
+
+void PresentThread::notify()
+{
+    // taking the lock (even briefly) orders this notification after any waiter's predicate check, so a wake-up can
+    // never be lost between a waiter checking its predicate and going to sleep
+    {
+        std::lock_guard<std::mutex> lock(_wake_mutex);
+    }
+    _wake.notify_all();
+}
+
+void PresentThread::thread_main()
+{
+    while (true)
+    {
+        Request request;
+        if (!_requests.try_pop(request))
+        {
+            if (!_running)
+            {
+                break;
+            }
+
+            wait_until([this]() { return !_requests.empty() || !_running; });
+            continue;
+        }
+
+        if (request.type == Request::Type::acquire)
+        {
+            // this is where FIFO blocks until the presentation engine hands an image back, with a timeout of 1 second
+            AcquireResult result = {};
+            result.result = vkAcquireNextImageKHR(_device, request.swapchain, 1000000000 /*ns*/, request.semaphore,
+                                                  VK_NULL_HANDLE, &result.image_index);
+
+            while (!_acquired.try_push(result))
+            {
+                std::this_thread::yield();
+            }
+        }
+        else
+        {
+            VkPresentInfoKHR present_info = {}; // initialise struct to 0's
+            present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+            present_info.pNext = nullptr;
+
+            present_info.swapchainCount = 1;
+            present_info.pSwapchains = &request.swapchain;
+
+            present_info.waitSemaphoreCount = 1;
+            present_info.pWaitSemaphores = &request.semaphore;
+
+            present_info.pImageIndices = &request.image_index;
+
+            VkResult present_result;
+            {
+                std::lock_guard<std::mutex> lock(*_queue_mutex);
+                present_result = vkQueuePresentKHR(_present_queue, &present_info);
+            }
+
+            // an out of date swapchain is rebuilt by the main thread before its next frame
+            if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR)
+            {
+                _swapchain_out_of_date = true;
+            }
+            else
+            {
+                VK_CHECK(present_result);
+            }
+
+            _presents_completed++;
+        }
+
+        _requests_processed++;
+        notify();
+    }
+}
+} // namespace vulkan_engine
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "SpscQueue.h"
+#include "VulkanTypes.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace vulkan_engine
+{
+// the outcome of a vkAcquireNextImageKHR issued on the present thread
+struct AcquireResult
+{
+    VkResult result;
+    uint32_t image_index;
+};
+
+// Runs vkAcquireNextImageKHR and vkQueuePresentKHR on a dedicated thread, so that a throttled presentation engine
+// (e.g. FIFO waiting for vblank) never blocks the main thread's event loop or frame recording. Requests and results
+// are passed through lock-free queues, the only lock taken is the queue mutex Vulkan requires around queue access
+class PresentThread
+{
+  public:
+    // queueMutex must be held by anyone else submitting to presentQueue
+    void init(VkDevice device, VkQueue presentQueue, std::mutex *queueMutex);
+
+    // finishes all outstanding requests and joins the thread
+    void cleanup();
+
+    // ask for the next swapchain image, signalling semaphore once it is ready. Collect it with wait_for_acquire()
+    void request_acquire(VkSwapchainKHR swapchain, VkSemaphore semaphore);
+
+    // present an image once waitSemaphore has been signalled
+    void request_present(VkSwapchainKHR swapchain, VkSemaphore waitSemaphore, uint32_t imageIndex);
+
+    // block until the oldest outstanding acquire has completed
+    AcquireResult wait_for_acquire();
+
+    // block until at least presentCount presents have been handed to the presentation engine
+    void wait_for_presents(uint64_t presentCount);
+
+    // block until every request has been processed, after which the thread no longer touches any swapchain
+    void wait_idle();
+
+    // true (once) if a present reported the swapchain as out of date or suboptimal
+    bool take_swapchain_out_of_date();
+
+  private:
+    struct Request
+    {
+        enum class Type
+        {
+            acquire,
+            present
+        } type;
+        VkSwapchainKHR swapchain;
+        VkSemaphore semaphore;
+        uint32_t image_index;
+    };
+
+    void thread_main();
+
+    void push_request(const Request &request);
+
+    // wake up anyone parked in wait_until()
+    void notify();
+
+    template <typename Predicate> void wait_until(Predicate predicate)
+    {
+        std::unique_lock<std::mutex> lock(_wake_mutex);
+        _wake.wait(lock, predicate);
+    }
+
+    VkDevice _device{VK_NULL_HANDLE};
+    VkQueue _present_queue{VK_NULL_HANDLE};
+    std::mutex *_queue_mutex{nullptr};
+
+    std::thread _thread;
+    std::atomic<bool> _running{false};
+
+    SpscQueue<Request, 16> _requests;      // main thread -> present thread
+    SpscQueue<AcquireResult, 16> _acquired; // present thread -> main thread
+
+    uint64_t _requests_pushed{0}; // only touched by the main thread
+    std::atomic<uint64_t> _requests_processed{0};
+    std::atomic<uint64_t> _presents_completed{0};
+    std::atomic<bool> _swapchain_out_of_date{false};
+
+    // only used to park a thread when there is nothing to do, never on the path that moves requests around
+    std::mutex _wake_mutex;
+    std::condition_variable _wake;
+};
+} // namespace vulkan_engine
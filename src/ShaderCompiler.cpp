@@ -0,0 +1,521 @@
+#include "ShaderCompiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+#include "Hash.h"
+#include "Spirv.h"
+
+namespace vulkan_engine
+{
+namespace
+{
+// strings go into the key with their length in front, so "ab" + "c" and "a" + "bc" can't be mistaken for each other
+void append_string(std::string &key, const std::string &value)
+{
+    const uint64_t size = value.size();
+    key.append(reinterpret_cast<const char *>(&size), sizeof(size));
+    key.append(value);
+}
+
+bool read_file(const std::filesystem::path &path, std::string *outContents)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    *outContents = contents.str();
+    return true;
+}
+
+#ifdef _WIN32
+// quote an argument so the child's CommandLineToArgvW hands it back unchanged: backslashes are only special in front
+// of a quote, where they have to be doubled
+std::string quote_argument(const std::string &argument)
+{
+    std::string quoted = "\"";
+    size_t backslashes = 0;
+    for (const char c : argument)
+    {
+        if (c == '\\')
+        {
+            backslashes++;
+            continue;
+        }
+
+        quoted.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+        quoted += c;
+        backslashes = 0;
+    }
+    quoted.append(backslashes * 2, '\\');
+    quoted += '"';
+    return quoted;
+}
+#endif
+
+// run a program (arguments[0], looked up on the PATH) and collect everything it prints. No shell is involved, so the
+// arguments reach it exactly as given. Returns its exit status, or -1 if it couldn't be run
+int run_process(const std::vector<std::string> &arguments, std::string *outOutput)
+{
+#ifdef _WIN32
+    std::string command_line;
+    for (const std::string &argument : arguments)
+    {
+        command_line += (command_line.empty() ? "" : " ") + quote_argument(argument);
+    }
+
+    // the write end has to be inheritable for the child to get it, but the read end never is
+    SECURITY_ATTRIBUTES security_attributes = {}; // initialise struct to 0's
+    security_attributes.nLength = sizeof(security_attributes);
+    security_attributes.bInheritHandle = TRUE;
+    HANDLE read_pipe;
+    HANDLE write_pipe;
+    if (!CreatePipe(&read_pipe, &write_pipe, &security_attributes, 0))
+    {
+        return -1;
+    }
+    SetHandleInformation(read_pipe, HANDLE_FLAG_INHERIT, 0);
+
+    // a child would otherwise inherit every inheritable handle, including the write ends of compiles running on other
+    // threads, and their reads wouldn't finish until it exited. Listing the handles limits it to its own pipe
+    SIZE_T attribute_list_size = 0;
+    InitializeProcThreadAttributeList(nullptr, 1, 0, &attribute_list_size);
+    std::vector<char> attribute_list_storage(attribute_list_size);
+    auto attribute_list = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attribute_list_storage.data());
+    if (!InitializeProcThreadAttributeList(attribute_list, 1, 0, &attribute_list_size))
+    {
+        CloseHandle(read_pipe);
+        CloseHandle(write_pipe);
+        return -1;
+    }
+
+    BOOL created = UpdateProcThreadAttribute(attribute_list, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, &write_pipe,
+                                             sizeof(write_pipe), nullptr, nullptr);
+
+    // the compiler doesn't read its input, so it gets none rather than an inherited handle outside the list
+    STARTUPINFOEXA startup_info = {}; // initialise struct to 0's
+    startup_info.StartupInfo.cb = sizeof(startup_info);
+    startup_info.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startup_info.StartupInfo.hStdInput = nullptr;
+    startup_info.StartupInfo.hStdOutput = write_pipe;
+    startup_info.StartupInfo.hStdError = write_pipe;
+    startup_info.lpAttributeList = attribute_list;
+
+    PROCESS_INFORMATION process_info = {}; // initialise struct to 0's
+    created = created && CreateProcessA(nullptr, command_line.data(), nullptr, nullptr, TRUE,
+                                        CREATE_NO_WINDOW | EXTENDED_STARTUPINFO_PRESENT, nullptr, nullptr,
+                                        &startup_info.StartupInfo, &process_info);
+    DeleteProcThreadAttributeList(attribute_list);
+    CloseHandle(write_pipe);
+    if (!created)
+    {
+        CloseHandle(read_pipe);
+        return -1;
+    }
+
+    char buffer[256];
+    DWORD bytes_read;
+    while (ReadFile(read_pipe, buffer, sizeof(buffer), &bytes_read, nullptr) && bytes_read > 0)
+    {
+        outOutput->append(buffer, bytes_read);
+    }
+    CloseHandle(read_pipe);
+
+    DWORD exit_code = 0;
+    WaitForSingleObject(process_info.hProcess, INFINITE);
+    GetExitCodeProcess(process_info.hProcess, &exit_code);
+    CloseHandle(process_info.hThread);
+    CloseHandle(process_info.hProcess);
+    return static_cast<int>(exit_code);
+#else
+    // close-on-exec, so a child spawned by another compile at the same time can't keep our pipe open. The dup2 below
+    // clears it on the child's own copies
+    int pipe_fds[2];
+#ifdef __linux__
+    if (pipe2(pipe_fds, O_CLOEXEC) != 0)
+    {
+        return -1;
+    }
+#else
+    if (pipe(pipe_fds) != 0)
+    {
+        return -1;
+    }
+    fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipe_fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_adddup2(&file_actions, pipe_fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, pipe_fds[1], STDERR_FILENO);
+
+    std::vector<char *> argv;
+    for (const std::string &argument : arguments)
+    {
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    const int spawned = posix_spawnp(&pid, argv[0], &file_actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&file_actions);
+    close(pipe_fds[1]);
+    if (spawned != 0)
+    {
+        close(pipe_fds[0]);
+        return -1;
+    }
+
+    char buffer[256];
+    ssize_t bytes_read;
+    while ((bytes_read = read(pipe_fds[0], buffer, sizeof(buffer))) != 0)
+    {
+        if (bytes_read < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        outOutput->append(buffer, static_cast<size_t>(bytes_read));
+    }
+    close(pipe_fds[0]);
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+// this process's id, which keeps the temporary files of several runs sharing a cache directory apart
+uint64_t process_id()
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint64_t>(getpid());
+#endif
+}
+
+// the file named by an #include directive on this line, if it is one
+bool parse_include(const std::string &line, std::string *outName, bool *outQuoted)
+{
+    size_t position = line.find_first_not_of(" \t");
+    if (position == std::string::npos || line[position] != '#')
+    {
+        return false;
+    }
+
+    position = line.find_first_not_of(" \t", position + 1);
+    if (position == std::string::npos || line.compare(position, 7, "include") != 0)
+    {
+        return false;
+    }
+
+    position = line.find_first_not_of(" \t", position + 7);
+    if (position == std::string::npos || (line[position] != '"' && line[position] != '<'))
+    {
+        return false;
+    }
+
+    const char terminator = line[position] == '"' ? '"' : '>';
+    const size_t end = line.find(terminator, position + 1);
+    if (end == std::string::npos)
+    {
+        return false;
+    }
+
+    *outName = line.substr(position + 1, end - position - 1);
+    *outQuoted = terminator == '"';
+    return true;
+}
+} // namespace
+
+bool ShaderCompiler::init(const std::string &compilerPath, const std::string &cacheDirectory,
+                          std::vector<std::string> includeDirectories, ThreadPool *threadPool)
+{
+    _compiler_path = compilerPath;
+    _cache_directory = cacheDirectory;
+    _include_directories = std::move(includeDirectories);
+    _thread_pool = threadPool;
+
+    // a compiler update may well produce different code, so its version is part of every key
+    _compiler_version.clear();
+    if (run_process({_compiler_path, "--version"}, &_compiler_version) != 0)
+    {
+        std::cout << "Can't run the shader compiler " << _compiler_path << ": " << _compiler_version << std::endl;
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(_cache_directory, error);
+    if (error)
+    {
+        std::cout << "Can't create the shader cache " << cacheDirectory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+CompiledShader ShaderCompiler::compile(const ShaderCompileRequest &request)
+{
+    CompiledShader result;
+    std::string key;
+    if (!make_key(request, &key, &result.log))
+    {
+        return result;
+    }
+
+    std::ostringstream file_name;
+    file_name << std::hex << std::setw(16) << std::setfill('0') << hash_bytes(key.data(), key.size());
+    const std::filesystem::path cache_path = _cache_directory / (file_name.str() + ".spvc");
+
+    if (read_cached(cache_path, key, &result.code))
+    {
+        _cache_hits++;
+        result.success = true;
+        result.from_cache = true;
+        return result;
+    }
+
+    const std::filesystem::path output_path = _cache_directory / (file_name.str() + "." + temp_suffix() + ".spv");
+    const bool compiled = run_compiler(request, output_path.string(), &result.log);
+
+    std::string code;
+    const bool read = compiled && read_file(output_path, &code);
+    std::error_code error;
+    std::filesystem::remove(output_path, error);
+    if (!read)
+    {
+        return result;
+    }
+
+    std::string reason;
+    if (!is_valid_spirv(code.data(), code.size(), &reason))
+    {
+        result.log = "the compiler's output can't be used as a shader: " + reason;
+        return result;
+    }
+
+    _compiles++;
+    result.code.resize(code.size() / sizeof(uint32_t));
+    std::copy(code.begin(), code.end(), reinterpret_cast<char *>(result.code.data()));
+    result.success = true;
+
+    write_cached(cache_path, key, result.code);
+    return result;
+}
+
+std::future<CompiledShader> ShaderCompiler::compile_async(ShaderCompileRequest request)
+{
+    return _thread_pool->submit([this, request = std::move(request)]() { return compile(request); });
+}
+
+std::string ShaderCompiler::temp_suffix()
+{
+    return std::to_string(process_id()) + "." + std::to_string(_next_temp_id++);
+}
+
+bool ShaderCompiler::make_key(const ShaderCompileRequest &request, std::string *outKey, std::string *outError) const
+{
+    const std::filesystem::path source_path = request.source_path;
+    if (!std::filesystem::exists(source_path))
+    {
+        *outError = "can't find " + request.source_path;
+        return false;
+    }
+
+    std::string &key = *outKey;
+    append_string(key, _compiler_version);
+
+    // the stage comes from the extension, so the same text compiled as another stage is another shader
+    append_string(key, source_path.extension().string());
+
+    const uint64_t define_count = request.defines.size();
+    key.append(reinterpret_cast<const char *>(&define_count), sizeof(define_count));
+    for (const std::string &define : request.defines)
+    {
+        append_string(key, define);
+    }
+
+    std::vector<std::filesystem::path> visited;
+    append_source(source_path, &visited, &key);
+    return true;
+}
+
+void ShaderCompiler::append_source(const std::filesystem::path &path, std::vector<std::filesystem::path> *visited,
+                                   std::string *outKey) const
+{
+    // include guards usually stop a file being compiled in twice, and there's no need to hash it twice either
+    std::error_code error;
+    const std::filesystem::path canonical_path = std::filesystem::weakly_canonical(path, error);
+    if (std::find(visited->begin(), visited->end(), canonical_path) != visited->end())
+    {
+        return;
+    }
+    visited->push_back(canonical_path);
+
+    std::string source;
+    if (!read_file(path, &source))
+    {
+        // the compiler will complain about it, and the key changes once the file turns up
+        append_string(*outKey, "missing " + path.string());
+        return;
+    }
+    append_string(*outKey, source);
+
+    std::istringstream lines(source);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        std::string name;
+        bool quoted;
+        if (!parse_include(line, &name, &quoted))
+        {
+            continue;
+        }
+
+        append_string(*outKey, name);
+        const std::filesystem::path include_path = resolve_include(path, name, quoted);
+        if (include_path.empty())
+        {
+            append_string(*outKey, "missing");
+            continue;
+        }
+        append_source(include_path, visited, outKey);
+    }
+}
+
+std::filesystem::path ShaderCompiler::resolve_include(const std::filesystem::path &includingFile,
+                                                      const std::string &name, bool quoted) const
+{
+    // the same search order glslang uses: next to the including file for "", then the include directories
+    if (quoted)
+    {
+        const std::filesystem::path candidate = includingFile.parent_path() / name;
+        if (std::filesystem::exists(candidate))
+        {
+            return candidate;
+        }
+    }
+
+    for (const std::string &directory : _include_directories)
+    {
+        const std::filesystem::path candidate = std::filesystem::path(directory) / name;
+        if (std::filesystem::exists(candidate))
+        {
+            return candidate;
+        }
+    }
+
+    return {};
+}
+
+bool ShaderCompiler::read_cached(const std::filesystem::path &path, const std::string &key,
+                                 std::vector<uint32_t> *outCode) const
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    FileHeader header = {}; // initialise struct to 0's
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != FILE_MAGIC ||
+        header.version != FILE_VERSION || header.key_size != key.size() || header.code_size % sizeof(uint32_t) != 0)
+    {
+        return false;
+    }
+
+    // the file name is only a hash, the key itself says whether this really is the shader we want
+    std::string stored_key(header.key_size, '\0');
+    if (!file.read(stored_key.data(), stored_key.size()) || stored_key != key)
+    {
+        return false;
+    }
+
+    outCode->resize(header.code_size / sizeof(uint32_t));
+    return static_cast<bool>(file.read(reinterpret_cast<char *>(outCode->data()), header.code_size));
+}
+
+void ShaderCompiler::write_cached(const std::filesystem::path &path, const std::string &key,
+                                  const std::vector<uint32_t> &code)
+{
+    FileHeader header = {}; // initialise struct to 0's
+    header.magic = FILE_MAGIC;
+    header.version = FILE_VERSION;
+    header.key_size = key.size();
+    header.code_size = code.size() * sizeof(uint32_t);
+
+    // written to a temporary file and then swapped in, so another thread or run never reads half a result
+    const std::filesystem::path temp_path = path.string() + "." + temp_suffix() + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(key.data(), key.size());
+        file.write(reinterpret_cast<const char *>(code.data()), header.code_size);
+        file.flush();
+        if (!file.good())
+        {
+            std::cout << "Failed to write compiled shader to " << temp_path.string() << std::endl;
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error)
+    {
+        std::cout << "Failed to replace " << path.string() << ": " << error.message() << std::endl;
+        std::filesystem::remove(temp_path, error);
+    }
+}
+
+bool ShaderCompiler::run_compiler(const ShaderCompileRequest &request, const std::string &outputPath,
+                                  std::string *outLog) const
+{
+    std::vector<std::string> arguments = {_compiler_path, "-V", "-o", outputPath};
+    for (const std::string &directory : _include_directories)
+    {
+        arguments.push_back("-I" + directory);
+    }
+    for (const std::string &define : request.defines)
+    {
+        arguments.push_back("-D" + define);
+    }
+    arguments.push_back(request.source_path);
+
+    return run_process(arguments, outLog) == 0;
+}
+} // namespace vulkan_engine
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace vulkan_engine
+{
+// a GLSL shader to compile, e.g. {"../shaders/triangle.vert", {"USE_FOG", "LIGHT_COUNT=4"}}
+struct ShaderCompileRequest
+{
+    std::string source_path; // the stage comes from the extension (.vert, .frag, .comp, ...), as for glslangValidator
+    std::vector<std::string> defines; // each "NAME" or "NAME=VALUE"
+};
+
+struct CompiledShader
+{
+    bool success{false};
+    bool from_cache{false};
+    std::vector<uint32_t> code;
+    std::string log; // what went wrong, when it failed
+};
+
+// Compiles GLSL into SPIR-V while the engine runs, so a permutation nobody built ahead of time can still be made. Each
+// compile runs glslangValidator (the same compiler the Shaders target uses) on a worker thread. Results are kept on
+// disk, named by a hash of everything that goes into them: the compiler version, the defines and the text of the
+// source and of every file it #includes. Asking for the same shader again, in this run or a later one, reads the
+// result back instead of compiling. The full key is stored with each result and compared on load, so a hash collision
+// is a cache miss rather than the wrong shader.
+//
+// compile() and compile_async() may be called from any thread. Two threads compiling the same shader at once both
+// compile it, and whichever finishes last replaces the other's (identical) result.
+class ShaderCompiler
+{
+  public:
+    // compilerPath is the glslangValidator to run, and cacheDirectory where results are kept (created if needed).
+    // Includes are looked for next to the including file and then in includeDirectories. False if the compiler can't
+    // be run
+    bool init(const std::string &compilerPath, const std::string &cacheDirectory,
+              std::vector<std::string> includeDirectories, ThreadPool *threadPool);
+
+    // compile on the calling thread, or read the result from the cache
+    CompiledShader compile(const ShaderCompileRequest &request);
+
+    // as compile(), but on the thread pool
+    std::future<CompiledShader> compile_async(ShaderCompileRequest request);
+
+    uint64_t compiles() const
+    {
+        return _compiles;
+    }
+
+    uint64_t cache_hits() const
+    {
+        return _cache_hits;
+    }
+
+  private:
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key_size;
+        uint64_t code_size; // in bytes
+    };
+
+    static constexpr uint32_t FILE_MAGIC = 0x56505343; // "CSPV"
+    static constexpr uint32_t FILE_VERSION = 1;
+
+    // everything the compiled code depends on, as one byte string. False if the source can't be read
+    bool make_key(const ShaderCompileRequest &request, std::string *outKey, std::string *outError) const;
+
+    // append a source file's text to outKey, followed by every file it includes (each only once)
+    void append_source(const std::filesystem::path &path, std::vector<std::filesystem::path> *visited,
+                       std::string *outKey) const;
+
+    // find the file an #include refers to, empty if there isn't one
+    std::filesystem::path resolve_include(const std::filesystem::path &includingFile, const std::string &name,
+                                          bool quoted) const;
+
+    bool read_cached(const std::filesystem::path &path, const std::string &key, std::vector<uint32_t> *outCode) const;
+    void write_cached(const std::filesystem::path &path, const std::string &key, const std::vector<uint32_t> &code);
+
+    // run the compiler, writing the SPIR-V to outputPath. outLog gets whatever it printed
+    bool run_compiler(const ShaderCompileRequest &request, const std::string &outputPath, std::string *outLog) const;
+
+    std::string _compiler_path;
+    std::string _compiler_version;
+    std::filesystem::path _cache_directory;
+    std::vector<std::string> _include_directories;
+    ThreadPool *_thread_pool{nullptr};
+
+    // a name part no other compile, in this process or another sharing the cache directory, is using right now
+    std::string temp_suffix();
+
+    // keeps the temporary files of concurrent compiles apart
+    std::atomic<uint64_t> _next_temp_id{0};
+
+    std::atomic<uint64_t> _compiles{0};
+    std::atomic<uint64_t> _cache_hits{0};
+};
+} // namespace vulkan_engine
@@ -0,0 +1,116 @@
+#include "ShaderModuleCache.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "Hash.h"
+#include "VulkanInitialisers.h"
+
+namespace vulkan_engine
+{
+void ShaderModuleCache::init(VkDevice device)
+{
+    _device = device;
+}
+
+void ShaderModuleCache::cleanup()
+{
+    for (const auto &module : _modules)
+    {
+        vkDestroyShaderModule(_device, module.first, nullptr);
+    }
+
+    _modules.clear();
+    _by_hash.clear();
+}
+
+bool ShaderModuleCache::acquire(const uint32_t *code, size_t codeSize, VkShaderModule *outShaderModule)
+{
+    const uint64_t hash = hash_bytes(code, codeSize);
+
+    const auto candidates = _by_hash.equal_range(hash);
+    for (auto it = candidates.first; it != candidates.second; ++it)
+    {
+        // a 64-bit hash can still collide, so the code itself decides
+        Entry &entry = _modules.at(it->second);
+        if (entry.code->size() * sizeof(uint32_t) == codeSize && std::memcmp(entry.code->data(), code, codeSize) == 0)
+        {
+            entry.references++;
+            _hits++;
+            *outShaderModule = it->second;
+            return true;
+        }
+    }
+
+    // create a new shader module, using the above code
+    VkShaderModuleCreateInfo create_info = vulkan_engine::initialisers::shader_module_create_info(code, codeSize);
+
+    // confirm creation goes well
+    VkShaderModule shader_module;
+    if (vkCreateShaderModule(_device, &create_info, nullptr, &shader_module) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    // a module we can't reflect still works, it just can't have its pipeline layout made for it
+    SpirvReflection reflection;
+    const bool reflected = reflect_spirv(code, codeSize, &reflection);
+    if (!reflected)
+    {
+        std::cout << "Failed to reflect a shader module, its pipelines need laying out by hand" << std::endl;
+    }
+
+    _misses++;
+    auto code_copy = std::make_shared<const std::vector<uint32_t>>(code, code + codeSize / sizeof(uint32_t));
+    _modules.emplace(shader_module, Entry{hash, std::move(code_copy), 1, reflected, std::move(reflection)});
+    _by_hash.emplace(hash, shader_module);
+
+    *outShaderModule = shader_module;
+    return true;
+}
+
+void ShaderModuleCache::acquire(VkShaderModule shaderModule)
+{
+    _modules.at(shaderModule).references++;
+}
+
+const SpirvReflection *ShaderModuleCache::reflection(VkShaderModule shaderModule) const
+{
+    auto it = _modules.find(shaderModule);
+    return it != _modules.end() && it->second.reflected ? &it->second.reflection : nullptr;
+}
+
+ShaderCodeKey ShaderModuleCache::code_key(VkShaderModule shaderModule) const
+{
+    const Entry &entry = _modules.at(shaderModule);
+    return ShaderCodeKey{entry.hash, entry.code};
+}
+
+void ShaderModuleCache::release(VkShaderModule shaderModule)
+{
+    auto it = _modules.find(shaderModule);
+    if (it == _modules.end())
+    {
+        std::cout << "Releasing a shader module that isn't in the cache" << std::endl;
+        return;
+    }
+
+    if (--it->second.references > 0)
+    {
+        return;
+    }
+
+    const auto candidates = _by_hash.equal_range(it->second.hash);
+    for (auto candidate = candidates.first; candidate != candidates.second; ++candidate)
+    {
+        if (candidate->second == shaderModule)
+        {
+            _by_hash.erase(candidate);
+            break;
+        }
+    }
+
+    vkDestroyShaderModule(_device, shaderModule, nullptr);
+    _modules.erase(it);
+}
+} // namespace vulkan_engine
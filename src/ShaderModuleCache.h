@@ -0,0 +1,80 @@
+#pragma once
+
+#include "PipelineBuilder.h"
+#include "SpirvReflection.h"
+#include "VulkanTypes.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace vulkan_engine
+{
+// Hands out one VkShaderModule per unique SPIR-V binary, so loading the same shader for several materials creates a
+// single module (and pipelines built from it share registry keys). Modules are found by the hash of their code and
+// then compared in full against a copy of it, which code_key() shares with pipeline keys. They are reference counted:
+// every acquire() is matched by a release(), and the module is destroyed as soon as nothing holds it. Every pipeline
+// build takes a reference to its modules until it has finished, pipelines don't need their modules once created.
+//
+// Each module is reflected when it is created, so pipelines can be laid out to match their shaders.
+//
+// Only used from the main thread, so it is not synchronised.
+class ShaderModuleCache
+{
+  public:
+    void init(VkDevice device);
+
+    // destroy every module that is still held
+    void cleanup();
+
+    // the module for codeSize bytes of SPIR-V at code, creating it if there isn't one yet. Adds a reference to it
+    bool acquire(const uint32_t *code, size_t codeSize, VkShaderModule *outShaderModule);
+
+    // add another reference to a module that is already held, e.g. for a build queued on a worker thread
+    void acquire(VkShaderModule shaderModule);
+
+    // drop a reference taken by acquire(), destroying the module if it was the last one
+    void release(VkShaderModule shaderModule);
+
+    // what a module's SPIR-V says it needs, or null if it couldn't be reflected. Valid while the module is held
+    const SpirvReflection *reflection(VkShaderModule shaderModule) const;
+
+    // what identifies a held module's code in pipeline keys. Unlike the handle, it still means the same code once the
+    // module has been destroyed
+    ShaderCodeKey code_key(VkShaderModule shaderModule) const;
+
+    size_t module_count() const
+    {
+        return _modules.size();
+    }
+
+    uint64_t hits() const
+    {
+        return _hits;
+    }
+
+    uint64_t misses() const
+    {
+        return _misses;
+    }
+
+  private:
+    struct Entry
+    {
+        uint64_t hash;
+        std::shared_ptr<const std::vector<uint32_t>> code;
+        uint32_t references;
+        bool reflected;
+        SpirvReflection reflection;
+    };
+
+    VkDevice _device{VK_NULL_HANDLE};
+
+    // map nodes never move, so reflections handed out stay put while their module lives
+    std::unordered_map<VkShaderModule, Entry> _modules;
+    std::unordered_multimap<uint64_t, VkShaderModule> _by_hash;
+
+    uint64_t _hits{0};
+    uint64_t _misses{0};
+};
+} // namespace vulkan_engine
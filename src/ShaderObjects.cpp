@@ -0,0 +1,192 @@
+#include "ShaderObjects.h"
+
+#include <VkBootstrap.h>
+
+#include <iostream>
+
+#include "DeviceExtensions.h"
+
+namespace vulkan_engine
+{
+std::vector<const char *> ShaderObjects::desired_extensions()
+{
+    // shader objects are built on top of dynamic rendering, even though we still draw inside a render pass
+    return {VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_EXT_SHADER_OBJECT_EXTENSION_NAME};
+}
+
+void ShaderObjects::enable_supported_features(VkPhysicalDevice physicalDevice, vkb::DeviceBuilder &deviceBuilder)
+{
+    // querying an unknown struct is invalid, so only ask when both extensions exist
+    const std::vector<VkExtensionProperties> extensions = supported_device_extensions(physicalDevice);
+    if (!has_device_extension(extensions, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) ||
+        !has_device_extension(extensions, VK_EXT_SHADER_OBJECT_EXTENSION_NAME))
+    {
+        return;
+    }
+
+    _features = {}; // initialise struct to 0's
+    _features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 supported_features = {}; // initialise struct to 0's
+    supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported_features.pNext = &_features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supported_features);
+
+    _supported = _features.shaderObject;
+    if (!_supported)
+    {
+        return;
+    }
+
+    // enable exactly what we are going to use, and nothing else
+    _features = {}; // initialise struct to 0's
+    _features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT;
+    _features.shaderObject = VK_TRUE;
+    deviceBuilder.add_pNext(&_features);
+}
+
+void ShaderObjects::load_functions(VkDevice device)
+{
+    if (!_supported)
+    {
+        return;
+    }
+
+    _create_shaders = (PFN_vkCreateShadersEXT)vkGetDeviceProcAddr(device, "vkCreateShadersEXT");
+    _destroy_shader = (PFN_vkDestroyShaderEXT)vkGetDeviceProcAddr(device, "vkDestroyShaderEXT");
+    _cmd_bind_shaders = (PFN_vkCmdBindShadersEXT)vkGetDeviceProcAddr(device, "vkCmdBindShadersEXT");
+
+    _cmd_set_viewport_with_count =
+        (PFN_vkCmdSetViewportWithCountEXT)vkGetDeviceProcAddr(device, "vkCmdSetViewportWithCountEXT");
+    _cmd_set_scissor_with_count =
+        (PFN_vkCmdSetScissorWithCountEXT)vkGetDeviceProcAddr(device, "vkCmdSetScissorWithCountEXT");
+    _cmd_set_vertex_input = (PFN_vkCmdSetVertexInputEXT)vkGetDeviceProcAddr(device, "vkCmdSetVertexInputEXT");
+    _cmd_set_primitive_topology =
+        (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveTopologyEXT");
+    _cmd_set_primitive_restart_enable =
+        (PFN_vkCmdSetPrimitiveRestartEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveRestartEnableEXT");
+    _cmd_set_rasterizer_discard_enable =
+        (PFN_vkCmdSetRasterizerDiscardEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetRasterizerDiscardEnableEXT");
+    _cmd_set_polygon_mode = (PFN_vkCmdSetPolygonModeEXT)vkGetDeviceProcAddr(device, "vkCmdSetPolygonModeEXT");
+    _cmd_set_cull_mode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT");
+    _cmd_set_front_face = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(device, "vkCmdSetFrontFaceEXT");
+    _cmd_set_depth_bias_enable =
+        (PFN_vkCmdSetDepthBiasEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthBiasEnableEXT");
+    _cmd_set_depth_test_enable =
+        (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT");
+    _cmd_set_depth_write_enable =
+        (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT");
+    _cmd_set_depth_compare_op =
+        (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT");
+    _cmd_set_depth_bounds_test_enable =
+        (PFN_vkCmdSetDepthBoundsTestEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthBoundsTestEnableEXT");
+    _cmd_set_stencil_test_enable =
+        (PFN_vkCmdSetStencilTestEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetStencilTestEnableEXT");
+    _cmd_set_rasterization_samples =
+        (PFN_vkCmdSetRasterizationSamplesEXT)vkGetDeviceProcAddr(device, "vkCmdSetRasterizationSamplesEXT");
+    _cmd_set_sample_mask = (PFN_vkCmdSetSampleMaskEXT)vkGetDeviceProcAddr(device, "vkCmdSetSampleMaskEXT");
+    _cmd_set_alpha_to_coverage_enable =
+        (PFN_vkCmdSetAlphaToCoverageEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetAlphaToCoverageEnableEXT");
+    _cmd_set_colour_blend_enable =
+        (PFN_vkCmdSetColorBlendEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEnableEXT");
+    _cmd_set_colour_write_mask =
+        (PFN_vkCmdSetColorWriteMaskEXT)vkGetDeviceProcAddr(device, "vkCmdSetColorWriteMaskEXT");
+}
+
+bool ShaderObjects::create_graphics_shaders(VkDevice device, const std::vector<uint32_t> &vertexCode,
+                                            const std::vector<uint32_t> &fragmentCode,
+                                            const VkSpecializationInfo *specialisation,
+                                            const std::vector<VkDescriptorSetLayout> &setLayouts,
+                                            GraphicsShaders *outShaders) const
+{
+    // linking the two stages lets the driver optimise across them, like it would within a pipeline
+    VkShaderCreateInfoEXT create_infos[2] = {}; // initialise structs to 0's
+    create_infos[0].sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
+    create_infos[0].flags = VK_SHADER_CREATE_LINK_STAGE_BIT_EXT;
+    create_infos[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    create_infos[0].nextStage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    create_infos[0].codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT;
+    create_infos[0].codeSize = vertexCode.size() * sizeof(uint32_t); // in bytes
+    create_infos[0].pCode = vertexCode.data();
+    create_infos[0].pName = "main";
+    create_infos[0].setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    create_infos[0].pSetLayouts = setLayouts.data();
+    create_infos[0].pSpecializationInfo = specialisation;
+
+    create_infos[1] = create_infos[0];
+    create_infos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    create_infos[1].nextStage = 0;
+    create_infos[1].codeSize = fragmentCode.size() * sizeof(uint32_t);
+    create_infos[1].pCode = fragmentCode.data();
+
+    VkShaderEXT shaders[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    if (_create_shaders(device, 2, create_infos, nullptr, shaders) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create vertex and fragment shader objects" << std::endl;
+
+        // any shader that did get created is still ours to destroy
+        destroy_graphics_shaders(device, GraphicsShaders{shaders[0], shaders[1]});
+        return false;
+    }
+
+    outShaders->vertex = shaders[0];
+    outShaders->fragment = shaders[1];
+    return true;
+}
+
+void ShaderObjects::destroy_graphics_shaders(VkDevice device, const GraphicsShaders &shaders) const
+{
+    for (VkShaderEXT shader : {shaders.vertex, shaders.fragment})
+    {
+        if (shader != VK_NULL_HANDLE)
+        {
+            _destroy_shader(device, shader, nullptr);
+        }
+    }
+}
+
+void ShaderObjects::set_state(VkCommandBuffer commandBuffer, const RasterState &state, const VkViewport &viewport,
+                              const VkRect2D &scissor) const
+{
+    _cmd_set_viewport_with_count(commandBuffer, 1, &viewport);
+    _cmd_set_scissor_with_count(commandBuffer, 1, &scissor);
+
+    // vertices come from gl_VertexIndex, there are no vertex buffers
+    _cmd_set_vertex_input(commandBuffer, 0, nullptr, 0, nullptr);
+    _cmd_set_primitive_topology(commandBuffer, state.topology);
+    _cmd_set_primitive_restart_enable(commandBuffer, VK_FALSE);
+
+    _cmd_set_rasterizer_discard_enable(commandBuffer, VK_FALSE);
+    _cmd_set_polygon_mode(commandBuffer, state.polygon_mode);
+    vkCmdSetLineWidth(commandBuffer, 1.0f);
+    _cmd_set_cull_mode(commandBuffer, state.cull_mode);
+    _cmd_set_front_face(commandBuffer, state.front_face);
+    _cmd_set_depth_bias_enable(commandBuffer, VK_FALSE);
+
+    _cmd_set_depth_test_enable(commandBuffer, state.depth_test ? VK_TRUE : VK_FALSE);
+    _cmd_set_depth_write_enable(commandBuffer, state.depth_write ? VK_TRUE : VK_FALSE);
+    _cmd_set_depth_compare_op(commandBuffer, state.depth_test ? state.depth_compare_op : VK_COMPARE_OP_ALWAYS);
+    _cmd_set_depth_bounds_test_enable(commandBuffer, VK_FALSE);
+    _cmd_set_stencil_test_enable(commandBuffer, VK_FALSE);
+
+    // default multisampling (1 sample per pixel)
+    const VkSampleMask sample_mask = ~0u;
+    _cmd_set_rasterization_samples(commandBuffer, VK_SAMPLE_COUNT_1_BIT);
+    _cmd_set_sample_mask(commandBuffer, VK_SAMPLE_COUNT_1_BIT, &sample_mask);
+    _cmd_set_alpha_to_coverage_enable(commandBuffer, VK_FALSE);
+
+    // single colour attachment with no blending and writing to RGBA
+    const VkBool32 blend_enable = VK_FALSE;
+    const VkColorComponentFlags write_mask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    _cmd_set_colour_blend_enable(commandBuffer, 0, 1, &blend_enable);
+    _cmd_set_colour_write_mask(commandBuffer, 0, 1, &write_mask);
+}
+
+void ShaderObjects::bind(VkCommandBuffer commandBuffer, VkShaderEXT vertexShader, VkShaderEXT fragmentShader) const
+{
+    const VkShaderStageFlagBits stages[2] = {VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT};
+    const VkShaderEXT shaders[2] = {vertexShader, fragmentShader};
+    _cmd_bind_shaders(commandBuffer, 2, stages, shaders);
+}
+} // namespace vulkan_engine
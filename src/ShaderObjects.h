@@ -0,0 +1,92 @@
+#pragma once
+
+#include "ExtendedDynamicState.h"
+#include "VulkanTypes.h"
+
+#include <vector>
+
+namespace vkb
+{
+class DeviceBuilder;
+}
+
+namespace vulkan_engine
+{
+// a vertex and fragment shader object that are always bound together
+struct GraphicsShaders
+{
+    VkShaderEXT vertex{VK_NULL_HANDLE};
+    VkShaderEXT fragment{VK_NULL_HANDLE};
+};
+
+// Wraps VK_EXT_shader_object, which compiles each shader stage on its own and binds it directly, with no VkPipeline
+// in between. Every piece of state a pipeline would have baked in is set on the command buffer instead, so any raster
+// state can be drawn with the shaders we already have. Lavapipe supports it, so it can be tried without a GPU that
+// does (point VK_ICD_FILENAMES at lvp_icd.*.json).
+class ShaderObjects
+{
+  public:
+    // the device extensions to ask vk-bootstrap for, they are only enabled when available
+    static std::vector<const char *> desired_extensions();
+
+    // check whether the physical device supports shader objects and if so enable them. This object must outlive
+    // deviceBuilder.build()
+    void enable_supported_features(VkPhysicalDevice physicalDevice, vkb::DeviceBuilder &deviceBuilder);
+
+    // load the extension entry points once the device exists
+    void load_functions(VkDevice device);
+
+    bool is_supported() const
+    {
+        return _supported;
+    }
+
+    // create linked vertex and fragment shaders from SPIR-V, both specialised with specialisation (which may be null).
+    // setLayouts are the descriptor set layouts of the pipeline layout their descriptor sets will be bound with
+    bool create_graphics_shaders(VkDevice device, const std::vector<uint32_t> &vertexCode,
+                                 const std::vector<uint32_t> &fragmentCode, const VkSpecializationInfo *specialisation,
+                                 const std::vector<VkDescriptorSetLayout> &setLayouts,
+                                 GraphicsShaders *outShaders) const;
+
+    void destroy_graphics_shaders(VkDevice device, const GraphicsShaders &shaders) const;
+
+    // record everything a draw needs besides the shaders, drawing into a single colour attachment. Must be called in
+    // every command buffer that draws, including secondaries
+    void set_state(VkCommandBuffer commandBuffer, const RasterState &state, const VkViewport &viewport,
+                   const VkRect2D &scissor) const;
+
+    void bind(VkCommandBuffer commandBuffer, VkShaderEXT vertexShader, VkShaderEXT fragmentShader) const;
+
+  private:
+    bool _supported{false};
+
+    // chained into device creation, so it lives as long as this object
+    VkPhysicalDeviceShaderObjectFeaturesEXT _features{};
+
+    PFN_vkCreateShadersEXT _create_shaders{nullptr};
+    PFN_vkDestroyShaderEXT _destroy_shader{nullptr};
+    PFN_vkCmdBindShadersEXT _cmd_bind_shaders{nullptr};
+
+    // shader objects bring their own copies of these, whether or not the extensions they come from are enabled
+    PFN_vkCmdSetViewportWithCountEXT _cmd_set_viewport_with_count{nullptr};
+    PFN_vkCmdSetScissorWithCountEXT _cmd_set_scissor_with_count{nullptr};
+    PFN_vkCmdSetVertexInputEXT _cmd_set_vertex_input{nullptr};
+    PFN_vkCmdSetPrimitiveTopologyEXT _cmd_set_primitive_topology{nullptr};
+    PFN_vkCmdSetPrimitiveRestartEnableEXT _cmd_set_primitive_restart_enable{nullptr};
+    PFN_vkCmdSetRasterizerDiscardEnableEXT _cmd_set_rasterizer_discard_enable{nullptr};
+    PFN_vkCmdSetPolygonModeEXT _cmd_set_polygon_mode{nullptr};
+    PFN_vkCmdSetCullModeEXT _cmd_set_cull_mode{nullptr};
+    PFN_vkCmdSetFrontFaceEXT _cmd_set_front_face{nullptr};
+    PFN_vkCmdSetDepthBiasEnableEXT _cmd_set_depth_bias_enable{nullptr};
+    PFN_vkCmdSetDepthTestEnableEXT _cmd_set_depth_test_enable{nullptr};
+    PFN_vkCmdSetDepthWriteEnableEXT _cmd_set_depth_write_enable{nullptr};
+    PFN_vkCmdSetDepthCompareOpEXT _cmd_set_depth_compare_op{nullptr};
+    PFN_vkCmdSetDepthBoundsTestEnableEXT _cmd_set_depth_bounds_test_enable{nullptr};
+    PFN_vkCmdSetStencilTestEnableEXT _cmd_set_stencil_test_enable{nullptr};
+    PFN_vkCmdSetRasterizationSamplesEXT _cmd_set_rasterization_samples{nullptr};
+    PFN_vkCmdSetSampleMaskEXT _cmd_set_sample_mask{nullptr};
+    PFN_vkCmdSetAlphaToCoverageEnableEXT _cmd_set_alpha_to_coverage_enable{nullptr};
+    PFN_vkCmdSetColorBlendEnableEXT _cmd_set_colour_blend_enable{nullptr};
+    PFN_vkCmdSetColorWriteMaskEXT _cmd_set_colour_write_mask{nullptr};
+};
+} // namespace vulkan_engine
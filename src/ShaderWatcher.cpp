@@ -0,0 +1,154 @@
+#include "ShaderWatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#include <unordered_map>
+#endif
+
+namespace vulkan_engine
+{
+namespace
+{
+// how long the thread may take to notice that cleanup() wants it to stop (or, when polling, to notice a change)
+constexpr auto WAKE_INTERVAL = std::chrono::milliseconds(100);
+
+#ifndef __linux__
+// the modification time of every .spv file in directory
+std::unordered_map<std::string, std::filesystem::file_time_type> shader_write_times(const std::string &directory)
+{
+    std::unordered_map<std::string, std::filesystem::file_time_type> write_times;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (entry.path().extension() == ".spv")
+        {
+            write_times[entry.path().filename().string()] = entry.last_write_time(error);
+        }
+    }
+
+    return write_times;
+}
+#endif
+} // namespace
+
+bool ShaderWatcher::init(const std::string &directory)
+{
+    _directory = directory;
+
+#ifdef __linux__
+    _inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotify_fd < 0)
+    {
+        return false;
+    }
+
+    // compilers write the file in place (close after write), editors and build tools often replace it (moved to)
+    if (inotify_add_watch(_inotify_fd, _directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(_inotify_fd);
+        _inotify_fd = -1;
+        return false;
+    }
+#endif
+
+    _running = true;
+    _thread = std::thread(&ShaderWatcher::thread_main, this);
+    return true;
+}
+
+void ShaderWatcher::cleanup()
+{
+    if (!_thread.joinable())
+    {
+        return;
+    }
+
+    _running = false;
+    _thread.join();
+
+#ifdef __linux__
+    close(_inotify_fd);
+    _inotify_fd = -1;
+#endif
+}
+
+std::vector<std::string> ShaderWatcher::take_changes()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return std::exchange(_changes, {});
+}
+
+void ShaderWatcher::record_change(const std::string &fileName)
+{
+    const std::string extension = ".spv";
+    if (fileName.size() < extension.size() ||
+        fileName.compare(fileName.size() - extension.size(), extension.size(), extension) != 0)
+    {
+        return;
+    }
+
+    // a file is often written more than once in a burst, it only needs reloading once
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (std::find(_changes.begin(), _changes.end(), fileName) == _changes.end())
+    {
+        _changes.push_back(fileName);
+    }
+}
+
+#ifdef __linux__
+void ShaderWatcher::thread_main()
+{
+    alignas(inotify_event) char buffer[4096];
+    while (_running)
+    {
+        // wake up every so often to see whether we should stop
+        pollfd poll_fd = {_inotify_fd, POLLIN, 0};
+        if (poll(&poll_fd, 1, static_cast<int>(WAKE_INTERVAL.count())) <= 0)
+        {
+            continue;
+        }
+
+        const ssize_t length = read(_inotify_fd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+            if (event->len > 0)
+            {
+                record_change(event->name);
+            }
+
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+#else
+void ShaderWatcher::thread_main()
+{
+    auto write_times = shader_write_times(_directory);
+    while (_running)
+    {
+        std::this_thread::sleep_for(WAKE_INTERVAL);
+
+        auto new_write_times = shader_write_times(_directory);
+        for (const auto &file : new_write_times)
+        {
+            const auto previous = write_times.find(file.first);
+            if (previous == write_times.end() || previous->second != file.second)
+            {
+                record_change(file.first);
+            }
+        }
+
+        write_times = std::move(new_write_times);
+    }
+}
+#endif
+} // namespace vulkan_engine
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vulkan_engine
+{
+// Watches a directory for compiled shaders (.spv files) being written, on a thread of its own, so the engine can pick
+// up a rebuilt shader without restarting. Uses inotify on Linux and polls modification times everywhere else
+class ShaderWatcher
+{
+  public:
+    // start watching directory, false if it can't be watched
+    bool init(const std::string &directory);
+
+    // stop watching and join the thread
+    void cleanup();
+
+    // the file names (without the directory) of every .spv file written since the last call, each listed once
+    std::vector<std::string> take_changes();
+
+  private:
+    void thread_main();
+
+    // note a written file, ignoring anything that isn't a shader
+    void record_change(const std::string &fileName);
+
+    std::string _directory;
+    int _inotify_fd{-1};
+
+    std::thread _thread;
+    std::atomic<bool> _running{false};
+
+    std::mutex _mutex;
+    std::vector<std::string> _changes;
+};
+} // namespace vulkan_engine
@@ -0,0 +1,45 @@
+#include "Spirv.h"
+
+#include <cstring>
+
+namespace vulkan_engine
+{
+namespace
+{
+// SPIRV_MAGIC as read by a machine of the other endianness
+constexpr uint32_t SPIRV_MAGIC_SWAPPED = 0x03022307;
+} // namespace
+
+bool is_valid_spirv(const void *code, size_t size, std::string *outReason)
+{
+    // vkCreateShaderModule reads the code as uint32_t words
+    if (reinterpret_cast<uintptr_t>(code) % alignof(uint32_t) != 0)
+    {
+        *outReason = "code is not 4-byte aligned";
+        return false;
+    }
+
+    if (size % sizeof(uint32_t) != 0)
+    {
+        *outReason = "size is not a multiple of 4 bytes";
+        return false;
+    }
+
+    if (size < SPIRV_HEADER_WORDS * sizeof(uint32_t))
+    {
+        *outReason = "too small to hold a SPIR-V header";
+        return false;
+    }
+
+    uint32_t magic;
+    std::memcpy(&magic, code, sizeof(magic));
+    if (magic != SPIRV_MAGIC)
+    {
+        // a byte swapped magic number is valid SPIR-V, just not something Vulkan will take
+        *outReason = magic == SPIRV_MAGIC_SWAPPED ? "SPIR-V is in the wrong byte order" : "not SPIR-V";
+        return false;
+    }
+
+    return true;
+}
+} // namespace vulkan_engine
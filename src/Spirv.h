@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace vulkan_engine
+{
+// the first word of every SPIR-V module, in the byte order it was written in
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+// the magic number, version, generator, id bound and schema
+constexpr size_t SPIRV_HEADER_WORDS = 5;
+
+// check that size bytes at code look like a SPIR-V module Vulkan will accept: 4-byte aligned, a whole number of words
+// and starting with a header in our byte order. Otherwise says why not
+bool is_valid_spirv(const void *code, size_t size, std::string *outReason);
+} // namespace vulkan_engine
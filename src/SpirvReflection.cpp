@@ -0,0 +1,531 @@
+#include "SpirvReflection.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "Spirv.h"
+#include "VulkanInitialisers.h"
+
+namespace vulkan_engine
+{
+namespace
+{
+// the few parts of the SPIR-V specification reflection needs
+constexpr uint32_t OP_ENTRY_POINT = 15;
+constexpr uint32_t OP_TYPE_INT = 21;
+constexpr uint32_t OP_TYPE_FLOAT = 22;
+constexpr uint32_t OP_TYPE_VECTOR = 23;
+constexpr uint32_t OP_TYPE_MATRIX = 24;
+constexpr uint32_t OP_TYPE_IMAGE = 25;
+constexpr uint32_t OP_TYPE_SAMPLER = 26;
+constexpr uint32_t OP_TYPE_SAMPLED_IMAGE = 27;
+constexpr uint32_t OP_TYPE_ARRAY = 28;
+constexpr uint32_t OP_TYPE_RUNTIME_ARRAY = 29;
+constexpr uint32_t OP_TYPE_STRUCT = 30;
+constexpr uint32_t OP_TYPE_POINTER = 32;
+constexpr uint32_t OP_CONSTANT = 43;
+constexpr uint32_t OP_VARIABLE = 59;
+constexpr uint32_t OP_DECORATE = 71;
+constexpr uint32_t OP_MEMBER_DECORATE = 72;
+
+constexpr uint32_t DECORATION_BLOCK = 2;
+constexpr uint32_t DECORATION_BUFFER_BLOCK = 3;
+constexpr uint32_t DECORATION_ARRAY_STRIDE = 6;
+constexpr uint32_t DECORATION_MATRIX_STRIDE = 7;
+constexpr uint32_t DECORATION_BUILT_IN = 11;
+constexpr uint32_t DECORATION_LOCATION = 30;
+constexpr uint32_t DECORATION_BINDING = 33;
+constexpr uint32_t DECORATION_DESCRIPTOR_SET = 34;
+constexpr uint32_t DECORATION_OFFSET = 35;
+
+constexpr uint32_t STORAGE_CLASS_UNIFORM_CONSTANT = 0;
+constexpr uint32_t STORAGE_CLASS_INPUT = 1;
+constexpr uint32_t STORAGE_CLASS_UNIFORM = 2;
+constexpr uint32_t STORAGE_CLASS_PUSH_CONSTANT = 9;
+constexpr uint32_t STORAGE_CLASS_STORAGE_BUFFER = 12;
+
+// from SPIR-V 1.4 an entry point's interface lists every global variable it uses, before that only inputs and outputs
+constexpr uint32_t VERSION_1_4 = 0x00010400;
+
+constexpr uint32_t DIM_BUFFER = 5;
+constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+// everything we know about one result id: the instruction that defines it and how it is decorated
+struct IdInfo
+{
+    uint32_t opcode{0};
+    const uint32_t *words{nullptr}; // the defining instruction, words[0] holds the opcode
+
+    bool has_binding{false};
+    uint32_t set{0};
+    uint32_t binding{0};
+    bool has_location{false};
+    uint32_t location{0};
+    bool is_built_in{false};
+    bool is_block{false};
+    bool is_buffer_block{false};
+    uint32_t array_stride{0};
+
+    // per struct member
+    std::vector<uint32_t> member_offsets;
+    std::vector<uint32_t> member_matrix_strides;
+};
+
+// the shader stage for an OpEntryPoint execution model
+VkShaderStageFlagBits execution_model_stage(uint32_t executionModel)
+{
+    switch (executionModel)
+    {
+    case 0:
+        return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1:
+        return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2:
+        return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3:
+        return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4:
+        return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5:
+        return VK_SHADER_STAGE_COMPUTE_BIT;
+    default:
+        return VK_SHADER_STAGE_ALL;
+    }
+}
+
+class Reflector
+{
+  public:
+    explicit Reflector(std::vector<IdInfo> ids) : _ids(std::move(ids))
+    {
+    }
+
+    const IdInfo &id(uint32_t id) const
+    {
+        static const IdInfo unknown;
+        return id < _ids.size() ? _ids[id] : unknown;
+    }
+
+    // the value of an integer constant, e.g. an array length
+    uint32_t constant_value(uint32_t constantId) const
+    {
+        const IdInfo &constant = id(constantId);
+        return constant.opcode == OP_CONSTANT ? constant.words[3] : 1;
+    }
+
+    // how many bytes a type takes up in a block, using the offsets and strides the compiler laid it out with
+    uint32_t type_size(uint32_t typeId, uint32_t matrixStride = 0) const
+    {
+        const IdInfo &type = id(typeId);
+        switch (type.opcode)
+        {
+        case OP_TYPE_INT:
+        case OP_TYPE_FLOAT:
+            return type.words[2] / 8;
+        case OP_TYPE_VECTOR:
+            return type.words[3] * type_size(type.words[2]);
+        case OP_TYPE_MATRIX:
+            return type.words[3] * (matrixStride != 0 ? matrixStride : type_size(type.words[2]));
+        case OP_TYPE_ARRAY:
+            return constant_value(type.words[3]) *
+                   (type.array_stride != 0 ? type.array_stride : type_size(type.words[2], matrixStride));
+        case OP_TYPE_STRUCT: {
+            uint32_t size = 0;
+            const uint32_t word_count = type.words[0] >> 16;
+            for (uint32_t member = 0; member + 2 < word_count; ++member)
+            {
+                const uint32_t offset = member < type.member_offsets.size() ? type.member_offsets[member] : size;
+                const uint32_t stride =
+                    member < type.member_matrix_strides.size() ? type.member_matrix_strides[member] : 0;
+                size = std::max(size, offset + type_size(type.words[2 + member], stride));
+            }
+            return size;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    // the descriptor type a resource variable of this (pointed to) type needs, false for anything that isn't one
+    bool descriptor_type(uint32_t typeId, uint32_t storageClass, VkDescriptorType *outType) const
+    {
+        const IdInfo &type = id(typeId);
+        switch (type.opcode)
+        {
+        case OP_TYPE_SAMPLER:
+            *outType = VK_DESCRIPTOR_TYPE_SAMPLER;
+            return true;
+        case OP_TYPE_SAMPLED_IMAGE:
+            *outType = id(type.words[2]).words != nullptr && id(type.words[2]).words[3] == DIM_BUFFER
+                           ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+                           : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            return true;
+        case OP_TYPE_IMAGE: {
+            // sampled is 1 for images used with a sampler and 2 for storage images
+            const uint32_t dim = type.words[3];
+            const bool sampled = type.words[7] == 1;
+            if (dim == DIM_SUBPASS_DATA)
+            {
+                *outType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            }
+            else if (dim == DIM_BUFFER)
+            {
+                *outType = sampled ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+            }
+            else
+            {
+                *outType = sampled ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            }
+            return true;
+        }
+        case OP_TYPE_STRUCT:
+            // older compilers mark storage buffers as BufferBlock in the Uniform storage class
+            if (storageClass == STORAGE_CLASS_STORAGE_BUFFER || type.is_buffer_block)
+            {
+                *outType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                return true;
+            }
+            if (type.is_block)
+            {
+                *outType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                return true;
+            }
+            return false;
+        default:
+            return false;
+        }
+    }
+
+    // the vertex attribute format for an input of this type, and how many locations it takes up
+    bool vertex_format(uint32_t typeId, VkFormat *outFormat, uint32_t *outLocations) const
+    {
+        const IdInfo &type = id(typeId);
+        if (type.opcode == OP_TYPE_MATRIX)
+        {
+            // each column of a matrix takes a location of its own
+            if (!vertex_format(type.words[2], outFormat, outLocations))
+            {
+                return false;
+            }
+            *outLocations = type.words[3];
+            return true;
+        }
+
+        *outLocations = 1;
+
+        uint32_t components = 1;
+        const IdInfo *component = &type;
+        if (type.opcode == OP_TYPE_VECTOR)
+        {
+            components = type.words[3];
+            component = &id(type.words[2]);
+        }
+
+        // only 32-bit components, which is what vertex attributes nearly always are
+        if (component->words == nullptr || component->words[2] != 32)
+        {
+            return false;
+        }
+
+        static const VkFormat FLOAT_FORMATS[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+                                                 VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+        static const VkFormat SINT_FORMATS[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT,
+                                                VK_FORMAT_R32G32B32A32_SINT};
+        static const VkFormat UINT_FORMATS[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT,
+                                                VK_FORMAT_R32G32B32A32_UINT};
+        if (components < 1 || components > 4)
+        {
+            return false;
+        }
+
+        if (component->opcode == OP_TYPE_FLOAT)
+        {
+            *outFormat = FLOAT_FORMATS[components - 1];
+        }
+        else if (component->opcode == OP_TYPE_INT)
+        {
+            *outFormat = component->words[3] != 0 ? SINT_FORMATS[components - 1] : UINT_FORMATS[components - 1];
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+  private:
+    std::vector<IdInfo> _ids;
+};
+
+// bytes taken up by one attribute of a 32-bit component format
+uint32_t format_size(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R32G32_SFLOAT:
+    case VK_FORMAT_R32G32_SINT:
+    case VK_FORMAT_R32G32_UINT:
+        return 8;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+    case VK_FORMAT_R32G32B32_SINT:
+    case VK_FORMAT_R32G32B32_UINT:
+        return 12;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+    case VK_FORMAT_R32G32B32A32_SINT:
+    case VK_FORMAT_R32G32B32A32_UINT:
+        return 16;
+    default:
+        return 4;
+    }
+}
+} // namespace
+
+VkPipelineVertexInputStateCreateInfo SpirvReflection::vertex_input_info() const
+{
+    VkPipelineVertexInputStateCreateInfo vertex_input_state_info =
+        vulkan_engine::initialisers::vertex_input_state_create_info();
+    vertex_input_state_info.vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_bindings.size());
+    vertex_input_state_info.pVertexBindingDescriptions = vertex_bindings.data();
+    vertex_input_state_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_attributes.size());
+    vertex_input_state_info.pVertexAttributeDescriptions = vertex_attributes.data();
+    return vertex_input_state_info;
+}
+
+bool reflect_spirv(const uint32_t *code, size_t codeSize, SpirvReflection *outReflection)
+{
+    *outReflection = {};
+    if (codeSize < SPIRV_HEADER_WORDS * sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    // the header's id bound is one more than the largest id in the module. Every id takes at least a word to define,
+    // so a bound beyond the module's size is a corrupt (or half written) header, not something to allocate for
+    const size_t word_count = codeSize / sizeof(uint32_t);
+    if (code[3] > word_count)
+    {
+        std::cout << "Can't reflect SPIR-V, its id bound of " << code[3] << " is larger than the module" << std::endl;
+        return false;
+    }
+    std::vector<IdInfo> ids(code[3]);
+    const auto info = [&ids](uint32_t id) -> IdInfo * { return id < ids.size() ? &ids[id] : nullptr; };
+
+    const uint32_t *entry_point = nullptr;
+    std::vector<const uint32_t *> variables;
+
+    // one pass over the instructions, noting the types, constants and variables we need and their decorations
+    for (size_t offset = SPIRV_HEADER_WORDS; offset < word_count;)
+    {
+        const uint32_t *words = code + offset;
+        const uint32_t opcode = words[0] & 0xffff;
+        const uint32_t length = words[0] >> 16;
+        if (length == 0 || offset + length > word_count)
+        {
+            std::cout << "Can't reflect SPIR-V, it is truncated" << std::endl;
+            return false;
+        }
+        offset += length;
+
+        IdInfo *target = nullptr;
+        switch (opcode)
+        {
+        case OP_ENTRY_POINT:
+            if (entry_point == nullptr)
+            {
+                entry_point = words;
+            }
+            break;
+        case OP_TYPE_INT:
+        case OP_TYPE_FLOAT:
+        case OP_TYPE_VECTOR:
+        case OP_TYPE_MATRIX:
+        case OP_TYPE_IMAGE:
+        case OP_TYPE_SAMPLER:
+        case OP_TYPE_SAMPLED_IMAGE:
+        case OP_TYPE_ARRAY:
+        case OP_TYPE_RUNTIME_ARRAY:
+        case OP_TYPE_STRUCT:
+        case OP_TYPE_POINTER:
+            target = info(words[1]);
+            break;
+        case OP_CONSTANT:
+            target = info(words[2]);
+            break;
+        case OP_VARIABLE:
+            target = info(words[2]);
+            variables.push_back(words);
+            break;
+        case OP_DECORATE:
+            if (IdInfo *decorated = info(words[1]); decorated != nullptr && length >= 3)
+            {
+                const uint32_t value = length >= 4 ? words[3] : 0;
+                switch (words[2])
+                {
+                case DECORATION_BLOCK:
+                    decorated->is_block = true;
+                    break;
+                case DECORATION_BUFFER_BLOCK:
+                    decorated->is_buffer_block = true;
+                    break;
+                case DECORATION_ARRAY_STRIDE:
+                    decorated->array_stride = value;
+                    break;
+                case DECORATION_BUILT_IN:
+                    decorated->is_built_in = true;
+                    break;
+                case DECORATION_LOCATION:
+                    decorated->has_location = true;
+                    decorated->location = value;
+                    break;
+                case DECORATION_BINDING:
+                    decorated->has_binding = true;
+                    decorated->binding = value;
+                    break;
+                case DECORATION_DESCRIPTOR_SET:
+                    decorated->set = value;
+                    break;
+                default:
+                    break;
+                }
+            }
+            break;
+        case OP_MEMBER_DECORATE:
+            if (IdInfo *decorated = info(words[1]); decorated != nullptr && length >= 5)
+            {
+                const uint32_t member = words[2];
+                if (words[3] == DECORATION_OFFSET)
+                {
+                    decorated->member_offsets.resize(std::max<size_t>(decorated->member_offsets.size(), member + 1));
+                    decorated->member_offsets[member] = words[4];
+                }
+                else if (words[3] == DECORATION_MATRIX_STRIDE)
+                {
+                    decorated->member_matrix_strides.resize(
+                        std::max<size_t>(decorated->member_matrix_strides.size(), member + 1));
+                    decorated->member_matrix_strides[member] = words[4];
+                }
+            }
+            break;
+        default:
+            break;
+        }
+
+        if (target != nullptr)
+        {
+            target->opcode = opcode;
+            target->words = words;
+        }
+    }
+
+    if (entry_point == nullptr)
+    {
+        std::cout << "Can't reflect SPIR-V, it has no entry point" << std::endl;
+        return false;
+    }
+    outReflection->stage = execution_model_stage(entry_point[1]);
+
+    // the interface ids follow the entry point's name, a nul terminated string padded out to whole words
+    const uint32_t entry_point_length = entry_point[0] >> 16;
+    uint32_t interface_start = 3;
+    while (interface_start < entry_point_length)
+    {
+        const uint32_t word = entry_point[interface_start++];
+        if ((word & 0xff) == 0 || (word & 0xff00) == 0 || (word & 0xff0000) == 0 || (word & 0xff000000) == 0)
+        {
+            break;
+        }
+    }
+    std::vector<uint32_t> interface_ids(entry_point + interface_start, entry_point + entry_point_length);
+    std::sort(interface_ids.begin(), interface_ids.end());
+    const bool interface_lists_resources = code[1] >= VERSION_1_4;
+
+    const Reflector reflector(std::move(ids));
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+    for (const uint32_t *variable_words : variables)
+    {
+        const IdInfo &variable = reflector.id(variable_words[2]);
+        const uint32_t storage_class = variable_words[3];
+
+        // skip variables the entry point doesn't use, e.g. inputs of another entry point in the same module
+        const bool listed = std::binary_search(interface_ids.begin(), interface_ids.end(), variable_words[2]);
+        if (!listed && (storage_class == STORAGE_CLASS_INPUT || interface_lists_resources))
+        {
+            continue;
+        }
+
+        // variables are always declared through a pointer type, what we want is the type it points at
+        const IdInfo &pointer = reflector.id(variable_words[1]);
+        if (pointer.opcode != OP_TYPE_POINTER)
+        {
+            continue;
+        }
+        uint32_t type_id = pointer.words[3];
+
+        if (storage_class == STORAGE_CLASS_PUSH_CONSTANT)
+        {
+            const uint32_t size = reflector.type_size(type_id);
+            outReflection->push_constant_size = std::max(outReflection->push_constant_size, size);
+        }
+        else if (storage_class == STORAGE_CLASS_UNIFORM_CONSTANT || storage_class == STORAGE_CLASS_UNIFORM ||
+                 storage_class == STORAGE_CLASS_STORAGE_BUFFER)
+        {
+            if (!variable.has_binding)
+            {
+                continue;
+            }
+
+            // an array of resources is one binding with several descriptors. Runtime sized arrays need descriptor
+            // indexing, which we don't enable, so they are treated as a single descriptor
+            uint32_t count = 1;
+            const IdInfo &type = reflector.id(type_id);
+            if (type.opcode == OP_TYPE_ARRAY || type.opcode == OP_TYPE_RUNTIME_ARRAY)
+            {
+                count = type.opcode == OP_TYPE_ARRAY ? reflector.constant_value(type.words[3]) : 1;
+                type_id = type.words[2];
+            }
+
+            VkDescriptorType descriptor_type;
+            if (reflector.descriptor_type(type_id, storage_class, &descriptor_type))
+            {
+                outReflection->descriptor_bindings.push_back({variable.set, variable.binding, descriptor_type, count});
+            }
+        }
+        else if (storage_class == STORAGE_CLASS_INPUT && outReflection->stage == VK_SHADER_STAGE_VERTEX_BIT &&
+                 !variable.is_built_in && variable.has_location)
+        {
+            VkFormat format;
+            uint32_t locations;
+            if (!reflector.vertex_format(type_id, &format, &locations))
+            {
+                std::cout << "Vertex input at location " << variable.location
+                          << " has a type we can't make an attribute for" << std::endl;
+                continue;
+            }
+
+            for (uint32_t i = 0; i < locations; ++i)
+            {
+                vertex_attributes.push_back({variable.location + i, 0, format, 0});
+            }
+        }
+    }
+
+    // pack the attributes one after the other, in location order, into a single interleaved binding
+    std::sort(vertex_attributes.begin(), vertex_attributes.end(),
+              [](const auto &a, const auto &b) { return a.location < b.location; });
+    uint32_t stride = 0;
+    for (VkVertexInputAttributeDescription &attribute : vertex_attributes)
+    {
+        attribute.offset = stride;
+        stride += format_size(attribute.format);
+    }
+
+    if (!vertex_attributes.empty())
+    {
+        outReflection->vertex_bindings.push_back({0, stride, VK_VERTEX_INPUT_RATE_VERTEX});
+        outReflection->vertex_attributes = std::move(vertex_attributes);
+    }
+
+    return true;
+}
+} // namespace vulkan_engine
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "VulkanTypes.h"
+
+#include <vector>
+
+namespace vulkan_engine
+{
+// a resource the shader reads through a descriptor set
+struct SpirvDescriptorBinding
+{
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    uint32_t count; // array size, 1 for a single descriptor
+};
+
+// What a shader stage expects from the pipeline it is used in, read from its SPIR-V: the descriptors and push
+// constants it uses and, for a vertex shader, its vertex attributes
+struct SpirvReflection
+{
+    VkShaderStageFlagBits stage{VK_SHADER_STAGE_ALL};
+    std::vector<SpirvDescriptorBinding> descriptor_bindings;
+    uint32_t push_constant_size{0}; // in bytes, 0 when the shader has no push constants
+
+    // the vertex shader's inputs, all interleaved in binding 0 in location order. Empty for other stages and for
+    // vertex shaders that make up their own vertices
+    std::vector<VkVertexInputBindingDescription> vertex_bindings;
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+
+    // vertex input state matching the above. It points into this object, so it is only valid as long as this is
+    VkPipelineVertexInputStateCreateInfo vertex_input_info() const;
+};
+
+// reflect codeSize bytes of SPIR-V, which must have passed is_valid_spirv(). Only the first entry point is looked at
+bool reflect_spirv(const uint32_t *code, size_t codeSize, SpirvReflection *outReflection);
+} // namespace vulkan_engine
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+namespace vulkan_engine
+{
+// append the raw bytes of a value to a key that identifies some Vulkan state. Used for scalars, handles and the small
+// Vulkan structs made only of 32-bit fields (viewports, scissors, vertex descriptions, blend attachments). Never for
+// create info structs, whose padding and pNext pointers would make equal state key differently, so those are
+// appended field by field
+template <typename T> void append_to_key(std::string &key, const T &value)
+{
+    key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+} // namespace vulkan_engine
@@ -0,0 +1,60 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace vulkan_engine
+{
+void ThreadPool::init(uint32_t threadCount /*= 0*/)
+{
+    if (threadCount == 0)
+    {
+        // hardware_concurrency is allowed to return 0 when it can't tell
+        threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    _stopping = false;
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        _threads.emplace_back(&ThreadPool::worker_main, this);
+    }
+}
+
+void ThreadPool::cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _job_available.notify_all();
+
+    for (std::thread &thread : _threads)
+    {
+        thread.join();
+    }
+
+    _threads.clear();
+}
+
+void ThreadPool::worker_main()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _job_available.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+
+            // drain the queue before stopping, so nobody is left waiting on a future that never completes
+            if (_jobs.empty())
+            {
+                return;
+            }
+
+            job = std::move(_jobs.front());
+            _jobs.pop_front();
+        }
+
+        job();
+    }
+}
+} // namespace vulkan_engine
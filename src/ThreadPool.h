@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vulkan_engine
+{
+// A fixed set of worker threads pulling jobs off a shared queue. Jobs are handed back as futures, so the caller decides
+// when (and whether) to block on the result
+class ThreadPool
+{
+  public:
+    // 0 picks one thread per hardware thread, minus one for the main thread
+    void init(uint32_t threadCount = 0);
+
+    // finishes any queued jobs and joins the workers
+    void cleanup();
+
+    uint32_t thread_count() const
+    {
+        return static_cast<uint32_t>(_threads.size());
+    }
+
+    // queue a job for the workers, the returned future holds its result (or exception)
+    template <typename Function> auto submit(Function &&function) -> std::future<decltype(function())>
+    {
+        using Result = decltype(function());
+
+        // std::function needs a copyable callable, so the packaged task is shared rather than moved in
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _jobs.emplace_back([task]() { (*task)(); });
+        }
+        _job_available.notify_one();
+
+        return result;
+    }
+
+  private:
+    void worker_main();
+
+    std::vector<std::thread> _threads;
+
+    std::mutex _mutex;
+    std::condition_variable _job_available;
+    std::deque<std::function<void()>> _jobs;
+    bool _stopping{false};
+};
+} // namespace vulkan_engine
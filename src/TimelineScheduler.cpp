@@ -0,0 +1,102 @@
+#include "TimelineScheduler.h"
+
+#include <vector>
+
+namespace vulkan_engine
+{
+void TimelineScheduler::init(VkDevice device)
+{
+    _device = device;
+
+    // a timeline semaphore is a regular semaphore with a type struct chained on, starting at 0 so that "nothing has
+    // been submitted yet" is already complete
+    VkSemaphoreTypeCreateInfo type_info = {}; // initialise struct to 0's
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.pNext = nullptr;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_info = {}; // initialise struct to 0's
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+    semaphore_info.flags = 0;
+
+    VK_CHECK(vkCreateSemaphore(_device, &semaphore_info, nullptr, &_semaphore));
+
+    _last_submitted_value = 0;
+    _last_completed_value = 0;
+}
+
+void TimelineScheduler::cleanup()
+{
+    vkDestroySemaphore(_device, _semaphore, nullptr);
+    _semaphore = VK_NULL_HANDLE;
+}
+
+VkResult TimelineScheduler::submit(VkQueue queue, const VkSubmitInfo &submitInfo, uint64_t *outSignalValue)
+{
+    const uint64_t signal_value = _last_submitted_value + 1;
+
+    // append our timeline semaphore to whatever binary semaphores the caller wants signalled. Values for binary
+    // semaphores are ignored, but the arrays have to line up
+    std::vector<VkSemaphore> signal_semaphores(submitInfo.pSignalSemaphores,
+                                               submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+    signal_semaphores.push_back(_semaphore);
+
+    std::vector<uint64_t> signal_values(signal_semaphores.size(), 0);
+    signal_values.back() = signal_value;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {}; // initialise struct to 0's
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.pNext = submitInfo.pNext;
+    timeline_info.waitSemaphoreValueCount = 0; // we only ever wait on binary semaphores here
+    timeline_info.pWaitSemaphoreValues = nullptr;
+    timeline_info.signalSemaphoreValueCount = static_cast<uint32_t>(signal_values.size());
+    timeline_info.pSignalSemaphoreValues = signal_values.data();
+
+    VkSubmitInfo submit = submitInfo;
+    submit.pNext = &timeline_info;
+    submit.signalSemaphoreCount = static_cast<uint32_t>(signal_semaphores.size());
+    submit.pSignalSemaphores = signal_semaphores.data();
+
+    // no fence needed, the timeline value tells us when this submission is done
+    VkResult result = vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE);
+    if (result == VK_SUCCESS)
+    {
+        _last_submitted_value = signal_value;
+        *outSignalValue = signal_value;
+    }
+
+    return result;
+}
+
+VkResult TimelineScheduler::wait(uint64_t value, uint64_t timeout) const
+{
+    VkSemaphoreWaitInfo wait_info = {}; // initialise struct to 0's
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.pNext = nullptr;
+    wait_info.flags = 0;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &_semaphore;
+    wait_info.pValues = &value;
+
+    return vkWaitSemaphores(_device, &wait_info, timeout);
+}
+
+bool TimelineScheduler::is_complete(uint64_t value)
+{
+    // avoid a driver call when we already know the answer
+    if (value <= _last_completed_value)
+    {
+        return true;
+    }
+
+    return completed_value() >= value;
+}
+
+uint64_t TimelineScheduler::completed_value()
+{
+    VK_CHECK(vkGetSemaphoreCounterValue(_device, _semaphore, &_last_completed_value));
+    return _last_completed_value;
+}
+} // namespace vulkan_engine
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "VulkanTypes.h"
+
+namespace vulkan_engine
+{
+// Wraps a single Vulkan 1.2 timeline semaphore that acts as a monotonically increasing GPU counter for one queue.
+// Every submission to the queue signals the next value, so instead of allocating a fence per submission the CPU can
+// simply wait for (or poll) the value that a piece of work was tagged with.
+class TimelineScheduler
+{
+  public:
+    void init(VkDevice device);
+
+    void cleanup();
+
+    // submit to the queue, additionally signalling the next timeline value once the GPU has finished the work.
+    // The value that will be signalled is written to outSignalValue
+    VkResult submit(VkQueue queue, const VkSubmitInfo &submitInfo, uint64_t *outSignalValue);
+
+    // block the CPU until the GPU counter reaches the given value
+    VkResult wait(uint64_t value, uint64_t timeout) const;
+
+    // true once the GPU counter has reached the given value. Does not block
+    bool is_complete(uint64_t value);
+
+    // the last value the GPU has signalled (may lag behind the real counter until queried again)
+    uint64_t completed_value();
+
+    // the value signalled by the most recent submission
+    uint64_t last_submitted_value() const
+    {
+        return _last_submitted_value;
+    }
+
+    VkSemaphore semaphore() const
+    {
+        return _semaphore;
+    }
+
+  private:
+    VkDevice _device{VK_NULL_HANDLE};
+    VkSemaphore _semaphore{VK_NULL_HANDLE};
+
+    uint64_t _last_submitted_value{0};
+    uint64_t _last_completed_value{0};
+};
+} // namespace vulkan_engine
@@ -0,0 +1,459 @@
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "Alignment.h"
+#include "VulkanInitialisers.h"
+
+namespace vulkan_engine
+{
+
+bool UploadManager::init(VkDevice device, GpuAllocator *gpuAllocator, const VkPhysicalDeviceLimits &limits,
+                         VkQueue transferQueue, uint32_t transferQueueFamily, VkQueue graphicsQueue,
+                         uint32_t graphicsQueueFamily, std::mutex *graphicsQueueMutex, VkDeviceSize stagingSize)
+{
+    _device = device;
+    _gpu_allocator = gpuAllocator;
+    _transfer_queue = transferQueue;
+    _transfer_queue_family = transferQueueFamily;
+    _graphics_queue = graphicsQueue;
+    _graphics_queue_family = graphicsQueueFamily;
+    _graphics_queue_mutex = graphicsQueueMutex;
+
+    // image copies need their source offset to be a multiple of the texel size, 16 covers every format up to RGBA32
+    _alignment = std::max<VkDeviceSize>(16, limits.optimalBufferCopyOffsetAlignment);
+
+    VkBufferCreateInfo buffer_info = {}; // initialise struct to 0's
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = align_up(stagingSize, _alignment);
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (!_gpu_allocator->create_buffer(buffer_info, MemoryPool::staging, &_staging) || _staging.mapped == nullptr)
+    {
+        std::cout << "Failed to create the " << buffer_info.size << " byte staging buffer" << std::endl;
+        _staging = {};
+        return false;
+    }
+
+    // command buffers are reused one at a time as their batches retire
+    VkCommandPoolCreateInfo command_pool_info = vulkan_engine::initialisers::command_pool_create_info(
+        transferQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(vkCreateCommandPool(_device, &command_pool_info, nullptr, &_command_pool));
+
+    if (separate_transfer_family())
+    {
+        VkCommandPoolCreateInfo acquire_pool_info = vulkan_engine::initialisers::command_pool_create_info(
+            graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+        VK_CHECK(vkCreateCommandPool(_device, &acquire_pool_info, nullptr, &_acquire_command_pool));
+    }
+
+    _stopping = false;
+    _thread = std::thread(&UploadManager::thread_main, this);
+    return true;
+}
+
+void UploadManager::cleanup()
+{
+    if (_thread.joinable())
+    {
+        // the thread only stops once everything in flight has retired
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _wake.notify_all();
+        _thread.join();
+    }
+
+    for (const std::unique_ptr<Batch> &batch : _batches)
+    {
+        vkDestroyFence(_device, batch->fence, nullptr);
+        vkDestroySemaphore(_device, batch->transfer_semaphore, nullptr);
+    }
+    _batches.clear();
+    _free_batches.clear();
+    _retired.clear();
+
+    // this frees the batches' command buffers as well
+    if (_command_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyCommandPool(_device, _command_pool, nullptr);
+        _command_pool = VK_NULL_HANDLE;
+    }
+    if (_acquire_command_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyCommandPool(_device, _acquire_command_pool, nullptr);
+        _acquire_command_pool = VK_NULL_HANDLE;
+    }
+
+    if (_staging.buffer != VK_NULL_HANDLE)
+    {
+        _gpu_allocator->destroy_buffer(_staging);
+        _staging = {};
+    }
+
+    _buffer_copies.clear();
+    _image_copies.clear();
+    _promises.clear();
+}
+
+std::future<void> UploadManager::upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void *data,
+                                               VkDeviceSize size)
+{
+    std::promise<void> promise;
+    std::future<void> future = promise.get_future();
+    if (size == 0)
+    {
+        // nothing to copy, and nothing to wait for
+        promise.set_value();
+        return future;
+    }
+
+    // anything bigger than the ring goes in pieces, which may end up in several batches. Batches retire in order, so
+    // the last piece's future covers the lot
+    const char *source = static_cast<const char *>(data);
+    for (VkDeviceSize copied = 0; copied < size;)
+    {
+        const VkDeviceSize chunk_size = std::min(size - copied, _staging.size);
+        const VkDeviceSize staging_offset = reserve(chunk_size);
+        std::memcpy(static_cast<char *>(_staging.mapped) + staging_offset, source + copied, chunk_size);
+        _gpu_allocator->flush(_staging, staging_offset, chunk_size);
+
+        _buffer_copies.push_back({buffer, {staging_offset, offset + copied, chunk_size}});
+        copied += chunk_size;
+    }
+    _bytes_uploaded += size;
+
+    // only queued once every piece is, a piece that fills the ring submits the batch so far without it
+    _promises.push_back(std::move(promise));
+    return future;
+}
+
+std::future<void> UploadManager::upload_image(VkImage image, VkExtent3D extent, VkImageAspectFlags aspect,
+                                              const void *data, VkDeviceSize size, VkImageLayout finalLayout)
+{
+    if (size > _staging.size)
+    {
+        std::cout << "Can't upload a " << size << " byte image through a " << _staging.size << " byte staging buffer"
+                  << std::endl;
+        return {};
+    }
+
+    const VkDeviceSize staging_offset = reserve(size);
+    std::memcpy(static_cast<char *>(_staging.mapped) + staging_offset, data, size);
+    _gpu_allocator->flush(_staging, staging_offset, size);
+
+    ImageCopy copy = {}; // initialise struct to 0's
+    copy.image = image;
+    copy.region.bufferOffset = staging_offset;
+    copy.region.imageSubresource.aspectMask = aspect;
+    copy.region.imageSubresource.mipLevel = 0;
+    copy.region.imageSubresource.baseArrayLayer = 0;
+    copy.region.imageSubresource.layerCount = 1;
+    copy.region.imageExtent = extent;
+    copy.final_layout = finalLayout;
+    _image_copies.push_back(copy);
+    _bytes_uploaded += size;
+
+    _promises.emplace_back();
+    return _promises.back().get_future();
+}
+
+void UploadManager::submit()
+{
+    if (_buffer_copies.empty() && _image_copies.empty())
+    {
+        return;
+    }
+
+    Batch *batch = acquire_batch();
+    record(*batch);
+    batch->staging_end = _head;
+    batch->promises.swap(_promises);
+    _buffer_copies.clear();
+    _image_copies.clear();
+
+    VkSubmitInfo submit = {}; // initialise struct to 0's
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &batch->command_buffer;
+    if (!separate_transfer_family())
+    {
+        std::lock_guard<std::mutex> lock(*_graphics_queue_mutex);
+        VK_CHECK(vkQueueSubmit(_graphics_queue, 1, &submit, batch->fence));
+    }
+    else
+    {
+        // the transfer queue is ours alone. The fence goes on the acquire, which can't finish before the copies do
+        submit.signalSemaphoreCount = 1;
+        submit.pSignalSemaphores = &batch->transfer_semaphore;
+        VK_CHECK(vkQueueSubmit(_transfer_queue, 1, &submit, VK_NULL_HANDLE));
+
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo acquire_submit = {}; // initialise struct to 0's
+        acquire_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquire_submit.waitSemaphoreCount = 1;
+        acquire_submit.pWaitSemaphores = &batch->transfer_semaphore;
+        acquire_submit.pWaitDstStageMask = &wait_stage;
+        acquire_submit.commandBufferCount = 1;
+        acquire_submit.pCommandBuffers = &batch->acquire_command_buffer;
+
+        std::lock_guard<std::mutex> lock(*_graphics_queue_mutex);
+        VK_CHECK(vkQueueSubmit(_graphics_queue, 1, &acquire_submit, batch->fence));
+    }
+    _batches_submitted++;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _in_flight.push_back(batch);
+    }
+    _wake.notify_all();
+}
+
+void UploadManager::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _wake.wait(lock, [this]() { return _in_flight.empty(); });
+}
+
+VkDeviceSize UploadManager::reserve(VkDeviceSize size)
+{
+    const VkDeviceSize capacity = _staging.size;
+    size = std::min(align_up(size, _alignment), capacity);
+
+    // an allocation never wraps around the end of the buffer, it starts again at the beginning instead
+    uint64_t start = _head;
+    if (start % capacity + size > capacity)
+    {
+        start += capacity - start % capacity;
+    }
+    const uint64_t end = start + size;
+
+    if (end - _tail > capacity)
+    {
+        // hand what we have queued to the GPU and wait for enough of it to finish. At worst that is all of it, and
+        // then the whole ring is free, including whatever we skipped over to start at the beginning
+        submit();
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake.wait(lock, [this, end, capacity]() { return end - _tail <= capacity || _in_flight.empty(); });
+        if (end - _tail > capacity)
+        {
+            _tail = start;
+        }
+    }
+
+    _head = end;
+    return start % capacity;
+}
+
+UploadManager::Batch *UploadManager::acquire_batch()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free_batches.insert(_free_batches.end(), _retired.begin(), _retired.end());
+        _retired.clear();
+    }
+
+    if (!_free_batches.empty())
+    {
+        Batch *batch = _free_batches.back();
+        _free_batches.pop_back();
+        batch->promises.clear();
+        VK_CHECK(vkResetFences(_device, 1, &batch->fence));
+        return batch;
+    }
+
+    auto batch = std::make_unique<Batch>();
+    VkCommandBufferAllocateInfo command_alloc_info =
+        vulkan_engine::initialisers::command_buffer_allocate_info(_command_pool, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    VK_CHECK(vkAllocateCommandBuffers(_device, &command_alloc_info, &batch->command_buffer));
+
+    VkFenceCreateInfo fence_info = {}; // initialise struct to 0's
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK(vkCreateFence(_device, &fence_info, nullptr, &batch->fence));
+
+    // the semaphore is waited on by the time the fence signals, so it is free to signal again whenever the batch is
+    if (separate_transfer_family())
+    {
+        VkCommandBufferAllocateInfo acquire_alloc_info = vulkan_engine::initialisers::command_buffer_allocate_info(
+            _acquire_command_pool, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        VK_CHECK(vkAllocateCommandBuffers(_device, &acquire_alloc_info, &batch->acquire_command_buffer));
+
+        VkSemaphoreCreateInfo semaphore_info = {}; // initialise struct to 0's
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VK_CHECK(vkCreateSemaphore(_device, &semaphore_info, nullptr, &batch->transfer_semaphore));
+    }
+
+    _batches.push_back(std::move(batch));
+    return _batches.back().get();
+}
+
+void UploadManager::record(Batch &batch)
+{
+    VkCommandBufferBeginInfo begin_info = {}; // initialise struct to 0's
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(batch.command_buffer, &begin_info));
+
+    // anything earlier on the queue may still be reading the destinations, e.g. a frame drawing the last upload's
+    // vertices or sampling its image, so the copies wait for all of it. Only reads are waited for, so no memory needs
+    // to be made available, except on a transfer queue: there an earlier batch's copies into the same memory ended in
+    // a release, which doesn't make their writes available, so they are made so here before being overwritten. Images
+    // are overwritten whole, so whatever layout they were in can be discarded on the way to being copied into
+    VkMemoryBarrier memory_barrier = {}; // initialise struct to 0's
+    memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    const uint32_t memory_barrier_count = separate_transfer_family() ? 1 : 0;
+
+    _image_barriers.clear();
+    for (const ImageCopy &copy : _image_copies)
+    {
+        VkImageMemoryBarrier barrier = {}; // initialise struct to 0's
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = copy.image;
+        barrier.subresourceRange = {copy.region.imageSubresource.aspectMask, 0, 1, 0, 1};
+        _image_barriers.push_back(barrier);
+    }
+    vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         memory_barrier_count, &memory_barrier, 0, nullptr,
+                         static_cast<uint32_t>(_image_barriers.size()), _image_barriers.data());
+
+    // every region going into the same buffer goes in one command. The sort is stable so copies into a buffer keep
+    // the order they were uploaded in
+    std::stable_sort(_buffer_copies.begin(), _buffer_copies.end(),
+                     [](const BufferCopy &a, const BufferCopy &b) { return a.buffer < b.buffer; });
+    for (size_t first = 0; first < _buffer_copies.size();)
+    {
+        _regions.clear();
+        size_t last = first;
+        for (; last < _buffer_copies.size() && _buffer_copies[last].buffer == _buffer_copies[first].buffer; ++last)
+        {
+            _regions.push_back(_buffer_copies[last].region);
+        }
+
+        vkCmdCopyBuffer(batch.command_buffer, _staging.buffer, _buffer_copies[first].buffer,
+                        static_cast<uint32_t>(_regions.size()), _regions.data());
+        first = last;
+    }
+
+    for (const ImageCopy &copy : _image_copies)
+    {
+        vkCmdCopyBufferToImage(batch.command_buffer, _staging.buffer, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               1, &copy.region);
+    }
+
+    // the images move to the layouts they were asked for on the way out
+    const uint32_t image_barrier_count = static_cast<uint32_t>(_image_copies.size());
+    for (uint32_t i = 0; i < image_barrier_count; ++i)
+    {
+        VkImageMemoryBarrier &barrier = _image_barriers[i];
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = _image_copies[i].final_layout;
+    }
+
+    if (!separate_transfer_family())
+    {
+        // make the copies visible to whatever reads them next on this queue, and order them before the next batch's
+        // copies, which may write the same memory again
+        memory_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0, 1, &memory_barrier, 0, nullptr, image_barrier_count, _image_barriers.data());
+
+        VK_CHECK(vkEndCommandBuffer(batch.command_buffer));
+        return;
+    }
+
+    // release what was written to the graphics family. Only the regions written change hands, the rest of each buffer
+    // stays with whichever family had it. A release's destination access is ignored
+    _buffer_barriers.clear();
+    for (const BufferCopy &copy : _buffer_copies)
+    {
+        VkBufferMemoryBarrier barrier = {}; // initialise struct to 0's
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = _transfer_queue_family;
+        barrier.dstQueueFamilyIndex = _graphics_queue_family;
+        barrier.buffer = copy.buffer;
+        barrier.offset = copy.region.dstOffset;
+        barrier.size = copy.region.size;
+        _buffer_barriers.push_back(barrier);
+    }
+    for (uint32_t i = 0; i < image_barrier_count; ++i)
+    {
+        _image_barriers[i].dstAccessMask = 0;
+        _image_barriers[i].srcQueueFamilyIndex = _transfer_queue_family;
+        _image_barriers[i].dstQueueFamilyIndex = _graphics_queue_family;
+    }
+    vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, static_cast<uint32_t>(_buffer_barriers.size()), _buffer_barriers.data(),
+                         image_barrier_count, _image_barriers.data());
+
+    VK_CHECK(vkEndCommandBuffer(batch.command_buffer));
+
+    // the acquire repeats the release, layouts included, with the access masks of the graphics side. The semaphore
+    // wait covers all commands, which chains it after the copies, and the submission order of the graphics queue then
+    // puts every later frame after it
+    for (VkBufferMemoryBarrier &barrier : _buffer_barriers)
+    {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    }
+    for (uint32_t i = 0; i < image_barrier_count; ++i)
+    {
+        _image_barriers[i].srcAccessMask = 0;
+        _image_barriers[i].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    }
+
+    VK_CHECK(vkBeginCommandBuffer(batch.acquire_command_buffer, &begin_info));
+    vkCmdPipelineBarrier(batch.acquire_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                         static_cast<uint32_t>(_buffer_barriers.size()), _buffer_barriers.data(), image_barrier_count,
+                         _image_barriers.data());
+    VK_CHECK(vkEndCommandBuffer(batch.acquire_command_buffer));
+}
+
+void UploadManager::thread_main()
+{
+    while (true)
+    {
+        Batch *batch;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this]() { return !_in_flight.empty() || _stopping; });
+            if (_in_flight.empty())
+            {
+                return;
+            }
+            batch = _in_flight.front();
+        }
+
+        // batches are waited for in the order they were submitted, so when one retires so have all before it
+        VK_CHECK(vkWaitForFences(_device, 1, &batch->fence, VK_TRUE, UINT64_MAX));
+        for (std::promise<void> &promise : batch->promises)
+        {
+            promise.set_value();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _in_flight.pop_front();
+            _tail = batch->staging_end;
+            _retired.push_back(batch);
+        }
+        _wake.notify_all();
+    }
+}
+} // namespace vulkan_engine
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "GpuAllocator.h"
+#include "VulkanTypes.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vulkan_engine
+{
+// Copies mesh and texture data into device local buffers and images. Each upload is copied into a large staging ring
+// straight away, and the GPU copies are queued up and then recorded together into one command buffer on submit(),
+// which the engine calls once per frame: copies into the same buffer share one vkCmdCopyBuffer, and all the image
+// layout transitions share a barrier. Every upload hands back a future that becomes ready once its copy has finished
+// on the GPU.
+//
+// The copies run on a transfer queue when the device has one in a family of its own, so they don't hold up rendering.
+// The destinations are exclusive to one queue family, so each batch ends by releasing what it wrote to the graphics
+// family, and a short command buffer on the graphics queue acquires it again after waiting on a semaphore the copies
+// signal. Without a separate family both run on the graphics queue and no ownership changes hands.
+//
+// A thread of our own waits on each submission's fence in turn, then frees its part of the ring and fulfils its
+// futures, so nothing ever waits for the queue to go idle. An upload that doesn't fit in the free part of the ring
+// submits whatever is queued and waits for space, and buffer uploads larger than the whole ring are split up.
+//
+// Uploads and submit() are main thread only. The futures may be waited on from any thread, once the upload has been
+// submitted, and once they are ready the data can be used on the graphics queue. Uploads into overlapping parts of a
+// buffer must not be in the same batch. On the graphics queue the copies wait for everything submitted before them,
+// so a destination earlier frames are still reading can be uploaded into. On a transfer queue nothing orders the
+// copies after the graphics queue's frames, so a destination the GPU may still be reading must not be uploaded into.
+class UploadManager
+{
+  public:
+    // copies run on transferQueue, which may be the graphics queue, and nobody else may submit to it unless it is.
+    // Anyone else submitting to the graphics queue must guard it with graphicsQueueMutex. stagingSize is the size of
+    // the ring
+    bool init(VkDevice device, GpuAllocator *gpuAllocator, const VkPhysicalDeviceLimits &limits, VkQueue transferQueue,
+              uint32_t transferQueueFamily, VkQueue graphicsQueue, uint32_t graphicsQueueFamily,
+              std::mutex *graphicsQueueMutex, VkDeviceSize stagingSize);
+
+    // waits for every submitted upload to finish. Anything uploaded since the last submit() is dropped
+    void cleanup();
+
+    // copy size bytes from data into buffer at offset. The data is copied before this returns
+    std::future<void> upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+
+    // copy tightly packed texels into mip 0 of a 2D image, which is then left in finalLayout. Whatever the image held
+    // before is discarded. The data is copied before this returns. Images that don't fit in the ring can't be
+    // uploaded, for those the future isn't valid()
+    std::future<void> upload_image(VkImage image, VkExtent3D extent, VkImageAspectFlags aspect, const void *data,
+                                   VkDeviceSize size, VkImageLayout finalLayout);
+
+    // record and submit everything uploaded since the last submit as one batch, if there is anything
+    void submit();
+
+    // block until everything submitted so far has finished on the GPU
+    void wait_idle();
+
+    uint64_t bytes_uploaded() const
+    {
+        return _bytes_uploaded;
+    }
+
+    uint64_t batches_submitted() const
+    {
+        return _batches_submitted;
+    }
+
+  private:
+    struct BufferCopy
+    {
+        VkBuffer buffer;
+        VkBufferCopy region;
+    };
+
+    struct ImageCopy
+    {
+        VkImage image;
+        VkBufferImageCopy region;
+        VkImageLayout final_layout;
+    };
+
+    // one submission, and everything it needs until the GPU has finished it
+    struct Batch
+    {
+        VkCommandBuffer command_buffer{VK_NULL_HANDLE};
+        VkFence fence{VK_NULL_HANDLE};
+
+        // only used with a separate transfer family: the graphics side of the ownership transfer, and the semaphore
+        // the copies signal for it to wait on
+        VkCommandBuffer acquire_command_buffer{VK_NULL_HANDLE};
+        VkSemaphore transfer_semaphore{VK_NULL_HANDLE};
+
+        uint64_t staging_end{0}; // the ring position everything up to which is free once this completes
+        std::vector<std::promise<void>> promises;
+    };
+
+    // reserve size bytes of the ring, submitting and waiting for earlier batches when it is full. Returns the offset
+    // into the staging buffer
+    VkDeviceSize reserve(VkDeviceSize size);
+
+    // a batch whose command buffer and fence are ready to reuse
+    Batch *acquire_batch();
+
+    // record the queued copies into the batch's command buffer, and the acquire into its acquire command buffer
+    void record(Batch &batch);
+
+    // true when the copies run on a different queue family to the graphics queue
+    bool separate_transfer_family() const
+    {
+        return _transfer_queue_family != _graphics_queue_family;
+    }
+
+    // waits for each submitted batch in turn and retires it
+    void thread_main();
+
+    VkDevice _device{VK_NULL_HANDLE};
+    GpuAllocator *_gpu_allocator{nullptr};
+    VkQueue _transfer_queue{VK_NULL_HANDLE};
+    uint32_t _transfer_queue_family{0};
+    VkQueue _graphics_queue{VK_NULL_HANDLE};
+    uint32_t _graphics_queue_family{0};
+    std::mutex *_graphics_queue_mutex{nullptr};
+    VkCommandPool _command_pool{VK_NULL_HANDLE};
+    VkCommandPool _acquire_command_pool{VK_NULL_HANDLE}; // on the graphics family, when that is a different one
+
+    // the ring. Positions only ever grow, the offset into the buffer is the position modulo its size
+    AllocatedBuffer _staging;
+    VkDeviceSize _alignment{16};
+    uint64_t _head{0};              // where the next upload goes, main thread only
+    std::atomic<uint64_t> _tail{0}; // everything before this is free again
+
+    // uploaded since the last submit, main thread only. Kept between batches so their capacity is reused
+    std::vector<BufferCopy> _buffer_copies;
+    std::vector<ImageCopy> _image_copies;
+    std::vector<std::promise<void>> _promises;
+    std::vector<VkBufferCopy> _regions;
+    std::vector<VkBufferMemoryBarrier> _buffer_barriers;
+    std::vector<VkImageMemoryBarrier> _image_barriers;
+
+    std::vector<std::unique_ptr<Batch>> _batches;
+    std::vector<Batch *> _free_batches; // main thread only
+
+    // submitted and not yet retired, oldest first, and retired but not yet reused. Shared with the thread
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::deque<Batch *> _in_flight;
+    std::vector<Batch *> _retired;
+    bool _stopping{false};
+    std::thread _thread;
+
+    uint64_t _bytes_uploaded{0};
+    uint64_t _batches_submitted{0};
+};
+} // namespace vulkan_engine
@@ -4,34 +4,85 @@
 #include <SDL2/SDL_vulkan.h>
 #include <VkBootstrap.h>
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <thread>
 
+#include "Alignment.h"
+#include "EmbeddedShaders.h"
 #include "PipelineBuilder.h"
+#include "Spirv.h"
 #include "VulkanInitialisers.h"
 
 namespace vulkan_engine
 {
-// We want to immediately abort when there is an error. In normal engines this
-// would give an error message to the user, or perform a dump of state.
-#define VK_CHECK(x)                                                                                                    \
-    do                                                                                                                 \
-    {                                                                                                                  \
-        VkResult err = x;                                                                                              \
-        if (err)                                                                                                       \
-        {                                                                                                              \
-            std::cout << "Detected Vulkan Error: " << err << std::endl;                                                \
-            abort();                                                                                                   \
-        }                                                                                                              \
-    } while (0)
-
-void VulkanEngine::init()
+namespace
 {
+// specialisation constants for the two variants of the triangle shaders
+const SpecialisationValues RAINBOW_TRIANGLE_CONSTANTS = {VK_TRUE}; // USE_VERTEX_COLOURS
+const SpecialisationValues RED_TRIANGLE_CONSTANTS = {VK_FALSE};
+
+// compiled shaders live in the source tree's shaders directory, next to the build directory
+const char *SHADER_DIRECTORY = "../shaders";
+constexpr const char *TRIANGLE_VERTEX_SHADER = "triangle.vert.spv";
+constexpr const char *TRIANGLE_FRAGMENT_SHADER = "triangle.frag.spv";
+
+// nothing can be drawn without these, so a bundle missing them is a build error rather than a blank window
+static_assert(find_embedded_shader(TRIANGLE_VERTEX_SHADER) != nullptr &&
+                  find_embedded_shader(TRIANGLE_FRAGMENT_SHADER) != nullptr,
+              "the triangle shaders must be in the embedded shader bundle");
+
+#ifdef GLSL_VALIDATOR_PATH
+constexpr const char *GLSL_COMPILER = GLSL_VALIDATOR_PATH;
+#else
+constexpr const char *GLSL_COMPILER = "glslangValidator"; // hopefully on the PATH
+#endif
+
+std::string shader_path(const char *fileName)
+{
+    return std::string(SHADER_DIRECTORY) + "/" + fileName;
+}
+
+const char *present_mode_name(VkPresentModeKHR presentMode)
+{
+    switch (presentMode)
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "FIFO_RELAXED";
+    default:
+        return "UNKNOWN";
+    }
+}
+} // namespace
+
+void VulkanEngine::init(const EngineConfig &config)
+{
+    _config = config;
+
+    // we always want at least double buffering so that the CPU and GPU can overlap
+    _frames_in_flight = std::clamp(config.frames_in_flight, 2u, MAX_FRAMES_IN_FLIGHT);
+
+    _recording_threads = config.recording_threads;
+    if (_recording_threads > 0)
+    {
+        _recording_pool.init(_recording_threads);
+    }
+
     // We initialize SDL and create a window with it.
     SDL_Init(SDL_INIT_VIDEO);
 
-    auto window_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN);
+    auto window_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
 
     _window = SDL_CreateWindow("rendering window", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
                                _window_extent.width, _window_extent.height, window_flags);
@@ -53,28 +104,178 @@ void VulkanEngine::init()
     // sync comms between GPU and GPU
     init_sync_structures();
 
+    init_timestamp_queries();
+
+    init_present_thread();
+
+    init_frame_data();
+
+    init_uploads();
+
     init_pipelines();
 
+    build_draw_list();
+
+    if (_config.bind_benchmark_draws > 0)
+    {
+        run_bind_benchmark();
+    }
+
+    if (!_config.shader_load_benchmark_path.empty())
+    {
+        run_shader_load_benchmark();
+    }
+
+    if (_config.allocation_benchmark_buffers > 0)
+    {
+        run_allocation_benchmark();
+    }
+
+    if (_config.upload_benchmark_mib > 0)
+    {
+        run_upload_benchmark();
+    }
+
     // everything went fine
     _is_initialized = true;
+    _last_report_time = std::chrono::steady_clock::now();
 }
 
-void VulkanEngine::cleanup() const
+void VulkanEngine::cleanup()
 {
     // NOTE: We must destroy objects in the reverse order in which they were
     // created
     if (_is_initialized)
     {
+        // nothing should be reloaded while shutting down
+        _shader_watcher.cleanup();
+
+        // stop the present thread first, it may still be presenting our last frames
+        if (_present_thread_enabled)
+        {
+            drain_present_thread();
+            _present_thread.cleanup();
+        }
+
         // make sure the GPU has stopped doing its things
         vkDeviceWaitIdle(_device);
 
-        // destroy command pool
-        vkDestroyCommandPool(_device, _command_pool, nullptr);
+        if (_recording_threads > 0)
+        {
+            _recording_pool.cleanup();
+        }
+
+        // nothing is in flight anymore, so anything retired during the run can go
+        _deletion_queue.flush_all();
+
+        if (_stats_total.frames > 0)
+        {
+            std::cout << "Frames in flight: " << _frames_in_flight << ", average CPU time blocked in "
+                      << (_timeline_semaphores_enabled ? "vkWaitSemaphores" : "vkWaitForFences") << ": "
+                      << _stats_total.gpu_wait_ms / _stats_total.frames << " ms/frame, CPU frame cost: "
+                      << _stats_total.cpu_frame_ms / _stats_total.frames << " ms, GPU frame cost: "
+                      << (_stats_total.gpu_samples > 0 ? _stats_total.gpu_frame_ms / _stats_total.gpu_samples : 0.0)
+                      << " ms over " << _stats_total.frames << " frames" << std::endl;
+        }
+
+        for (uint32_t i = 0; i < _frames_in_flight; ++i)
+        {
+            // destroying a command pool also frees the command buffers allocated from it
+            vkDestroyCommandPool(_device, _frames[i].command_pool, nullptr);
+            for (VkCommandPool worker_command_pool : _frames[i].worker_command_pools)
+            {
+                vkDestroyCommandPool(_device, worker_command_pool, nullptr);
+            }
+
+            // destroy sync objects
+            vkDestroyFence(_device, _frames[i].render_fence, nullptr);
+
+            vkDestroyQueryPool(_device, _frames[i].timestamp_pool, nullptr);
+        }
+
+        for (uint32_t i = 0; i < _frames_in_flight + 1; ++i)
+        {
+            vkDestroySemaphore(_device, _acquire_semaphores[i], nullptr);
+        }
+        for (VkSemaphore render_semaphore : _render_semaphores)
+        {
+            vkDestroySemaphore(_device, render_semaphore, nullptr);
+        }
+
+        // let any background compiles (and optimised links) finish before their pipelines are destroyed
+        if (_config.use_async_pipelines || _pipeline_libraries_enabled || _shader_watcher_enabled)
+        {
+            _compile_pool.cleanup();
+        }
+
+        // pipelines evicted while we were still drawing with them, which nothing replaced before shutdown
+        for (VkPipeline pipeline : _reload_retired_pipelines)
+        {
+            vkDestroyPipeline(_device, pipeline, nullptr);
+        }
+
+        // nothing collected these, and nothing will use the pipelines being replaced anymore
+        for (const PipelineUpgrade &upgrade : _pipeline_registry.take_upgrades())
+        {
+            vkDestroyPipeline(_device, upgrade.old_pipeline, nullptr);
+        }
+
+        std::cout << _raster_permutations.size() << " pipeline permutations were served by "
+                  << _pipeline_registry.pipeline_count() << " pipelines" << std::endl;
+
+        const PipelineCompileStats compile_stats = _pipeline_registry.compile_stats();
+        std::cout << "Pipeline registry: " << _pipeline_registry.hits() << " hits, " << _pipeline_registry.misses()
+                  << " misses, " << compile_stats.compiles << " compiles (" << compile_stats.batches
+                  << " batches) averaging "
+                  << (compile_stats.compiles > 0 ? compile_stats.total_compile_ms / compile_stats.compiles : 0.0)
+                  << " ms (slowest " << compile_stats.max_compile_ms << " ms)";
+        if (compile_stats.async_compiles > 0)
+        {
+            std::cout << ", background compiles ready after "
+                      << compile_stats.total_latency_ms / compile_stats.async_compiles << " ms on average (slowest "
+                      << compile_stats.max_latency_ms << " ms)";
+        }
+        if (_pipeline_libraries_enabled)
+        {
+            std::cout << ", " << compile_stats.libraries << " pipeline library parts, "
+                      << compile_stats.optimised_links << " optimised links averaging "
+                      << (compile_stats.optimised_links > 0
+                              ? compile_stats.total_optimise_ms / compile_stats.optimised_links
+                              : 0.0)
+                      << " ms";
+        }
+        std::cout << std::endl;
+        _triangle_permutations.cleanup();
+        _pipeline_registry.cleanup();
+
+        // the compile pool has drained, so every background build is done with its shader modules
+        release_triangle_shaders();
+        release_finished_builds();
+        std::cout << "Shader module cache: " << _shader_modules.hits() << " hits, " << _shader_modules.misses()
+                  << " modules created, " << _shader_modules.module_count() << " still held at shutdown" << std::endl;
+        _shader_modules.cleanup();
+
+        std::cout << "Pipeline layout cache: " << _pipeline_layouts.pipeline_layout_count() << " pipeline layouts, "
+                  << _pipeline_layouts.set_layout_count() << " descriptor set layouts" << std::endl;
+        _pipeline_layouts.cleanup();
+
+        _shader_objects.destroy_graphics_shaders(_device, _rainbow_triangle_shaders);
+        _shader_objects.destroy_graphics_shaders(_device, _red_triangle_shaders);
+
+        // keep whatever the driver compiled this run for next time
+        _pipeline_cache.save();
+        _pipeline_cache.cleanup();
+
+        // this frees every cached command buffer as well
+        if (_cached_command_pool != VK_NULL_HANDLE)
+        {
+            vkDestroyCommandPool(_device, _cached_command_pool, nullptr);
+        }
 
-        // destroy sync objects
-        vkDestroyFence(_device, _render_fence, nullptr);
-        vkDestroySemaphore(_device, _render_semaphore, nullptr);
-        vkDestroySemaphore(_device, _present_semaphore, nullptr);
+        if (_timeline_semaphores_enabled)
+        {
+            _graphics_timeline.cleanup();
+        }
 
         // destroy swapchain
         vkDestroySwapchainKHR(_device, _swapchain, nullptr);
@@ -90,6 +291,27 @@ void VulkanEngine::cleanup() const
             vkDestroyImageView(_device, _swapchain_image_views[i], nullptr);
         }
 
+        std::cout << "Uploads: " << _upload_manager.bytes_uploaded() / 1024 << " KiB in "
+                  << _upload_manager.batches_submitted() << " submissions" << std::endl;
+        _upload_manager.cleanup();
+
+        std::cout << "Frame allocator: peak " << _frame_allocator.peak_usage() / 1024 << " of "
+                  << _frame_allocator.frame_size() / 1024 << " KiB per frame, "
+                  << _frame_allocator.failed_allocations() << " allocations didn't fit" << std::endl;
+        for (const auto &descriptor_pool : _descriptor_pools)
+        {
+            vkDestroyDescriptorPool(_device, descriptor_pool.second, nullptr);
+        }
+        if (_cached_draw_data.buffer != VK_NULL_HANDLE)
+        {
+            _gpu_allocator.destroy_buffer(_cached_draw_data);
+        }
+        _frame_allocator.cleanup();
+
+        // every buffer and image has been destroyed by now, which leaves only the pools' empty blocks
+        _gpu_allocator.print_stats();
+        _gpu_allocator.cleanup();
+
         vkDestroyDevice(_device, nullptr);
         vkDestroySurfaceKHR(_instance, _surface, nullptr);
         vkb::destroy_debug_utils_messenger(_instance, _debug_messenger);
@@ -101,81 +323,162 @@ void VulkanEngine::cleanup() const
 
 void VulkanEngine::draw()
 {
-    // wait until the GPU has finished rendering the previous frame, with a
-    // timeout of 1 second
-    VK_CHECK(vkWaitForFences(_device, 1, &_render_fence, true, 1000000000 /*ns*/));
-    VK_CHECK(vkResetFences(_device, 1, &_render_fence));
+    FrameData &frame = get_current_frame();
 
-    // request an image from the swapchain, with a timeout of 1 second
-    uint32_t swapchain_image_index;
-    VK_CHECK(vkAcquireNextImageKHR(_device, _swapchain, 1000000000 /*ns*/, _present_semaphore, nullptr,
-                                   &swapchain_image_index));
+    // wait until the GPU has finished rendering the last frame that used this slot, with a
+    // timeout of 1 second. With more than one frame in flight this is usually already signalled
+    const auto wait_start = std::chrono::steady_clock::now();
+    if (_timeline_semaphores_enabled)
+    {
+        VK_CHECK(_graphics_timeline.wait(frame.timeline_value, 1000000000 /*ns*/));
+    }
+    else
+    {
+        VK_CHECK(vkWaitForFences(_device, 1, &frame.render_fence, true, 1000000000 /*ns*/));
+    }
+    const std::chrono::duration<double, std::milli> wait_time = std::chrono::steady_clock::now() - wait_start;
+    _stats_total.gpu_wait_ms += wait_time.count();
+    _stats_window.gpu_wait_ms += wait_time.count();
 
-    // at this point, we are sure that the commands have finished executing, and
-    // we can safely reset the command buffer before we begin recording to it
-    // again
-    VK_CHECK(vkResetCommandBuffer(_main_command_buffer, 0));
+    // the GPU is done with this slot, so its timestamps from last time round are available
+    read_frame_timestamps(frame);
 
-    VkCommandBuffer command_buffer = _main_command_buffer;
+    // the frame that used this slot before us has finished, and frames retire in order, so anything last used by it
+    // (or earlier) can now be destroyed
+    _last_completed_frame = _frame_number - static_cast<int64_t>(_frames_in_flight);
+    _deletion_queue.flush(_last_completed_frame);
 
-    // begin the command buffer recording. We will use this command buffer exactly
-    // one time, so we want to let Vulkan know that
-    VkCommandBufferBeginInfo command_buffer_begin_info = {}; // initialise structure to 0's
-    command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    command_buffer_begin_info.pNext = nullptr;
-    command_buffer_begin_info.pInheritanceInfo = nullptr;
-    command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    // and so has the per-frame data it allocated
+    _frame_allocator.begin_frame(static_cast<uint32_t>(_frame_number % _frames_in_flight));
 
-    VK_CHECK(vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info));
+    poll_async_pipelines();
 
-    // make a clear colour from frame number. This will flash with a 120*pi frame
-    // period
-    VkClearValue clear_value;
-    float flash = abs(std::sin(_frame_number / 120.f));
-    clear_value.color = {{0.0f, 0.0f, flash, 1.0f}};
+    if (_shader_watcher_enabled)
+    {
+        poll_shader_reloads();
+    }
 
-    // start with the main render pass
-    // we will use the clear colour defined above, and the framebuffer of the
-    // index the swapchain gave us
-    VkRenderPassBeginInfo render_pass_begin_info = {}; // initialise struct with 0's
-    render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    render_pass_begin_info.pNext = nullptr;
-    render_pass_begin_info.renderPass = _render_pass;
-    render_pass_begin_info.renderArea.offset.x = 0;
-    render_pass_begin_info.renderArea.offset.y = 0;
-    render_pass_begin_info.renderArea.extent = _window_extent;
-    render_pass_begin_info.framebuffer = _framebuffers[swapchain_image_index]; // this is where we render into
+    // only once the reloaded pipelines have been swapped in, which is a lookup while their builds still hold the
+    // new shader modules
+    release_finished_builds();
 
-    // connect up clear values
-    render_pass_begin_info.clearValueCount = 1;
-    render_pass_begin_info.pClearValues = &clear_value;
+    // presents happen asynchronously on the present thread, so pick up whatever they told us about the swapchain
+    if (_present_thread_enabled && _present_thread.take_swapchain_out_of_date())
+    {
+        _swapchain_dirty = true;
+    }
 
-    // begin this render pass
-    vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    // rebuild the swapchain if the window changed size or the last present told us it no longer matches the surface
+    if (_swapchain_dirty)
+    {
+        recreate_swapchain();
+    }
 
-    // render commands go here
-    if (_selected_shader == 0)
+    // request an image from the swapchain, with a timeout of 1 second
+    uint32_t swapchain_image_index;
+    VkSemaphore acquire_semaphore = get_acquire_semaphore(_frame_number);
+    VkResult acquire_result = acquire_next_image(acquire_semaphore, &swapchain_image_index);
+    if (acquire_result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        // no image was acquired and nothing will be submitted for this slot, so its fence stays signalled and we
+        // simply try again with a fresh swapchain next time round
+        _swapchain_dirty = true;
+        return;
+    }
+    else if (acquire_result == VK_SUBOPTIMAL_KHR)
     {
-        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _rainbow_triangle_pipeline);
+        // we still own a usable image, so render this frame and rebuild afterwards
+        _swapchain_dirty = true;
     }
     else
     {
-        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _red_triangle_pipeline);
+        VK_CHECK(acquire_result);
+    }
+
+    // stop the present thread from falling more than a ring's worth of frames behind
+    if (_present_thread_enabled && _frame_number >= static_cast<int>(_frames_in_flight))
+    {
+        _present_thread.wait_for_presents(_frame_number - _frames_in_flight + 1);
     }
 
-    vkCmdDraw(command_buffer, 3, 1, 0, 0);
+    // the CPU cost of a frame is everything from here until submission, excluding time spent blocked on the GPU or the
+    // presentation engine
+    const auto cpu_start = std::chrono::steady_clock::now();
 
-    // finalise this render pass
-    vkCmdEndRenderPass(command_buffer);
+    // only reset the fence once we know we are going to submit work that signals it again
+    if (!_timeline_semaphores_enabled)
+    {
+        VK_CHECK(vkResetFences(_device, 1, &frame.render_fence));
+    }
+
+    // make a clear colour from frame number. This will flash with a 120*pi frame
+    // period, unless the animation has been paused
+    if (_animate_clear_colour)
+    {
+        _clear_colour_frame++;
+    }
+    VkClearValue clear_value;
+    float flash = abs(std::sin(_clear_colour_frame / 120.f));
+    clear_value.color = {{0.0f, 0.0f, flash, 1.0f}};
+
+    VkCommandBuffer command_buffer;
+    if (_cached_command_pool != VK_NULL_HANDLE)
+    {
+        // static frames resubmit what was recorded for this swapchain image last time round
+        command_buffer = get_cached_command_buffer(swapchain_image_index, clear_value);
+    }
+    else
+    {
+        // at this point, we are sure that the commands have finished executing, and
+        // we can safely reset the command buffer before we begin recording to it
+        // again
+        VK_CHECK(vkResetCommandBuffer(frame.main_command_buffer, 0));
+
+        command_buffer = frame.main_command_buffer;
+
+        // begin the command buffer recording. We will use this command buffer exactly
+        // one time, so we want to let Vulkan know that
+        VkCommandBufferBeginInfo command_buffer_begin_info = {}; // initialise structure to 0's
+        command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        command_buffer_begin_info.pNext = nullptr;
+        command_buffer_begin_info.pInheritanceInfo = nullptr;
+        command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        VK_CHECK(vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info));
+
+        // timestamp the start of the frame on the GPU
+        if (_timestamps_supported)
+        {
+            vkCmdResetQueryPool(command_buffer, frame.timestamp_pool, 0, 2);
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestamp_pool, 0);
+        }
+
+        record_render_pass(command_buffer, swapchain_image_index, clear_value,
+                           _recording_threads > 0 ? &frame : nullptr);
+
+        // and timestamp the point where all of the frame's GPU work has finished
+        if (_timestamps_supported)
+        {
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestamp_pool, 1);
+            frame.timestamps_written = true;
+        }
+
+        // finalise command buffer (we can no longer add commands, but it can now be
+        // executed by the GPU)
+        VK_CHECK(vkEndCommandBuffer(command_buffer));
+    }
 
-    // finalise command buffer (we can no longer add commands, but it can now be
-    // executed by the GPU)
-    VK_CHECK(vkEndCommandBuffer(command_buffer));
+    // the draws wrote their data through mapped memory, which the GPU may not see without a flush
+    _frame_allocator.flush();
+
+    // everything uploaded since the last frame goes in one submission, ahead of the frame so its draws can use it
+    _upload_manager.submit();
 
     // prepare submision to the queue
-    // we want to wait on the _present_semaphore, as that semaphore is signaled
-    // when the swapchain is ready we will signal the _render_semaphore to signal
-    // that rendering has finished
+    // we want to wait on the acquire semaphore, as that semaphore is signaled
+    // when the swapchain is ready we will signal the image's render semaphore to
+    // signal that rendering has finished
+    VkSemaphore render_semaphore = _render_semaphores[swapchain_image_index];
     VkSubmitInfo submit = {}; // initialise struct to 0's
     submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submit.pNext = nullptr;
@@ -184,39 +487,84 @@ void VulkanEngine::draw()
     submit.pWaitDstStageMask = &wait_stage;
 
     submit.waitSemaphoreCount = 1;
-    submit.pWaitSemaphores = &_present_semaphore;
+    submit.pWaitSemaphores = &acquire_semaphore;
 
     submit.signalSemaphoreCount = 1;
-    submit.pSignalSemaphores = &_render_semaphore;
+    submit.pSignalSemaphores = &render_semaphore;
 
     submit.commandBufferCount = 1;
     submit.pCommandBuffers = &command_buffer;
 
     // submit the command bugger to the queue and execute it
-    // _render_fence will now block until the GPU finishes executing the graphics
-    // commands
-    VK_CHECK(vkQueueSubmit(_graphics_queue, 1, &submit, _render_fence));
+    {
+        std::lock_guard<std::mutex> lock(_graphics_queue_mutex);
+        if (_timeline_semaphores_enabled)
+        {
+            // tag the frame with the timeline value that will be signalled once the GPU is done with it
+            VK_CHECK(_graphics_timeline.submit(_graphics_queue, submit, &frame.timeline_value));
+        }
+        else
+        {
+            // the frame's render fence will now block until the GPU finishes executing the graphics
+            // commands
+            VK_CHECK(vkQueueSubmit(_graphics_queue, 1, &submit, frame.render_fence));
+        }
+    }
+
+    const std::chrono::duration<double, std::milli> cpu_time = std::chrono::steady_clock::now() - cpu_start;
+    _stats_total.cpu_frame_ms += cpu_time.count();
+    _stats_window.cpu_frame_ms += cpu_time.count();
 
-    // this will put the image we just rendered into the visible window
-    // we want to wait on the _render_semaphore for that as it's necessary that all
-    // drawing commands have finished before the image is displayed to the user
-    VkPresentInfoKHR present_info = {}; // initialise struct to 0's
-    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present_info.pNext = nullptr;
+    if (_present_thread_enabled)
+    {
+        // the present thread waits on the render semaphore before putting the image in the visible window
+        _present_thread.request_present(_swapchain, render_semaphore, swapchain_image_index);
+
+        // and we ask for the next frame's image straight away, so any time spent waiting on the presentation engine
+        // overlaps with this thread handling input and recording. The next frame's acquire semaphore was last waited
+        // on by a frame that has already finished on the GPU
+        if (!_swapchain_dirty)
+        {
+            _present_thread.request_acquire(_swapchain, get_acquire_semaphore(_frame_number + 1));
+            _acquire_pending = true;
+        }
+    }
+    else
+    {
+        // this will put the image we just rendered into the visible window
+        // we want to wait on the render semaphore for that as it's necessary that all
+        // drawing commands have finished before the image is displayed to the user
+        VkPresentInfoKHR present_info = {}; // initialise struct to 0's
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present_info.pNext = nullptr;
 
-    present_info.swapchainCount = 1;
-    present_info.pSwapchains = &_swapchain;
+        present_info.swapchainCount = 1;
+        present_info.pSwapchains = &_swapchain;
 
-    present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = &_render_semaphore;
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = &render_semaphore;
 
-    present_info.pImageIndices = &swapchain_image_index;
+        present_info.pImageIndices = &swapchain_image_index;
 
-    // present to user's screen
-    VK_CHECK(vkQueuePresentKHR(_graphics_queue, &present_info));
+        // present to user's screen. An out of date or suboptimal swapchain is not an error, we just rebuild it before
+        // the next frame
+        VkResult present_result = vkQueuePresentKHR(_graphics_queue, &present_info);
+        if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR)
+        {
+            _swapchain_dirty = true;
+        }
+        else
+        {
+            VK_CHECK(present_result);
+        }
+    }
 
     // increment the number of frames drawn
     _frame_number++;
+    _stats_total.frames++;
+    _stats_window.frames++;
+
+    report_frame_stats();
 }
 
 void VulkanEngine::run()
@@ -235,6 +583,11 @@ void VulkanEngine::run()
             {
                 b_quit = true;
             }
+            else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+            {
+                // rebuild the swapchain at the start of the next frame
+                _swapchain_dirty = true;
+            }
             else if (e.type == SDL_KEYDOWN)
             {
                 if (e.key.keysym.sym == SDLK_SPACE)
@@ -244,10 +597,68 @@ void VulkanEngine::run()
                     {
                         _selected_shader = 0;
                     }
+
+                    build_draw_list();
+                }
+                else if (e.key.keysym.sym == SDLK_c)
+                {
+                    _animate_clear_colour = !_animate_clear_colour;
+                }
+                else if (e.key.keysym.sym == SDLK_w)
+                {
+                    if (_wireframe_supported)
+                    {
+                        _raster_state.polygon_mode = _raster_state.polygon_mode == VK_POLYGON_MODE_FILL
+                                                         ? VK_POLYGON_MODE_LINE
+                                                         : VK_POLYGON_MODE_FILL;
+                        update_raster_pipelines();
+                    }
+                    else
+                    {
+                        std::cout << "Wireframe is not supported by this device" << std::endl;
+                    }
+                }
+                else if (e.key.keysym.sym == SDLK_b)
+                {
+                    // cycle through no culling, back face culling and front face culling
+                    const VkCullModeFlags cull_mode = _raster_state.cull_mode;
+                    _raster_state.cull_mode = cull_mode == VK_CULL_MODE_NONE       ? VK_CULL_MODE_BACK_BIT
+                                              : cull_mode == VK_CULL_MODE_BACK_BIT ? VK_CULL_MODE_FRONT_BIT
+                                                                                   : VK_CULL_MODE_NONE;
+                    update_raster_pipelines();
+                }
+                else if (e.key.keysym.sym == SDLK_f)
+                {
+                    _raster_state.front_face = _raster_state.front_face == VK_FRONT_FACE_CLOCKWISE
+                                                   ? VK_FRONT_FACE_COUNTER_CLOCKWISE
+                                                   : VK_FRONT_FACE_CLOCKWISE;
+                    update_raster_pipelines();
+                }
+                else if (e.key.keysym.sym == SDLK_p)
+                {
+                    // cycle through the present modes the surface supports
+                    const VkPresentModeKHR present_modes[] = {
+                        VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                        VK_PRESENT_MODE_IMMEDIATE_KHR};
+                    const auto current = std::find(std::begin(present_modes), std::end(present_modes), _present_mode);
+                    size_t next = current - std::begin(present_modes);
+                    do
+                    {
+                        next = (next + 1) % std::size(present_modes);
+                    } while (!is_present_mode_supported(present_modes[next]));
+
+                    set_present_mode(present_modes[next]);
                 }
             }
         }
 
+        // there is nothing to present to while minimised, so don't spin the GPU (or the CPU) for nothing
+        if (SDL_GetWindowFlags(_window) & SDL_WINDOW_MINIMIZED)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
         draw();
     }
 }
@@ -256,10 +667,16 @@ void VulkanEngine::init_vulcan()
 {
     vkb::InstanceBuilder builder;
 
+    // we only need Vulkan 1.1, but we ask for 1.2 when the loader has it so that optional 1.2 features (like timeline
+    // semaphores) can be used on devices that support them
+    uint32_t loader_version = VK_API_VERSION_1_0;
+    vkEnumerateInstanceVersion(&loader_version);
+    const uint32_t instance_version = loader_version >= VK_API_VERSION_1_2 ? VK_API_VERSION_1_2 : VK_API_VERSION_1_1;
+
     auto instance = builder.set_app_name("Vulkan Playground")
                         .request_validation_layers(true) // TODO: In prod, we would remove
                                                          // this to improve performance
-                        .require_api_version(1, 1, 0)
+                        .require_api_version(1, VK_VERSION_MINOR(instance_version), 0)
                         .use_default_debug_messenger() // Use this to catch validation errors
                         .build();
 
@@ -274,63 +691,335 @@ void VulkanEngine::init_vulcan()
     // create a surface using the window we opened with SDL
     SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
 
+    // extensions we can make use of if the device has them
+    std::vector<const char *> desired_extensions = ExtendedDynamicState::desired_extensions();
+    if (_config.use_pipeline_libraries)
+    {
+        const std::vector<const char *> library_extensions = GraphicsPipelineLibrary::desired_extensions();
+        desired_extensions.insert(desired_extensions.end(), library_extensions.begin(), library_extensions.end());
+    }
+    if (_config.use_shader_objects || _config.bind_benchmark_draws > 0)
+    {
+        const std::vector<const char *> shader_object_extensions = ShaderObjects::desired_extensions();
+        desired_extensions.insert(desired_extensions.end(), shader_object_extensions.begin(),
+                                  shader_object_extensions.end());
+    }
+
     // select a physical GPU to use, using the vk bootstrap library to choose for
     // us
     vkb::PhysicalDeviceSelector selector{vkb_instance};
-    vkb::PhysicalDevice physical_device = selector.set_minimum_version(1, 1).set_surface(_surface).select().value();
+    vkb::PhysicalDevice physical_device = selector.set_minimum_version(1, 1)
+                                              .set_surface(_surface)
+                                              .add_desired_extensions(desired_extensions)
+                                              .select()
+                                              .value();
+
+    // the API version we can actually use is the lower of what the instance and the device support
+    const uint32_t api_version = std::min(instance_version, physical_device.properties.apiVersion);
+
+    // query the optional features we know how to make use of
+    VkPhysicalDeviceTimelineSemaphoreFeatures supported_timeline_features = {}; // initialise struct to 0's
+    supported_timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+    VkPhysicalDeviceFeatures2 supported_features = {}; // initialise struct to 0's
+    supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported_features.pNext = api_version >= VK_API_VERSION_1_2 ? &supported_timeline_features : nullptr;
+    vkGetPhysicalDeviceFeatures2(physical_device.physical_device, &supported_features);
+
+    // wireframe needs fillModeNonSolid, which is optional
+    _wireframe_supported = supported_features.features.fillModeNonSolid;
+    physical_device.features.fillModeNonSolid = supported_features.features.fillModeNonSolid;
 
     // create the logical Vulkan device using the selected physical GPU
     vkb::DeviceBuilder device_builder{physical_device};
+
+    // timeline semaphores are opt-in, and we fall back to fences + binary semaphores on devices without them
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features = {}; // initialise struct to 0's
+    timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timeline_features.timelineSemaphore = VK_TRUE;
+
+    if (_config.use_timeline_semaphores)
+    {
+        if (supported_timeline_features.timelineSemaphore)
+        {
+            device_builder.add_pNext(&timeline_features);
+            _timeline_semaphores_enabled = true;
+        }
+        else
+        {
+            std::cout << "Timeline semaphores are not supported by this device, falling back to fences" << std::endl;
+        }
+    }
+
+    // make as much of the raster state dynamic as the device lets us
+    _extended_dynamic_state.enable_supported_features(physical_device.physical_device, device_builder);
+
+    // pipeline libraries are opt-in, pipelines are compiled whole without them
+    if (_config.use_pipeline_libraries)
+    {
+        _graphics_pipeline_library.enable_supported_features(physical_device.physical_device, device_builder);
+        _pipeline_libraries_enabled = _graphics_pipeline_library.is_supported();
+        if (_pipeline_libraries_enabled)
+        {
+            std::cout << "Pipelines are linked from pipeline libraries (fast linking "
+                      << (_graphics_pipeline_library.has_fast_linking() ? "yes" : "no") << ")" << std::endl;
+        }
+        else
+        {
+            std::cout << "Graphics pipeline libraries are not supported by this device, compiling whole pipelines"
+                      << std::endl;
+        }
+    }
+
+    // shader objects are opt-in too, and the benchmark needs them to compare against
+    if (_config.use_shader_objects || _config.bind_benchmark_draws > 0)
+    {
+        _shader_objects.enable_supported_features(physical_device.physical_device, device_builder);
+        _shader_objects_enabled = _config.use_shader_objects && _shader_objects.is_supported();
+        if (_shader_objects_enabled)
+        {
+            std::cout << "Drawing with shader objects, no pipelines are built" << std::endl;
+        }
+        else if (!_shader_objects.is_supported())
+        {
+            std::cout << "Shader objects are not supported by this device, drawing with pipelines" << std::endl;
+        }
+    }
+
     vkb::Device vkb_device = device_builder.build().value();
 
     // persist for later usage
     _device = vkb_device.device;
+    _extended_dynamic_state.load_functions(_device);
+    _shader_objects.load_functions(_device);
+    std::cout << "Dynamic raster state: extended dynamic state "
+              << (_extended_dynamic_state.has_extended_dynamic_state() ? "yes" : "no") << ", extended dynamic state 2 "
+              << (_extended_dynamic_state.has_extended_dynamic_state2() ? "yes" : "no") << ", polygon mode "
+              << (_extended_dynamic_state.has_dynamic_polygon_mode() ? "yes" : "no") << std::endl;
     _chosen_gpu = physical_device.physical_device;
+    _gpu_properties = physical_device.properties;
+
+    _gpu_allocator.init(_instance, _chosen_gpu, _device, api_version);
 
     // use bootstrapper to get a graphics queue
     _graphics_queue = vkb_device.get_queue(vkb::QueueType::graphics).value();
     _graphics_queue_family = vkb_device.get_queue_index(vkb::QueueType::graphics).value();
+
+    // a queue family without valid timestamp bits can't time the GPU side of a frame
+    _timestamp_valid_bits = vkb_device.queue_families[_graphics_queue_family].timestampValidBits;
+    _timestamps_supported = _gpu_properties.limits.timestampComputeAndGraphics || _timestamp_valid_bits > 0;
+
+    // the bootstrapper creates a queue in every family. A transfer-only family is usually the GPU's copy engines,
+    // failing that any family without graphics still keeps the copies off the render queue. Single queue devices
+    // (lavapipe among them) copy on the graphics queue
+    auto dedicated_transfer_family = vkb_device.get_dedicated_queue_index(vkb::QueueType::transfer);
+    auto separate_transfer_family = vkb_device.get_queue_index(vkb::QueueType::transfer);
+    if (dedicated_transfer_family.has_value())
+    {
+        _transfer_queue = vkb_device.get_dedicated_queue(vkb::QueueType::transfer).value();
+        _transfer_queue_family = dedicated_transfer_family.value();
+    }
+    else if (separate_transfer_family.has_value())
+    {
+        _transfer_queue = vkb_device.get_queue(vkb::QueueType::transfer).value();
+        _transfer_queue_family = separate_transfer_family.value();
+    }
+    else
+    {
+        _transfer_queue = _graphics_queue;
+        _transfer_queue_family = _graphics_queue_family;
+    }
+
+    if (_transfer_queue_family != _graphics_queue_family)
+    {
+        std::cout << "Uploading on a separate transfer queue (family " << _transfer_queue_family << ")" << std::endl;
+    }
+    else
+    {
+        std::cout << "No separate transfer queue family, uploading on the graphics queue" << std::endl;
+    }
 }
 
 void VulkanEngine::init_swapchain()
 {
     vkb::SwapchainBuilder swapchain_builder{_chosen_gpu, _device, _surface};
 
+    // vk-bootstrap quietly falls back to FIFO (which every surface supports) for unsupported modes, so we track what
+    // we actually got
+    _present_mode = _config.present_mode;
+    if (!is_present_mode_supported(_present_mode))
+    {
+        std::cout << "Present mode " << present_mode_name(_present_mode)
+                  << " is not supported by this surface, falling back to FIFO" << std::endl;
+        _present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    }
+
+    // when rebuilding, handing over the old swapchain lets the driver reuse its resources and keep presenting the
+    // images that are still queued up
     vkb::Swapchain vkb_swapchain = swapchain_builder.use_default_format_selection()
-                                       .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR) // TODO: vsync present mode
-                                       .set_desired_extent(_window_extent.width,
-                                                           _window_extent.height) // TODO: Need to rebuild the swapchain
-                                                                                  // whenever the window is resized
+                                       .set_desired_present_mode(_present_mode)
+                                       .set_desired_min_image_count(_config.min_image_count)
+                                       .set_desired_extent(_window_extent.width, _window_extent.height)
+                                       .set_old_swapchain(_swapchain)
                                        .build()
                                        .value();
 
     // persist swapchain and related image stuff
     _swapchain = vkb_swapchain.swapchain;
+    _window_extent = vkb_swapchain.extent; // the surface may not give us exactly what we asked for
+
     _swapchain_images = vkb_swapchain.get_images().value();
     _swapchain_image_views = vkb_swapchain.get_image_views().value();
     _swapchain_image_format = vkb_swapchain.image_format;
-}
-
-void VulkanEngine::init_commands()
-{
-    // create command pool for commands submitted to the graphics queue
-    // we also want the pool to allow for resetting of individual command buffers
-    VkCommandPoolCreateInfo command_pool_info = vulkan_engine::initialisers::command_pool_create_info(
-        _graphics_queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-    VK_CHECK(vkCreateCommandPool(_device, &command_pool_info, nullptr, &_command_pool));
 
-    // allocate the default command buffer that we will use for rendering
-    VkCommandBufferAllocateInfo command_alloc_info =
-        vulkan_engine::initialisers::command_buffer_allocate_info(_command_pool, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-    VK_CHECK(vkAllocateCommandBuffers(_device, &command_alloc_info, &_main_command_buffer));
+    std::cout << "Swapchain: " << _window_extent.width << "x" << _window_extent.height << ", "
+              << present_mode_name(_present_mode) << ", " << _swapchain_images.size() << " images" << std::endl;
 }
 
-void VulkanEngine::init_default_render_pass()
+void VulkanEngine::recreate_swapchain()
 {
-    VkAttachmentDescription colour_attachment = create_colour_attachment();
-    VkSubpassDescription single_subpass = create_subpass();
+    // size the new swapchain to what the window actually is now
+    int width = 0;
+    int height = 0;
+    SDL_Vulkan_GetDrawableSize(_window, &width, &height);
+    if (width == 0 || height == 0)
+    {
+        // minimised, keep the old swapchain until the window is visible again
+        return;
+    }
+    _window_extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
 
-    VkRenderPassCreateInfo render_pass_info = {}; // initialise struct to 0's
+    // the present thread may still be presenting to (or acquiring from) the old swapchain
+    if (_present_thread_enabled)
+    {
+        drain_present_thread();
+    }
+
+    // frames that are still in flight keep rendering into and presenting the old images, so rather than waiting for
+    // the device to go idle we hand them to the deletion queue, tagged with the last frame that could reference them
+    VkSwapchainKHR old_swapchain = _swapchain;
+    std::vector<VkImageView> old_image_views = std::move(_swapchain_image_views);
+    std::vector<VkFramebuffer> old_framebuffers = std::move(_framebuffers);
+    std::vector<VkSemaphore> old_render_semaphores = std::move(_render_semaphores);
+    const VkFormat old_image_format = _swapchain_image_format;
+
+    // creates the new swapchain from the old one
+    init_swapchain();
+
+    // the surface may have handed us another format, which the render pass (and so every pipeline and framebuffer)
+    // has to match
+    const bool format_changed = _swapchain_image_format != old_image_format;
+    if (format_changed)
+    {
+        std::cout << "Swapchain format changed, rebuilding the render pass" << std::endl;
+        _deletion_queue.push(_frame_number - 1, [device = _device, render_pass = _render_pass]() {
+            vkDestroyRenderPass(device, render_pass, nullptr);
+        });
+        init_default_render_pass();
+    }
+
+    init_framebuffers();
+    init_render_semaphores();
+
+    // cached command buffers reference the old framebuffers and extent, and the image count may have changed too
+    for (CachedCommandBuffer &cached : _cached_command_buffers)
+    {
+        if (cached.command_buffer != VK_NULL_HANDLE)
+        {
+            retire_cached_command_buffer(cached);
+        }
+    }
+    _cached_command_buffers.assign(_cached_command_pool != VK_NULL_HANDLE ? _swapchain_images.size() : 0, {});
+
+    // the frame fences don't cover presents, and without VK_EXT_swapchain_maintenance1 nothing else does either. So
+    // the old swapchain is kept until the first frame that acquires from the new one has finished, by which point the
+    // presentation engine has moved on to the new swapchain. That is a heuristic rather than a guarantee
+    _deletion_queue.push(_frame_number, [device = _device, old_swapchain, old_image_views, old_framebuffers,
+                                         old_render_semaphores]() {
+        for (VkFramebuffer framebuffer : old_framebuffers)
+        {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+
+        for (VkSemaphore render_semaphore : old_render_semaphores)
+        {
+            vkDestroySemaphore(device, render_semaphore, nullptr);
+        }
+
+        for (VkImageView image_view : old_image_views)
+        {
+            vkDestroyImageView(device, image_view, nullptr);
+        }
+
+        vkDestroySwapchainKHR(device, old_swapchain, nullptr);
+    });
+
+    // pipelines built against the old render pass aren't compatible with the new one
+    if (format_changed && (_rainbow_triangle_pipeline != VK_NULL_HANDLE || _red_triangle_pipeline != VK_NULL_HANDLE))
+    {
+        rebuild_triangle_pipelines();
+        build_draw_list();
+    }
+
+    _swapchain_dirty = false;
+}
+
+void VulkanEngine::init_commands()
+{
+    // create command pool for commands submitted to the graphics queue
+    // we also want the pool to allow for resetting of individual command buffers
+    VkCommandPoolCreateInfo command_pool_info = vulkan_engine::initialisers::command_pool_create_info(
+        _graphics_queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+    // every frame in flight gets its own pool, so that resetting one frame never touches a buffer the GPU is still
+    // executing for another frame
+    for (uint32_t i = 0; i < _frames_in_flight; ++i)
+    {
+        VK_CHECK(vkCreateCommandPool(_device, &command_pool_info, nullptr, &_frames[i].command_pool));
+
+        // allocate the default command buffer that we will use for rendering
+        VkCommandBufferAllocateInfo command_alloc_info = vulkan_engine::initialisers::command_buffer_allocate_info(
+            _frames[i].command_pool, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        VK_CHECK(vkAllocateCommandBuffers(_device, &command_alloc_info, &_frames[i].main_command_buffer));
+
+        // each recording thread gets a pool per frame too. These are reset wholesale every frame by the thread that
+        // records into them, which is cheaper than resetting individual buffers
+        VkCommandPoolCreateInfo worker_pool_info = vulkan_engine::initialisers::command_pool_create_info(
+            _graphics_queue_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+        _frames[i].worker_command_pools.resize(_recording_threads);
+        _frames[i].worker_command_buffers.resize(_recording_threads);
+        for (uint32_t t = 0; t < _recording_threads; ++t)
+        {
+            VK_CHECK(vkCreateCommandPool(_device, &worker_pool_info, nullptr, &_frames[i].worker_command_pools[t]));
+
+            VkCommandBufferAllocateInfo secondary_alloc_info =
+                vulkan_engine::initialisers::command_buffer_allocate_info(_frames[i].worker_command_pools[t], 1,
+                                                                          VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+            VK_CHECK(vkAllocateCommandBuffers(_device, &secondary_alloc_info, &_frames[i].worker_command_buffers[t]));
+        }
+    }
+
+    // cached command buffers outlive any one frame, so they get a pool of their own
+    if (_config.use_cached_command_buffers)
+    {
+        VK_CHECK(vkCreateCommandPool(_device, &command_pool_info, nullptr, &_cached_command_pool));
+        _cached_command_buffers.resize(_swapchain_images.size());
+
+        // a flashing background would have to be re-recorded every frame
+        _animate_clear_colour = false;
+        std::cout << "Reusing pre-recorded command buffers, press C to toggle the background animation. GPU frame "
+                     "timestamps are not recorded in this mode"
+                  << std::endl;
+    }
+}
+
+void VulkanEngine::init_default_render_pass()
+{
+    VkAttachmentDescription colour_attachment = create_colour_attachment();
+    VkSubpassDescription single_subpass = create_subpass();
+
+    VkRenderPassCreateInfo render_pass_info = {}; // initialise struct to 0's
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 
     // connect the colour attachment to the render pass info
@@ -429,7 +1118,12 @@ void VulkanEngine::init_sync_structures()
     // create the GPU --> CPU fence with the "CREATE_SIGNALED" flag, so that we
     // can wait on it before using it on a GPU command (for the first frame)
     fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    VK_CHECK(vkCreateFence(_device, &fence_info, nullptr, &_render_fence));
+
+    // with timeline semaphores every submission signals the next value on a single semaphore, so no fences are needed
+    if (_timeline_semaphores_enabled)
+    {
+        _graphics_timeline.init(_device);
+    }
 
     // for the semaphores, we don't need much setup
     VkSemaphoreCreateInfo semaphore_info = {}; // initialise structure with 0's
@@ -437,80 +1131,172 @@ void VulkanEngine::init_sync_structures()
     semaphore_info.pNext = nullptr;
     semaphore_info.flags = 0;
 
-    // create presentation semaphore
-    VK_CHECK(vkCreateSemaphore(_device, &semaphore_info, nullptr, &_present_semaphore));
+    for (uint32_t i = 0; i < _frames_in_flight; ++i)
+    {
+        if (!_timeline_semaphores_enabled)
+        {
+            VK_CHECK(vkCreateFence(_device, &fence_info, nullptr, &_frames[i].render_fence));
+        }
+    }
+
+    // create presentation semaphores
+    for (uint32_t i = 0; i < _frames_in_flight + 1; ++i)
+    {
+        VK_CHECK(vkCreateSemaphore(_device, &semaphore_info, nullptr, &_acquire_semaphores[i]));
+    }
 
-    // create rendering semaphore
-    VK_CHECK(vkCreateSemaphore(_device, &semaphore_info, nullptr, &_render_semaphore));
+    init_render_semaphores();
 }
 
-void VulkanEngine::init_pipelines()
+void VulkanEngine::init_render_semaphores()
 {
-    VkShaderModule red_triangle_fragment_shader; // TODO: this is currently leaked
-    if (!load_shader_module("../shaders/triangle.frag.spv", &red_triangle_fragment_shader))
+    VkSemaphoreCreateInfo semaphore_info = {}; // initialise structure with 0's
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    _render_semaphores.resize(_swapchain_images.size());
+    for (VkSemaphore &render_semaphore : _render_semaphores)
     {
-        std::cout << "Error when building the red triangle fragment shader module" << std::endl;
+        VK_CHECK(vkCreateSemaphore(_device, &semaphore_info, nullptr, &render_semaphore));
     }
-    else
+}
+
+void VulkanEngine::init_timestamp_queries()
+{
+    if (!_timestamps_supported)
     {
-        std::cout << "Red triangle fragment shader successfully loaded" << std::endl;
+        std::cout << "GPU timestamps are not supported on the graphics queue, GPU frame cost will not be reported"
+                  << std::endl;
+        return;
     }
 
-    VkShaderModule red_triangle_vertex_shader; // TODO: this is currently leaked
-    if (!load_shader_module("../shaders/triangle.vert.spv", &red_triangle_vertex_shader))
+    // two timestamps per frame, one at the start and one at the end
+    VkQueryPoolCreateInfo query_pool_info = {}; // initialise struct to 0's
+    query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_info.pNext = nullptr;
+    query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_info.queryCount = 2;
+
+    for (uint32_t i = 0; i < _frames_in_flight; ++i)
     {
-        std::cout << "Error when building the red triangle vertex shader module" << std::endl;
+        VK_CHECK(vkCreateQueryPool(_device, &query_pool_info, nullptr, &_frames[i].timestamp_pool));
     }
-    else
+}
+
+void VulkanEngine::init_present_thread()
+{
+    if (!_config.use_present_thread)
+    {
+        return;
+    }
+
+    // we present on the graphics queue, so the present thread shares its lock with our submits
+    _present_thread.init(_device, _graphics_queue, &_graphics_queue_mutex);
+    _present_thread_enabled = true;
+
+    std::cout << "Acquiring and presenting on a dedicated present thread" << std::endl;
+}
+
+void VulkanEngine::init_frame_data()
+{
+    // room for every draw in the draw list (or the bind benchmark's) and then some. Offsets are aligned to at most
+    // 256 bytes, so that is the most a draw can take up
+    constexpr VkDeviceSize MAX_DRAW_DATA_SIZE = std::max<VkDeviceSize>(sizeof(DrawData), 256);
+    constexpr VkDeviceSize EXTRA_FRAME_DATA_SIZE = 64 * 1024;
+    const VkDeviceSize draws = std::max({_config.draw_count, _config.bind_benchmark_draws, 1u});
+    if (!_frame_allocator.init(&_gpu_allocator, _gpu_properties.limits, _frames_in_flight,
+                               draws * MAX_DRAW_DATA_SIZE + EXTRA_FRAME_DATA_SIZE))
     {
-        std::cout << "Red triangle vertex shader successfully loaded" << std::endl;
+        abort();
     }
 
-    VkShaderModule rainbow_triangle_fragment_shader; // TODO: this is currently leaked
-    if (!load_shader_module("../shaders/rainbowTriangle.frag.spv", &rainbow_triangle_fragment_shader))
+    // the descriptor pools are made as their set layouts are reflected, see descriptor_pool()
+}
+
+void VulkanEngine::init_uploads()
+{
+    // big enough that a frame's worth of streaming rarely has to wait for the last one's copies to finish
+    constexpr VkDeviceSize STAGING_BUFFER_SIZE = 64 * 1024 * 1024;
+    if (!_upload_manager.init(_device, &_gpu_allocator, _gpu_properties.limits, _transfer_queue, _transfer_queue_family,
+                              _graphics_queue, _graphics_queue_family, &_graphics_queue_mutex, STAGING_BUFFER_SIZE))
     {
-        std::cout << "Error when building the rainbow triangle fragment shader module" << std::endl;
+        abort();
     }
-    else
+}
+
+void VulkanEngine::init_pipelines()
+{
+    // start-up cost is dominated by pipeline compilation, which a warm cache should mostly skip
+    const auto start = std::chrono::steady_clock::now();
+
+    _pipeline_cache.init(_device, _gpu_properties, _config.pipeline_cache_path);
+    _pipeline_registry.init(_device, _pipeline_cache.cache());
+    _shader_modules.init(_device);
+    _pipeline_layouts.init(_device, _gpu_properties.limits);
+
+    // pick up shaders rebuilt while we are running
+    if (_config.hot_reload_shaders)
     {
-        std::cout << "Rainbow triangle fragment shader successfully loaded" << std::endl;
+        if (_config.use_embedded_shaders || _config.compile_shaders)
+        {
+            std::cout << "Shader hot reload watches the .spv files, loading them from disk" << std::endl;
+            _config.use_embedded_shaders = false;
+            _config.compile_shaders = false;
+        }
+
+        _shader_watcher_enabled = _shader_watcher.init(SHADER_DIRECTORY);
+        if (!_shader_watcher_enabled)
+        {
+            std::cout << "Can't watch " << SHADER_DIRECTORY << " for changes, shader hot reload is off" << std::endl;
+        }
     }
+    std::cout << "Loading shaders from " << (_config.use_embedded_shaders ? "the embedded bundle" : SHADER_DIRECTORY)
+              << std::endl;
 
-    VkShaderModule rainbow_triangle_vertex_shader; // TODO: this is currently leaked
-    if (!load_shader_module("../shaders/rainbowTriangle.vert.spv", &rainbow_triangle_vertex_shader))
+    // background compiles, optimised links of pipeline libraries, rebuilds of reloaded shaders and GLSL compiles share
+    // the worker threads
+    if (_config.use_async_pipelines || _pipeline_libraries_enabled || _shader_watcher_enabled ||
+        _config.compile_shaders)
     {
-        std::cout << "Error when building the rainbow triangle vertex shader module" << std::endl;
+        _compile_pool.init();
     }
-    else
+    if (_pipeline_libraries_enabled)
+    {
+        _pipeline_registry.enable_pipeline_libraries(&_compile_pool);
+    }
+    if (_config.compile_shaders)
     {
-        std::cout << "Rainbow triangle vertex shader successfully loaded" << std::endl;
+        compile_shaders();
     }
 
-    // build the pipeline layout that controls the inputs and outputs of the shader i'm not using descriptor sets or
-    // other systems yet, so no need to use anything other than empty defaults
-    VkPipelineLayoutCreateInfo pipeline_layout_info = vulkan_engine::initialisers::pipeline_layout_create_info();
+    // only the least recently used variants are kept around, but always at least the two we draw with
+    _triangle_permutations.init(&_pipeline_registry, std::max(_config.pipeline_permutation_capacity, 2u));
 
-    VK_CHECK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_triangle_pipeline_layout));
+    if (_shader_objects.is_supported() &&
+        !create_triangle_shader_objects(&_rainbow_triangle_shaders, &_red_triangle_shaders, &_triangle_layout))
+    {
+        std::cout << "Error when creating the triangle shader objects, drawing with pipelines" << std::endl;
+        _shader_objects_enabled = false;
+    }
+
+    // shader objects need no pipelines at all, unless the benchmark wants both to compare
+    if (_shader_objects_enabled && _config.bind_benchmark_draws == 0)
+    {
+        const std::chrono::duration<double, std::milli> build_time = std::chrono::steady_clock::now() - start;
+        std::cout << "Shader objects created in " << build_time.count() << " ms" << std::endl;
+        return;
+    }
 
-    // build the stage creation info for both vertex and fragment stages.
-    // this lets the pipeline know the shader modules per stage
+    // the rainbow and red triangles are the same shaders with different specialisation constants. Build the stage
+    // creation info for both vertex and fragment stages, load_triangle_shaders() fills in their shader modules
     PipelineBuilder pipeline_builder;
 
     // add vertex shader stage
     pipeline_builder.shader_stages.push_back(vulkan_engine::initialisers::pipeline_shader_stage_create_info(
-        VK_SHADER_STAGE_VERTEX_BIT, rainbow_triangle_vertex_shader));
+        VK_SHADER_STAGE_VERTEX_BIT, VK_NULL_HANDLE));
 
     // add fragment shader stage
     pipeline_builder.shader_stages.push_back(vulkan_engine::initialisers::pipeline_shader_stage_create_info(
-        VK_SHADER_STAGE_FRAGMENT_BIT, rainbow_triangle_fragment_shader));
-
-    // vertex input controls how to read vertices from vertex buffers, not using it yet
-    pipeline_builder.vertex_input_info = vulkan_engine::initialisers::vertex_input_state_create_info();
-
-    // input assembly is the configuration for drawing triangle lists, strips or
-    // individual points
-    pipeline_builder.input_assembly =
-        vulkan_engine::initialisers::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        VK_SHADER_STAGE_FRAGMENT_BIT, VK_NULL_HANDLE));
 
     // build viewport and scissor from the swapchain extents
     pipeline_builder.viewport.x = 0.0f;
@@ -523,84 +1309,1604 @@ void VulkanEngine::init_pipelines()
     pipeline_builder.scissor.offset = {0, 0};
     pipeline_builder.scissor.extent = _window_extent;
 
-    // configure the rasteriser to draw full triangles
-    pipeline_builder.rasteriser = vulkan_engine::initialisers::rasterisation_state_create_info(VK_POLYGON_MODE_FILL);
-
     // default multisampling (1 sample per pixel)
     pipeline_builder.multisampling = vulkan_engine::initialisers::multisampling_state_create_info();
 
     // single blend attachment with no blending and writing to RGBA
     pipeline_builder.colour_blend_attachment = vulkan_engine::initialisers::color_blend_attachment_state();
 
-    // triangle layout
-    pipeline_builder.pipeline_layout = _triangle_pipeline_layout;
+    // the builder is kept so variants can be requested whenever the raster state changes. Loading the shaders also
+    // gives it the pipeline layout and vertex input they declare
+    _triangle_builder = pipeline_builder;
+    if (!load_triangle_shaders())
+    {
+        std::cout << "Error when loading the triangle shaders" << std::endl;
+        return;
+    }
+    std::cout << "Triangle shaders successfully loaded" << std::endl;
 
-    // woot, lets build the rainbow triangle pipeline
-    _rainbow_triangle_pipeline = pipeline_builder.build_pipeline(_device, _render_pass);
+    // input assembly (triangle lists, strips or individual points), the rasteriser and depth testing come from the
+    // current raster state, with as much of it as possible left dynamic
+    configure_raster_pipeline(_triangle_builder);
 
-    // now we want to build another pipeline for the static red triangle
-    // first we need to clear the existing shader stages from the other triangle
-    // pipeline
-    pipeline_builder.shader_stages.clear();
+    // woot, lets build the triangle pipelines, with the rainbow one either now or in the background
+    build_triangle_pipelines(_config.use_async_pipelines);
 
-    // add the shaders for the static red triangle
-    pipeline_builder.shader_stages.push_back(vulkan_engine::initialisers::pipeline_shader_stage_create_info(
-        VK_SHADER_STAGE_VERTEX_BIT, red_triangle_vertex_shader));
+    const std::chrono::duration<double, std::milli> build_time = std::chrono::steady_clock::now() - start;
+    std::cout << "Pipelines built in " << build_time.count() << " ms ("
+              << (_pipeline_cache.is_warm() ? "warm" : "cold") << " pipeline cache"
+              << (_rainbow_triangle_request.is_ready() ? "" : ", rainbow triangle still compiling") << ")" << std::endl;
+}
 
-    // add fragment shader stage
-    pipeline_builder.shader_stages.push_back(vulkan_engine::initialisers::pipeline_shader_stage_create_info(
-        VK_SHADER_STAGE_FRAGMENT_BIT, red_triangle_fragment_shader));
+bool VulkanEngine::lay_out_triangle_pipeline(PipelineBuilder &builder)
+{
+    std::vector<const SpirvReflection *> reflections;
+    const SpirvReflection *vertex_reflection = nullptr;
+    for (const VkPipelineShaderStageCreateInfo &stage : builder.shader_stages)
+    {
+        const SpirvReflection *reflection = _shader_modules.reflection(stage.module);
+        if (reflection != nullptr)
+        {
+            reflections.push_back(reflection);
+        }
+        if (stage.stage == VK_SHADER_STAGE_VERTEX_BIT)
+        {
+            vertex_reflection = reflection;
+        }
+    }
+
+    // a stage that couldn't be reflected contributes nothing, which for these shaders means empty defaults
+    builder.pipeline_layout = _pipeline_layouts.get_or_create(reflections);
+    if (builder.pipeline_layout == VK_NULL_HANDLE)
+    {
+        return false;
+    }
 
-    // build the static red triangle pipeline
-    _red_triangle_pipeline = pipeline_builder.build_pipeline(_device, _render_pass);
+    // the vertex input points into the module cache, where it only stays while the modules are held
+    builder.vertex_input_info = vertex_reflection != nullptr
+                                    ? vertex_reflection->vertex_input_info()
+                                    : vulkan_engine::initialisers::vertex_input_state_create_info();
+    return true;
 }
 
-bool VulkanEngine::load_shader_module(const char *filePath, VkShaderModule *outShaderModule)
+bool VulkanEngine::load_triangle_shaders()
 {
-    // open the shader file with the cursor at the end (ios::ate) and in binary
-    // mode (ios::binary)
-    std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+    // through the module cache, so while a background build still holds the modules this hands back the same ones
+    VkShaderModule vertex_shader = VK_NULL_HANDLE;
+    VkShaderModule fragment_shader = VK_NULL_HANDLE;
+    if (!load_shader_module(TRIANGLE_VERTEX_SHADER, &vertex_shader) ||
+        !load_shader_module(TRIANGLE_FRAGMENT_SHADER, &fragment_shader))
+    {
+        for (VkShaderModule shader_module : {vertex_shader, fragment_shader})
+        {
+            if (shader_module != VK_NULL_HANDLE)
+            {
+                _shader_modules.release(shader_module);
+            }
+        }
+        return false;
+    }
 
-    if (!file.is_open())
+    // the pipelines are keyed on the modules' code rather than their handles, so the registry still finds them once
+    // the modules have been destroyed and loaded again
+    PipelineBuilder builder = _triangle_builder;
+    builder.shader_code_keys.clear();
+    for (VkPipelineShaderStageCreateInfo &stage : builder.shader_stages)
+    {
+        stage.module = stage.stage == VK_SHADER_STAGE_VERTEX_BIT ? vertex_shader : fragment_shader;
+        builder.shader_code_keys.push_back(_shader_modules.code_key(stage.module));
+    }
+
+    // the shaders may have changed on disk since they were last loaded, e.g. with a uniform buffer they didn't use.
+    // They are laid out on a copy of the builder, so any that can't be leave the current ones in place
+    if (!lay_out_triangle_pipeline(builder))
     {
+        _shader_modules.release(vertex_shader);
+        _shader_modules.release(fragment_shader);
         return false;
     }
 
-    // determine the file size by looking at the location of the cursor. Because
-    // the cursor is at the end of the file, we get the size directly in bytes
-    auto file_size = (size_t)file.tellg();
+    release_triangle_shaders();
+    _triangle_vertex_shader = vertex_shader;
+    _triangle_fragment_shader = fragment_shader;
+    _triangle_builder = builder;
+    return true;
+}
 
-    // spirv expects the bugger to be in uint32, so we need to make sure to
-    // reserve an int vector big enough for the entire shader file
-    std::vector<uint32_t> buffer(file_size / sizeof(uint32_t));
+void VulkanEngine::release_triangle_shaders()
+{
+    for (VkShaderModule *shader_module : {&_triangle_vertex_shader, &_triangle_fragment_shader})
+    {
+        if (*shader_module != VK_NULL_HANDLE)
+        {
+            _shader_modules.release(*shader_module);
+            *shader_module = VK_NULL_HANDLE;
+        }
+    }
+}
 
-    // reset cursor to beginning of file
-    file.seekg(0);
+PipelineHandle VulkanEngine::build_triangle_async(const SpecialisationValues &values, std::string *outKey /*= nullptr*/)
+{
+    // the build copies the builder, so it takes references of its own to the modules that copy points at
+    PendingPipelineBuild build;
+    for (const VkPipelineShaderStageCreateInfo &stage : _triangle_builder.shader_stages)
+    {
+        _shader_modules.acquire(stage.module);
+        build.shader_modules.push_back(stage.module);
+    }
+    build.handle = _triangle_permutations.build_async(_triangle_builder, _render_pass, values, _compile_pool, outKey);
 
-    // load the entire file into the buffer
-    file.read((char *)buffer.data(), file_size);
+    _pending_builds.push_back(std::move(build));
+    return _pending_builds.back().handle;
+}
 
-    // now that the file is loaded into the buffer, we can close it like the tidy
-    // kiwi I am ;)
-    file.close();
+void VulkanEngine::release_finished_builds()
+{
+    // the module cache isn't synchronised, so builds finishing on the workers leave their references to us
+    const auto finished = std::partition(_pending_builds.begin(), _pending_builds.end(),
+                                         [](const PendingPipelineBuild &build) { return !build.handle.is_ready(); });
+    for (auto build = finished; build != _pending_builds.end(); ++build)
+    {
+        for (VkShaderModule shader_module : build->shader_modules)
+        {
+            _shader_modules.release(shader_module);
+        }
+    }
+    _pending_builds.erase(finished, _pending_builds.end());
+}
+
+void VulkanEngine::compile_shaders()
+{
+    if (!_shader_compiler.init(GLSL_COMPILER, _config.shader_cache_path, {SHADER_DIRECTORY}, &_compile_pool))
+    {
+        std::cout << "Can't compile shaders, loading the prebuilt ones instead" << std::endl;
+        return;
+    }
 
-    // create a new shader module, using the above buffer
-    VkShaderModuleCreateInfo create_info = {}; // initialise struct with 0's
-    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    create_info.pNext = nullptr;
+    // the sources sit next to their prebuilt SPIR-V, e.g. triangle.vert for triangle.vert.spv
+    std::vector<std::pair<const char *, std::future<CompiledShader>>> compiles;
+    for (const char *shader_name : {TRIANGLE_VERTEX_SHADER, TRIANGLE_FRAGMENT_SHADER})
+    {
+        std::string source_path = shader_path(shader_name);
+        source_path.erase(source_path.size() - std::strlen(".spv"));
+        compiles.emplace_back(shader_name, _shader_compiler.compile_async({source_path, {}}));
+    }
+
+    for (auto &[shader_name, compile] : compiles)
+    {
+        CompiledShader compiled = compile.get();
+        if (!compiled.success)
+        {
+            std::cout << "Failed to compile " << shader_name << ", loading the prebuilt one instead:\n"
+                      << compiled.log << std::endl;
+            continue;
+        }
+        _compiled_shaders[shader_name] = std::move(compiled.code);
+    }
+
+    std::cout << "Shaders compiled from GLSL: " << _shader_compiler.compiles() << " compiled, "
+              << _shader_compiler.cache_hits() << " from the shader cache" << std::endl;
+}
 
-    // codeSize has to be in bytes
-    create_info.codeSize = buffer.size() * sizeof(uint32_t);
-    create_info.pCode = buffer.data();
+bool VulkanEngine::create_triangle_shader_objects(GraphicsShaders *outRainbowShaders, GraphicsShaders *outRedShaders,
+                                                  VkPipelineLayout *outLayout)
+{
+    std::vector<uint32_t> vertex_code;
+    std::vector<uint32_t> fragment_code;
+    for (auto [shader_name, code] : {std::pair(TRIANGLE_VERTEX_SHADER, &vertex_code),
+                                     std::pair(TRIANGLE_FRAGMENT_SHADER, &fragment_code)})
+    {
+        MappedFile file;
+        std::vector<uint32_t> buffer;
+        const uint32_t *shader_code;
+        size_t shader_size;
+        if (!find_shader(shader_name, &file, &buffer, &shader_code, &shader_size))
+        {
+            return false;
+        }
+        code->assign(shader_code, shader_code + shader_size / sizeof(uint32_t));
+    }
 
-    // confirm creation goes well
-    VkShaderModule shader_module;
-    if (vkCreateShaderModule(_device, &create_info, nullptr, &shader_module) != VK_SUCCESS)
+    // shader objects are created with the set layouts themselves, and their descriptor sets are bound through the
+    // pipeline layout made from the same ones
+    SpirvReflection reflections[2];
+    std::vector<const SpirvReflection *> stages;
+    if (reflect_spirv(vertex_code.data(), vertex_code.size() * sizeof(uint32_t), &reflections[0]))
+    {
+        stages.push_back(&reflections[0]);
+    }
+    if (reflect_spirv(fragment_code.data(), fragment_code.size() * sizeof(uint32_t), &reflections[1]))
+    {
+        stages.push_back(&reflections[1]);
+    }
+    const VkPipelineLayout layout = _pipeline_layouts.get_or_create(stages);
+    if (layout == VK_NULL_HANDLE)
+    {
+        return false;
+    }
+    const std::vector<VkDescriptorSetLayout> &set_layouts = _pipeline_layouts.set_layouts(layout);
+
+    // the same specialisation constants as the pipelines use for the rainbow and red triangles
+    const Specialisation rainbow_specialisation(RAINBOW_TRIANGLE_CONSTANTS);
+    const Specialisation red_specialisation(RED_TRIANGLE_CONSTANTS);
+    if (!_shader_objects.create_graphics_shaders(_device, vertex_code, fragment_code, rainbow_specialisation.info(),
+                                                 set_layouts, outRainbowShaders) ||
+        !_shader_objects.create_graphics_shaders(_device, vertex_code, fragment_code, red_specialisation.info(),
+                                                 set_layouts, outRedShaders))
     {
         return false;
     }
 
-    *outShaderModule = shader_module;
+    *outLayout = layout;
     return true;
-};
+}
+
+void VulkanEngine::run_bind_benchmark()
+{
+    if (_red_triangle_shaders.vertex == VK_NULL_HANDLE)
+    {
+        std::cout << "Skipping the bind benchmark, shader objects are not available on this device" << std::endl;
+        return;
+    }
+
+    if (_triangle_vertex_shader == VK_NULL_HANDLE)
+    {
+        std::cout << "Skipping the bind benchmark, the triangle shaders failed to load" << std::endl;
+        return;
+    }
+
+    // both paths alternate between the two triangle variants, so every draw needs a bind. A rainbow triangle still
+    // compiling in the background is waited for, rather than letting the red one stand in for it
+    const VkPipeline pipelines[2] = {
+        _triangle_permutations.get_or_build(_triangle_builder, _render_pass, RAINBOW_TRIANGLE_CONSTANTS),
+        _triangle_permutations.get_or_build(_triangle_builder, _render_pass, RED_TRIANGLE_CONSTANTS)};
+    const GraphicsShaders shaders[2] = {_rainbow_triangle_shaders, _red_triangle_shaders};
+
+    // the command buffer is only recorded and never submitted, so this measures the CPU side of binding and drawing
+    VkCommandPoolCreateInfo command_pool_info =
+        vulkan_engine::initialisers::command_pool_create_info(_graphics_queue_family);
+    VkCommandPool command_pool;
+    VK_CHECK(vkCreateCommandPool(_device, &command_pool_info, nullptr, &command_pool));
+
+    VkCommandBufferAllocateInfo command_alloc_info =
+        vulkan_engine::initialisers::command_buffer_allocate_info(command_pool, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    VkCommandBuffer command_buffer;
+    VK_CHECK(vkAllocateCommandBuffers(_device, &command_alloc_info, &command_buffer));
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {}; // initialise structure to 0's
+    command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    command_buffer_begin_info.pNext = nullptr;
+    command_buffer_begin_info.pInheritanceInfo = nullptr;
+    command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    // the same draw list for each path, recorded through the same code that records frames
+    const bool shader_objects_enabled = _shader_objects_enabled;
+    const VkClearValue clear_value = {};
+    const VkDescriptorSet data_set = frame_data_set(_triangle_layout);
+    std::vector<DrawCommand> draw_lists[2];
+    for (int path = 0; path < 2; ++path)
+    {
+        for (uint32_t i = 0; i < _config.bind_benchmark_draws; ++i)
+        {
+            const uint32_t variant = i % 2;
+            draw_lists[path].push_back(path == 1 ? DrawCommand{VK_NULL_HANDLE, 3, 0, shaders[variant].vertex,
+                                                               shaders[variant].fragment}
+                                                 : DrawCommand{pipelines[variant], 3, 0});
+            draw_lists[path].back().layout = _triangle_layout;
+            draw_lists[path].back().data_set = data_set;
+        }
+    }
+
+    const auto record = [&](int path) {
+        _shader_objects_enabled = path == 1;
+        _draw_list = draw_lists[path];
+
+        // nothing has been submitted yet, so each recording can have the first frame's data to itself
+        _frame_allocator.begin_frame(0);
+        VK_CHECK(vkResetCommandPool(_device, command_pool, 0));
+
+        const auto start = std::chrono::steady_clock::now();
+        VK_CHECK(vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info));
+        record_render_pass(command_buffer, 0, clear_value, nullptr);
+        VK_CHECK(vkEndCommandBuffer(command_buffer));
+        const std::chrono::duration<double, std::milli> record_time = std::chrono::steady_clock::now() - start;
+        return record_time.count();
+    };
+
+    // an untimed pass of each first, so neither pays for cold caches and first-use driver work. Then the fastest of a
+    // few passes each, taking turns to go first so neither gains from the order
+    constexpr int PASSES = 5;
+    record(0);
+    record(1);
+
+    double record_ms[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    for (int pass = 0; pass < PASSES; ++pass)
+    {
+        for (int turn = 0; turn < 2; ++turn)
+        {
+            const int path = (pass + turn) % 2;
+            record_ms[path] = std::min(record_ms[path], record(path));
+        }
+    }
+
+    vkDestroyCommandPool(_device, command_pool, nullptr);
+
+    // back to drawing the way we were before
+    _shader_objects_enabled = shader_objects_enabled;
+    build_draw_list();
+
+    const double draws = _config.bind_benchmark_draws;
+    std::cout << "Bind benchmark, " << _config.bind_benchmark_draws
+              << " draws alternating between two variants: pipelines " << record_ms[0] * 1000.0 / draws
+              << " us, shader objects " << record_ms[1] * 1000.0 / draws << " us per bind + draw (" << record_ms[0]
+              << " ms vs " << record_ms[1] << " ms to record, best of " << PASSES << ")" << std::endl;
+}
+
+void VulkanEngine::run_shader_load_benchmark()
+{
+    std::vector<std::string> file_paths;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(_config.shader_load_benchmark_path, error))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".spv")
+        {
+            file_paths.push_back(entry.path().string());
+        }
+    }
+
+    if (file_paths.empty())
+    {
+        std::cout << "Skipping the shader load benchmark, no .spv files in " << _config.shader_load_benchmark_path
+                  << std::endl;
+        return;
+    }
+
+    // load every file and create a module from it the way load_shader_module does: checked, then hashed and created
+    // through the module cache. Each module is released straight away, so every pass misses the cache (unless
+    // something else still holds the module) rather than all but the first being hits
+    const auto load_all = [this, &file_paths](bool mapped, size_t *outBytes) {
+        size_t bytes = 0;
+        for (const std::string &file_path : file_paths)
+        {
+            std::vector<uint32_t> buffer;
+            MappedFile file;
+            const uint32_t *code = nullptr;
+            size_t code_size = 0;
+            if (mapped)
+            {
+                if (!map_spirv(file_path.c_str(), &file))
+                {
+                    continue;
+                }
+                code = static_cast<const uint32_t *>(file.data());
+                code_size = file.size();
+            }
+            else
+            {
+                // map_spirv checks the code before handing it over, so this path has to as well
+                std::string reason;
+                if (!load_spirv(file_path.c_str(), &buffer) ||
+                    !is_valid_spirv(buffer.data(), buffer.size() * sizeof(uint32_t), &reason))
+                {
+                    continue;
+                }
+                code = buffer.data();
+                code_size = buffer.size() * sizeof(uint32_t);
+            }
+
+            VkShaderModule shader_module;
+            if (_shader_modules.acquire(code, code_size, &shader_module))
+            {
+                _shader_modules.release(shader_module);
+                bytes += code_size;
+            }
+        }
+
+        *outBytes = bytes;
+    };
+
+    // an untimed pass first, so both paths read from a warm page cache rather than whichever goes first paying for
+    // the disk. Then the fastest of a few passes each, to keep scheduling noise out of it
+    constexpr int PASSES = 3;
+    size_t bytes = 0;
+    load_all(true, &bytes);
+
+    double best_ms[2] = {0.0, 0.0};
+    for (int pass = 0; pass < PASSES; ++pass)
+    {
+        for (int mapped = 0; mapped < 2; ++mapped)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            load_all(mapped == 1, &bytes);
+            const std::chrono::duration<double, std::milli> load_time = std::chrono::steady_clock::now() - start;
+            if (pass == 0 || load_time.count() < best_ms[mapped])
+            {
+                best_ms[mapped] = load_time.count();
+            }
+        }
+    }
+
+    const double files = static_cast<double>(file_paths.size());
+    std::cout << "Shader load benchmark, " << file_paths.size() << " files (" << bytes / 1024
+              << " KiB): reading into a buffer " << best_ms[0] << " ms (" << best_ms[0] * 1000.0 / files
+              << " us per shader), mapping " << best_ms[1] << " ms (" << best_ms[1] * 1000.0 / files
+              << " us per shader)" << std::endl;
+}
+
+void VulkanEngine::run_allocation_benchmark()
+{
+    // sizes typical of a mesh's vertices and indices and of per-object uniforms
+    constexpr VkDeviceSize VERTEX_BUFFER_SIZE = 64 * 1024;
+    constexpr VkDeviceSize UNIFORM_BUFFER_SIZE = 256;
+
+    VkBufferCreateInfo vertex_buffer_info = {}; // initialise struct to 0's
+    vertex_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    vertex_buffer_info.size = VERTEX_BUFFER_SIZE;
+    vertex_buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    vertex_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBufferCreateInfo uniform_buffer_info = vertex_buffer_info;
+    uniform_buffer_info.size = UNIFORM_BUFFER_SIZE;
+    uniform_buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+
+    const uint32_t memory_before = _gpu_allocator.device_memory_count();
+    std::vector<AllocatedBuffer> buffers;
+    buffers.reserve(_config.allocation_benchmark_buffers * 2);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < _config.allocation_benchmark_buffers; ++i)
+    {
+        AllocatedBuffer buffer;
+        if (_gpu_allocator.create_buffer(vertex_buffer_info, MemoryPool::vertex_index, &buffer))
+        {
+            buffers.push_back(buffer);
+        }
+        if (_gpu_allocator.create_buffer(uniform_buffer_info, MemoryPool::uniform, &buffer))
+        {
+            buffers.push_back(buffer);
+        }
+    }
+    const std::chrono::duration<double, std::milli> create_time = std::chrono::steady_clock::now() - start;
+    const uint32_t memory_used = _gpu_allocator.device_memory_count() - memory_before;
+
+    for (const AllocatedBuffer &buffer : buffers)
+    {
+        _gpu_allocator.destroy_buffer(buffer);
+    }
+
+    std::cout << "Allocation benchmark, " << buffers.size() << " buffers in " << memory_used
+              << " device memory allocations, " << create_time.count() << " ms ("
+              << create_time.count() * 1000.0 / std::max<size_t>(buffers.size(), 1) << " us per buffer)"
+              << std::endl;
+}
+
+void VulkanEngine::run_upload_benchmark()
+{
+    // the buffer is as big as the staging ring, so the pieces in one submission never overlap. A handful of images
+    // go in each submission, the way a frame's worth of textures might. There are images for two submissions, so one
+    // can be copied into while the other's copies and ownership transfer finish
+    constexpr VkDeviceSize PIECE_SIZE = 64 * 1024;
+    constexpr VkDeviceSize BUFFER_SIZE = 64 * 1024 * 1024;
+    constexpr uint32_t IMAGE_SIZE = 1024;
+    constexpr uint32_t IMAGES_PER_SUBMIT = 4;
+    constexpr uint32_t IMAGE_COUNT = 2 * IMAGES_PER_SUBMIT;
+    const VkDeviceSize total_size = static_cast<VkDeviceSize>(_config.upload_benchmark_mib) * 1024 * 1024;
+
+    VkBufferCreateInfo buffer_info = {}; // initialise struct to 0's
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = BUFFER_SIZE;
+    buffer_info.usage =
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkImageCreateInfo image_info = {}; // initialise struct to 0's
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    image_info.extent = {IMAGE_SIZE, IMAGE_SIZE, 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    AllocatedBuffer buffer;
+    AllocatedImage images[IMAGE_COUNT];
+    bool created = _gpu_allocator.create_buffer(buffer_info, MemoryPool::vertex_index, &buffer);
+    for (AllocatedImage &image : images)
+    {
+        created = created && _gpu_allocator.create_image(image_info, MemoryPool::render_target, &image);
+    }
+    if (!created)
+    {
+        std::cout << "Skipping the upload benchmark, its buffer and images couldn't be created" << std::endl;
+        _gpu_allocator.destroy_buffer(buffer);
+        for (const AllocatedImage &image : images)
+        {
+            _gpu_allocator.destroy_image(image);
+        }
+        return;
+    }
+
+    const VkDeviceSize image_bytes = static_cast<VkDeviceSize>(IMAGE_SIZE) * IMAGE_SIZE * 4;
+    const std::vector<char> data(image_bytes, 0x7f);
+
+    // time from the first upload until the last copy has finished on the GPU. Submissions retire in order, so the
+    // last upload's future stands for all of them
+    const auto time_uploads = [this](const auto &uploadAll, uint64_t *outSubmissions) {
+        const uint64_t submissions_before = _upload_manager.batches_submitted();
+        const auto start = std::chrono::steady_clock::now();
+        std::future<void> last = uploadAll();
+        _upload_manager.submit();
+        if (last.valid())
+        {
+            last.wait();
+        }
+        const std::chrono::duration<double> upload_time = std::chrono::steady_clock::now() - start;
+        *outSubmissions = _upload_manager.batches_submitted() - submissions_before;
+        return upload_time.count();
+    };
+
+    uint64_t buffer_submissions;
+    const double buffer_seconds = time_uploads(
+        [&]() {
+            std::future<void> last;
+            for (VkDeviceSize uploaded = 0; uploaded < total_size; uploaded += PIECE_SIZE)
+            {
+                // a destination must not be uploaded into while earlier copies into it may still be running, so each
+                // pass over the buffer waits for the one before
+                if (uploaded > 0 && uploaded % BUFFER_SIZE == 0)
+                {
+                    _upload_manager.submit();
+                    last.wait();
+                }
+                last = _upload_manager.upload_buffer(buffer.buffer, uploaded % BUFFER_SIZE, data.data(), PIECE_SIZE);
+            }
+            return last;
+        },
+        &buffer_submissions);
+
+    uint64_t image_submissions;
+    const uint64_t image_count = std::max<uint64_t>(total_size / image_bytes, 1);
+    const double image_seconds = time_uploads(
+        [&]() {
+            // an image's last upload has been submitted by the time it comes round again, so it can be waited for
+            std::future<void> pending[IMAGE_COUNT];
+            for (uint64_t i = 0; i < image_count; ++i)
+            {
+                std::future<void> &previous = pending[i % IMAGE_COUNT];
+                if (previous.valid())
+                {
+                    previous.wait();
+                }
+                previous = _upload_manager.upload_image(images[i % IMAGE_COUNT].image, image_info.extent,
+                                                        VK_IMAGE_ASPECT_COLOR_BIT, data.data(), image_bytes,
+                                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                if ((i + 1) % IMAGES_PER_SUBMIT == 0)
+                {
+                    _upload_manager.submit();
+                }
+            }
+            return std::move(pending[(image_count - 1) % IMAGE_COUNT]);
+        },
+        &image_submissions);
+
+    _gpu_allocator.destroy_buffer(buffer);
+    for (const AllocatedImage &image : images)
+    {
+        _gpu_allocator.destroy_image(image);
+    }
+
+    const double buffer_mb = static_cast<double>(total_size) / 1e6;
+    const double image_mb = static_cast<double>(image_count * image_bytes) / 1e6;
+    std::cout << "Upload benchmark: " << buffer_mb << " MB as " << PIECE_SIZE / 1024 << " KiB buffer pieces at "
+              << buffer_mb / buffer_seconds << " MB/s (" << buffer_submissions << " submissions), " << image_mb
+              << " MB as " << IMAGE_SIZE << "x" << IMAGE_SIZE << " images at " << image_mb / image_seconds
+              << " MB/s (" << image_submissions << " submissions)" << std::endl;
+}
+
+void VulkanEngine::configure_raster_pipeline(PipelineBuilder &builder)
+{
+    // keep track of the fully baked pipelines (one per triangle variant) this state would need without dynamic state,
+    // to see how far the permutations collapse
+    for (const SpecialisationValues *values : {&RAINBOW_TRIANGLE_CONSTANTS, &RED_TRIANGLE_CONSTANTS})
+    {
+        const Specialisation specialisation(*values);
+        PipelineBuilder baked_builder = builder;
+        ExtendedDynamicState::bake_pipeline_state(baked_builder, _raster_state);
+        baked_builder.set_specialisation(specialisation.info());
+        _raster_permutations.insert(baked_builder.state_key(_render_pass));
+    }
+
+    _extended_dynamic_state.configure_pipeline(builder, _raster_state);
+}
+
+bool VulkanEngine::build_triangle_pipelines(bool rainbowInBackground)
+{
+    PipelineHandle rainbow_request;
+    VkPipeline rainbow_pipeline;
+    VkPipeline red_pipeline;
+    if (rainbowInBackground)
+    {
+        // the red triangle stands in for the rainbow one until it is ready
+        rainbow_request = build_triangle_async(RAINBOW_TRIANGLE_CONSTANTS);
+        red_pipeline = _triangle_permutations.get_or_build(_triangle_builder, _render_pass, RED_TRIANGLE_CONSTANTS);
+        rainbow_pipeline = rainbow_request.get_or(red_pipeline);
+    }
+    else
+    {
+        // hand both variants to the driver in one call
+        const std::vector<VkPipeline> pipelines = _triangle_permutations.get_or_build_all(
+            _triangle_builder, _render_pass, {RAINBOW_TRIANGLE_CONSTANTS, RED_TRIANGLE_CONSTANTS});
+        rainbow_pipeline = pipelines[0];
+        red_pipeline = pipelines[1];
+    }
+
+    // variants that went cold may still be used by frames in flight (or cached command buffers, which are retired
+    // with the frame that last used them). The ones we draw with are held on to if there is nothing to replace them
+    const bool built = rainbow_pipeline != VK_NULL_HANDLE && red_pipeline != VK_NULL_HANDLE;
+    for (VkPipeline pipeline : _triangle_permutations.take_evicted())
+    {
+        if (!built && (pipeline == _rainbow_triangle_pipeline || pipeline == _red_triangle_pipeline))
+        {
+            _reload_retired_pipelines.push_back(pipeline);
+            continue;
+        }
+
+        _deletion_queue.push(_frame_number, [device = _device, pipeline]() {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        });
+    }
+
+    // a shader that fails to compile or link leaves us drawing with the pipelines we already have
+    if (!built)
+    {
+        std::cout << "Error when building the triangle pipelines, keeping the old ones" << std::endl;
+        return false;
+    }
+
+    _rainbow_triangle_request = rainbow_request;
+    _rainbow_triangle_pipeline = rainbow_pipeline;
+    _red_triangle_pipeline = red_pipeline;
+    _triangle_layout = _triangle_builder.pipeline_layout;
+
+    // pipelines held on to after being evicted aren't drawn with anymore, beyond the frames in flight
+    for (VkPipeline pipeline : _reload_retired_pipelines)
+    {
+        _deletion_queue.push(_frame_number, [device = _device, pipeline]() {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        });
+    }
+    _reload_retired_pipelines.clear();
+    return true;
+}
+
+void VulkanEngine::rebuild_triangle_pipelines()
+{
+    // with extended dynamic state these are usually registry hits, returning the pipelines we already have. A
+    // rainbow triangle still compiling in the background is asked for again in the new state instead. The shaders
+    // are the ones already held, they are only loaded again when they change on disk
+    if (_triangle_vertex_shader == VK_NULL_HANDLE)
+    {
+        std::cout << "The triangle shaders aren't loaded, keeping the pipelines we have" << std::endl;
+        return;
+    }
+
+    configure_raster_pipeline(_triangle_builder);
+    build_triangle_pipelines(_rainbow_triangle_request.valid());
+}
+
+void VulkanEngine::update_raster_pipelines()
+{
+    // shader objects take all of the raster state while recording, so they have nothing to build
+    if (!_shader_objects_enabled)
+    {
+        rebuild_triangle_pipelines();
+    }
+
+    // the draw list (and any cached command buffers) hold the pipelines and the raster state they were recorded with
+    build_draw_list();
+
+    std::cout << "Raster state: " << (_raster_state.polygon_mode == VK_POLYGON_MODE_LINE ? "wireframe" : "filled")
+              << ", cull " << (_raster_state.cull_mode == VK_CULL_MODE_BACK_BIT    ? "back"
+                               : _raster_state.cull_mode == VK_CULL_MODE_FRONT_BIT ? "front"
+                                                                                    : "none")
+              << ", front face " << (_raster_state.front_face == VK_FRONT_FACE_CLOCKWISE ? "CW" : "CCW") << " | ";
+    if (_shader_objects_enabled)
+    {
+        std::cout << "set on the command buffer for shader objects" << std::endl;
+    }
+    else
+    {
+        std::cout << _raster_permutations.size() << " pipeline permutations served by "
+                  << _pipeline_registry.pipeline_count() << " pipelines (" << _triangle_permutations.evictions()
+                  << " evicted)" << std::endl;
+    }
+}
+
+void VulkanEngine::poll_shader_reloads()
+{
+    // the triangle pipelines are the only ones built from shader files, so a change to any other file is just
+    // reported. Once more materials are built from them, this wants a map from each file to the builders using it
+    bool triangle_changed = false;
+    for (const std::string &file_name : _shader_watcher.take_changes())
+    {
+        std::cout << "Shader " << file_name << " changed on disk" << std::endl;
+        triangle_changed = triangle_changed || file_name == TRIANGLE_VERTEX_SHADER ||
+                           file_name == TRIANGLE_FRAGMENT_SHADER;
+    }
+
+    if (triangle_changed)
+    {
+        reload_triangle_shaders();
+    }
+
+    // swap the rebuilt pipelines in at the start of a frame, once both of them are ready
+    if (_rainbow_reload_request.valid() && _rainbow_reload_request.is_ready() && _red_reload_request.is_ready())
+    {
+        const bool rebuilt = _rainbow_reload_request.get_or(VK_NULL_HANDLE) != VK_NULL_HANDLE &&
+                             _red_reload_request.get_or(VK_NULL_HANDLE) != VK_NULL_HANDLE;
+        _rainbow_reload_request = {};
+        _red_reload_request = {};
+
+        // the registry has them now, so unless the raster state changed in the meantime this is just a lookup. Frames
+        // in flight (or cached command buffers, which are retired with the frame that last used them) may still be
+        // drawing with the old pipelines, so they are destroyed through the deletion queue
+        const bool swapped = rebuilt && build_triangle_pipelines(false);
+        if (!swapped)
+        {
+            // e.g. the new shader doesn't compile or link. The old pipelines and draw list stay as they are
+            std::cout << "Error when rebuilding the triangle pipelines with the new shaders, keeping the old ones"
+                      << std::endl;
+            discard_reloaded_pipelines();
+            return;
+        }
+
+        build_draw_list();
+        _reload_trim_pending = true;
+
+        std::cout << "Triangle pipelines rebuilt with the new shaders" << std::endl;
+    }
+
+    // anything else built from the old shaders is stale, so only the two variants just swapped in are kept. Variants
+    // still compiling from the old shaders have to finish first
+    if (_reload_trim_pending && !_rainbow_reload_request.valid())
+    {
+        const bool trimmed = _triangle_permutations.trim(2);
+        for (VkPipeline pipeline : _triangle_permutations.take_evicted())
+        {
+            _deletion_queue.push(_frame_number, [device = _device, pipeline]() {
+                vkDestroyPipeline(device, pipeline, nullptr);
+            });
+        }
+
+        _reload_trim_pending = !trimmed;
+    }
+}
+
+void VulkanEngine::discard_reloaded_pipelines()
+{
+    // both builds have finished, so neither variant can still be compiling. A build that failed left nothing behind
+    for (const std::string *key : {&_rainbow_reload_key, &_red_reload_key})
+    {
+        VkPipeline pipeline;
+        _triangle_permutations.remove(*key, &pipeline);
+        if (pipeline != VK_NULL_HANDLE)
+        {
+            _deletion_queue.push(_frame_number, [device = _device, pipeline]() {
+                vkDestroyPipeline(device, pipeline, nullptr);
+            });
+        }
+    }
+}
+
+void VulkanEngine::reload_triangle_shaders()
+{
+    // shader objects are cheap to create, so they are simply replaced
+    if (_shader_objects_enabled)
+    {
+        GraphicsShaders rainbow_shaders;
+        GraphicsShaders red_shaders;
+        VkPipelineLayout layout;
+        if (!create_triangle_shader_objects(&rainbow_shaders, &red_shaders, &layout))
+        {
+            std::cout << "Error when reloading the triangle shader objects, keeping the old ones" << std::endl;
+            _shader_objects.destroy_graphics_shaders(_device, rainbow_shaders);
+            _shader_objects.destroy_graphics_shaders(_device, red_shaders);
+            return;
+        }
+
+        // frames in flight (or cached command buffers) may still be drawing with the old ones
+        for (const GraphicsShaders &shaders : {_rainbow_triangle_shaders, _red_triangle_shaders})
+        {
+            _deletion_queue.push(_frame_number, [this, shaders]() {
+                _shader_objects.destroy_graphics_shaders(_device, shaders);
+            });
+        }
+
+        _rainbow_triangle_shaders = rainbow_shaders;
+        _red_triangle_shaders = red_shaders;
+        _triangle_layout = layout;
+        build_draw_list();
+
+        std::cout << "Triangle shader objects reloaded" << std::endl;
+        return;
+    }
+
+    // loading replaces the modules we hold, and releases the old ones, which go once nothing is building from them
+    const std::vector<ShaderCodeKey> old_code_keys = _triangle_builder.shader_code_keys;
+    if (!load_triangle_shaders())
+    {
+        // most likely the compiler is still writing the file, and it will be reloaded again when it is done
+        std::cout << "Error when reloading the triangle shaders, keeping the old ones" << std::endl;
+        return;
+    }
+
+    if (_triangle_builder.shader_code_keys == old_code_keys)
+    {
+        std::cout << "Triangle shaders are unchanged" << std::endl;
+        return;
+    }
+
+    // a rainbow triangle still compiling from the old shaders would swap them back in once it finished
+    _rainbow_triangle_request = {};
+
+    // everything keeps drawing with the old pipelines until both new ones are ready. Those may well be the coldest
+    // variants now, so if they are evicted they are held on to until the swap
+    _rainbow_reload_request = build_triangle_async(RAINBOW_TRIANGLE_CONSTANTS, &_rainbow_reload_key);
+    _red_reload_request = build_triangle_async(RED_TRIANGLE_CONSTANTS, &_red_reload_key);
+    for (VkPipeline pipeline : _triangle_permutations.take_evicted())
+    {
+        _reload_retired_pipelines.push_back(pipeline);
+    }
+
+    std::cout << "Triangle shaders changed, rebuilding their pipelines in the background" << std::endl;
+}
+
+void VulkanEngine::poll_async_pipelines()
+{
+    bool pipelines_changed = false;
+    if (_rainbow_triangle_request.valid() && _rainbow_triangle_request.is_ready())
+    {
+        _rainbow_triangle_pipeline = _rainbow_triangle_request.get_or(_red_triangle_pipeline);
+        _rainbow_triangle_request = {};
+        pipelines_changed = true;
+
+        std::cout << "Rainbow triangle pipeline finished compiling in the background" << std::endl;
+    }
+
+    // swap fast linked pipelines for their optimised links as those finish
+    for (const PipelineUpgrade &upgrade : _pipeline_registry.take_upgrades())
+    {
+        for (VkPipeline *pipeline : {&_rainbow_triangle_pipeline, &_red_triangle_pipeline})
+        {
+            if (*pipeline == upgrade.old_pipeline && upgrade.new_pipeline != VK_NULL_HANDLE)
+            {
+                *pipeline = upgrade.new_pipeline;
+                pipelines_changed = true;
+            }
+        }
+
+        // frames in flight (or cached command buffers, which are retired with the frame that last used them) may
+        // still be drawing with it
+        _deletion_queue.push(_frame_number, [device = _device, pipeline = upgrade.old_pipeline]() {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        });
+    }
+
+    // the draw list (and any cached command buffers) still reference the old pipelines
+    if (pipelines_changed)
+    {
+        build_draw_list();
+    }
+}
+
+void VulkanEngine::build_draw_list()
+{
+    const uint32_t draw_count = std::max(_config.draw_count, 1u);
+    if (_shader_objects_enabled)
+    {
+        const GraphicsShaders &shaders = _selected_shader == 0 ? _rainbow_triangle_shaders : _red_triangle_shaders;
+        _draw_list.assign(draw_count, DrawCommand{VK_NULL_HANDLE, 3, 0, shaders.vertex, shaders.fragment});
+    }
+    else
+    {
+        VkPipeline pipeline = _selected_shader == 0 ? _rainbow_triangle_pipeline : _red_triangle_pipeline;
+        _draw_list.assign(draw_count, DrawCommand{pipeline, 3, 0});
+    }
+
+    const VkDescriptorSet data_set = frame_data_set(_triangle_layout);
+    for (DrawCommand &draw : _draw_list)
+    {
+        draw.layout = _triangle_layout;
+        draw.data_set = data_set;
+    }
+
+    if (_cached_command_pool != VK_NULL_HANDLE)
+    {
+        write_cached_draw_data();
+    }
+
+    // every cached command buffer recorded the old draw list
+    _cache_generation++;
+}
+
+VkDescriptorSet VulkanEngine::frame_data_set(VkPipelineLayout layout)
+{
+    auto it = _frame_data_sets.find(layout);
+    if (it == _frame_data_sets.end())
+    {
+        // these live as long as the engine, so the pool they came from isn't needed to free them
+        VkDescriptorPool pool;
+        it = _frame_data_sets.emplace(layout, allocate_draw_data_set(layout, _frame_allocator.buffer(), &pool)).first;
+    }
+    return it->second;
+}
+
+VkDescriptorSet VulkanEngine::allocate_draw_data_set(VkPipelineLayout layout, VkBuffer buffer,
+                                                     VkDescriptorPool *outPool)
+{
+    // the draw data goes in the set and binding the layout cache reserves for it, which it made dynamic. That is what
+    // lets one set serve every draw
+    *outPool = VK_NULL_HANDLE;
+    const std::vector<VkDescriptorSetLayout> &set_layouts = _pipeline_layouts.set_layouts(layout);
+    if (set_layouts.size() <= PipelineLayoutCache::DRAW_DATA_SET)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    const VkDescriptorSetLayout set_layout = set_layouts[PipelineLayoutCache::DRAW_DATA_SET];
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings = _pipeline_layouts.bindings(set_layout);
+    auto binding = std::find_if(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding &candidate) {
+        return candidate.binding == PipelineLayoutCache::DRAW_DATA_BINDING &&
+               (candidate.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+                candidate.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+    });
+    if (binding == bindings.end())
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    VkDescriptorSetAllocateInfo allocate_info = {}; // initialise struct to 0's
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = descriptor_pool(set_layout);
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &set_layout;
+
+    VkDescriptorSet data_set;
+    if (vkAllocateDescriptorSets(_device, &allocate_info, &data_set) != VK_SUCCESS)
+    {
+        std::cout << "Failed to allocate a descriptor set for the draw data" << std::endl;
+        return VK_NULL_HANDLE;
+    }
+    *outPool = allocate_info.descriptorPool;
+
+    // the descriptor covers one draw's data, the dynamic offset picks which
+    VkDescriptorBufferInfo buffer_info = {buffer, 0, sizeof(DrawData)};
+
+    VkWriteDescriptorSet write = {}; // initialise struct to 0's
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = data_set;
+    write.dstBinding = binding->binding;
+    write.descriptorCount = 1;
+    write.descriptorType = binding->descriptorType;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+    return data_set;
+}
+
+VkDescriptorPool VulkanEngine::descriptor_pool(VkDescriptorSetLayout setLayout)
+{
+    auto it = _descriptor_pools.find(setLayout);
+    if (it != _descriptor_pools.end())
+    {
+        return it->second;
+    }
+
+    // sets are only allocated for each new pipeline layout and each draw list's cached data, so a handful of each set
+    // layout will do. The latter are freed again once the frames that used them are done
+    constexpr uint32_t MAX_DESCRIPTOR_SETS = 16;
+    std::vector<VkDescriptorPoolSize> pool_sizes = _pipeline_layouts.pool_sizes(setLayout);
+    for (VkDescriptorPoolSize &pool_size : pool_sizes)
+    {
+        pool_size.descriptorCount *= MAX_DESCRIPTOR_SETS;
+    }
+
+    VkDescriptorPoolCreateInfo pool_info = {}; // initialise struct to 0's
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    pool_info.maxSets = MAX_DESCRIPTOR_SETS;
+    pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+    pool_info.pPoolSizes = pool_sizes.data();
+
+    VkDescriptorPool pool;
+    VK_CHECK(vkCreateDescriptorPool(_device, &pool_info, nullptr, &pool));
+    _descriptor_pools.emplace(setLayout, pool);
+    return pool;
+}
+
+void VulkanEngine::write_cached_draw_data()
+{
+    // command buffers recorded for the old draw list are retired along with the frame that last used them, and so is
+    // the data they read
+    if (_cached_draw_data.buffer != VK_NULL_HANDLE)
+    {
+        _deletion_queue.push(_frame_number, [this, buffer = _cached_draw_data, data_set = _cached_draw_data_set,
+                                             descriptor_pool = _cached_draw_data_pool]() {
+            if (data_set != VK_NULL_HANDLE)
+            {
+                vkFreeDescriptorSets(_device, descriptor_pool, 1, &data_set);
+            }
+            _gpu_allocator.destroy_buffer(buffer);
+        });
+        _cached_draw_data = {};
+        _cached_draw_data_set = VK_NULL_HANDLE;
+        _cached_draw_data_pool = VK_NULL_HANDLE;
+    }
+
+    if (_draw_list.empty() || _draw_list[0].data_set == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    // laid out as the frame allocator would, so the offsets suit a uniform or a storage buffer descriptor
+    const VkDeviceSize stride = align_up(sizeof(DrawData), _frame_allocator.alignment());
+
+    VkBufferCreateInfo buffer_info = {}; // initialise struct to 0's
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = stride * _draw_list.size();
+    buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (!_gpu_allocator.create_buffer(buffer_info, MemoryPool::uniform, &_cached_draw_data))
+    {
+        std::cout << "Failed to create a buffer for the cached draw data" << std::endl;
+        return;
+    }
+
+    _cached_draw_data_set =
+        allocate_draw_data_set(_draw_list[0].layout, _cached_draw_data.buffer, &_cached_draw_data_pool);
+    if (_cached_draw_data_set == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < _draw_list.size(); ++i)
+    {
+        DrawCommand &draw = _draw_list[i];
+        draw.data_set = _cached_draw_data_set;
+        draw.static_data = true;
+        draw.data_offset = static_cast<uint32_t>(i * stride);
+        std::memcpy(static_cast<char *>(_cached_draw_data.mapped) + draw.data_offset, &draw.data, sizeof(DrawData));
+    }
+    _gpu_allocator.flush(_cached_draw_data, 0, buffer_info.size);
+}
+
+void VulkanEngine::record_render_pass(VkCommandBuffer commandBuffer, uint32_t swapchainImageIndex,
+                                      const VkClearValue &clearValue, FrameData *workerFrame)
+{
+    // start with the main render pass
+    // we will use the clear colour given to us, and the framebuffer of the
+    // index the swapchain gave us
+    VkRenderPassBeginInfo render_pass_begin_info = {}; // initialise struct with 0's
+    render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_begin_info.pNext = nullptr;
+    render_pass_begin_info.renderPass = _render_pass;
+    render_pass_begin_info.renderArea.offset.x = 0;
+    render_pass_begin_info.renderArea.offset.y = 0;
+    render_pass_begin_info.renderArea.extent = _window_extent;
+    render_pass_begin_info.framebuffer = _framebuffers[swapchainImageIndex]; // this is where we render into
+
+    // connect up clear values
+    render_pass_begin_info.clearValueCount = 1;
+    render_pass_begin_info.pClearValues = &clearValue;
+
+    // begin this render pass and record the draw list into it, either directly or by executing secondary command
+    // buffers recorded on the worker threads
+    if (workerFrame == nullptr)
+    {
+        vkCmdBeginRenderPass(commandBuffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        record_draws(commandBuffer, 0, _draw_list.size());
+    }
+    else
+    {
+        vkCmdBeginRenderPass(commandBuffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        record_draws_parallel(*workerFrame, commandBuffer, render_pass_begin_info.framebuffer);
+    }
+
+    // finalise this render pass
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+VkCommandBuffer VulkanEngine::get_cached_command_buffer(uint32_t swapchainImageIndex, const VkClearValue &clearValue)
+{
+    // the clear colour is baked into the recorded render pass, so a new one invalidates everything
+    if (std::memcmp(&clearValue.color, &_cached_clear_value.color, sizeof(VkClearColorValue)) != 0)
+    {
+        _cached_clear_value = clearValue;
+        _cache_generation++;
+    }
+
+    CachedCommandBuffer &cached = _cached_command_buffers[swapchainImageIndex];
+    if (cached.command_buffer != VK_NULL_HANDLE && cached.generation == _cache_generation)
+    {
+        cached.last_used_frame = _frame_number;
+        return cached.command_buffer;
+    }
+
+    // a command buffer that is still pending on the GPU can't be reset, so it is swapped for a fresh one instead
+    if (cached.command_buffer != VK_NULL_HANDLE && cached.last_used_frame > _last_completed_frame)
+    {
+        retire_cached_command_buffer(cached);
+    }
+
+    if (cached.command_buffer == VK_NULL_HANDLE)
+    {
+        VkCommandBufferAllocateInfo command_alloc_info = vulkan_engine::initialisers::command_buffer_allocate_info(
+            _cached_command_pool, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        VK_CHECK(vkAllocateCommandBuffers(_device, &command_alloc_info, &cached.command_buffer));
+    }
+    else
+    {
+        VK_CHECK(vkResetCommandBuffer(cached.command_buffer, 0));
+    }
+
+    // the same image can come round again before the GPU has finished the last frame that used it, so the buffer may
+    // be pending in more than one submission at a time
+    VkCommandBufferBeginInfo command_buffer_begin_info = {}; // initialise structure to 0's
+    command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    command_buffer_begin_info.pNext = nullptr;
+    command_buffer_begin_info.pInheritanceInfo = nullptr;
+    command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+
+    VK_CHECK(vkBeginCommandBuffer(cached.command_buffer, &command_buffer_begin_info));
+    record_render_pass(cached.command_buffer, swapchainImageIndex, clearValue, nullptr);
+    VK_CHECK(vkEndCommandBuffer(cached.command_buffer));
+
+    cached.generation = _cache_generation;
+    cached.last_used_frame = _frame_number;
+
+    _stats_total.cache_misses++;
+    _stats_window.cache_misses++;
+
+    return cached.command_buffer;
+}
+
+void VulkanEngine::retire_cached_command_buffer(CachedCommandBuffer &cached)
+{
+    _deletion_queue.push(cached.last_used_frame,
+                         [device = _device, pool = _cached_command_pool, command_buffer = cached.command_buffer]() {
+                             vkFreeCommandBuffers(device, pool, 1, &command_buffer);
+                         });
+
+    cached = {};
+}
+
+void VulkanEngine::record_draws(VkCommandBuffer commandBuffer, size_t firstDraw, size_t drawCount)
+{
+    // viewport and scissor are dynamic so that the pipelines survive a swapchain resize. Dynamic state isn't inherited
+    // by secondary command buffers, so every command buffer sets its own
+    VkViewport viewport = {0.0f, 0.0f, (float)_window_extent.width, (float)_window_extent.height, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, _window_extent};
+
+    // shader objects have no pipeline state at all, so everything is set here and only the shaders change per draw
+    if (_shader_objects_enabled)
+    {
+        _shader_objects.set_state(commandBuffer, _raster_state, viewport, scissor);
+
+        GraphicsShaders bound_shaders;
+        for (size_t i = firstDraw; i < firstDraw + drawCount; ++i)
+        {
+            const DrawCommand &draw = _draw_list[i];
+            if (draw.vertex_shader != bound_shaders.vertex || draw.fragment_shader != bound_shaders.fragment)
+            {
+                _shader_objects.bind(commandBuffer, draw.vertex_shader, draw.fragment_shader);
+                bound_shaders = {draw.vertex_shader, draw.fragment_shader};
+            }
+
+            if (bind_draw_data(commandBuffer, draw))
+            {
+                vkCmdDraw(commandBuffer, draw.vertex_count, 1, draw.first_vertex, 0);
+            }
+        }
+        return;
+    }
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // and whatever parts of the raster state the device lets us set dynamically
+    _extended_dynamic_state.apply(commandBuffer, _raster_state);
+
+    // render commands go here, only rebinding the pipeline when it changes
+    VkPipeline bound_pipeline = VK_NULL_HANDLE;
+    for (size_t i = firstDraw; i < firstDraw + drawCount; ++i)
+    {
+        const DrawCommand &draw = _draw_list[i];
+        if (draw.pipeline != bound_pipeline)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+            bound_pipeline = draw.pipeline;
+        }
+
+        if (bind_draw_data(commandBuffer, draw))
+        {
+            vkCmdDraw(commandBuffer, draw.vertex_count, 1, draw.first_vertex, 0);
+        }
+    }
+}
+
+bool VulkanEngine::bind_draw_data(VkCommandBuffer commandBuffer, const DrawCommand &draw)
+{
+    if (draw.data_set == VK_NULL_HANDLE)
+    {
+        return true;
+    }
+
+    // a draw whose data doesn't fit is skipped, drawing it with whatever the offset happens to hold would be worse
+    uint32_t offset = draw.data_offset;
+    if (!draw.static_data && !_frame_allocator.push(draw.data, &offset))
+    {
+        return false;
+    }
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.layout, 0, 1, &draw.data_set, 1,
+                            &offset);
+    return true;
+}
+
+void VulkanEngine::record_draws_parallel(FrameData &frame, VkCommandBuffer primaryCommandBuffer,
+                                         VkFramebuffer framebuffer)
+{
+    // every secondary command buffer has a fixed cost to begin and execute, so small draw lists use fewer threads
+    constexpr size_t MIN_DRAWS_PER_SECONDARY = 256;
+
+    const size_t draw_count = _draw_list.size();
+    const uint32_t slice_count = static_cast<uint32_t>(std::clamp<size_t>(
+        (draw_count + MIN_DRAWS_PER_SECONDARY - 1) / MIN_DRAWS_PER_SECONDARY, 1, _recording_threads));
+    const size_t slice_size = (draw_count + slice_count - 1) / slice_count;
+
+    std::vector<std::future<void>> recorded;
+    recorded.reserve(slice_count);
+    for (uint32_t slice = 0; slice < slice_count; ++slice)
+    {
+        const size_t first_draw = std::min(slice * slice_size, draw_count);
+        const size_t slice_draw_count = std::min(slice_size, draw_count - first_draw);
+
+        // every slice owns its own pool and buffer in this frame, so nothing here needs a lock
+        VkCommandPool command_pool = frame.worker_command_pools[slice];
+        VkCommandBuffer command_buffer = frame.worker_command_buffers[slice];
+
+        recorded.push_back(_recording_pool.submit([=]() {
+            // the GPU has finished with this frame, so everything allocated from the pool can be recycled at once
+            VK_CHECK(vkResetCommandPool(_device, command_pool, 0));
+
+            // secondary command buffers recorded inside a render pass need to know which one they continue
+            VkCommandBufferInheritanceInfo inheritance_info = {}; // initialise struct to 0's
+            inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            inheritance_info.pNext = nullptr;
+            inheritance_info.renderPass = _render_pass;
+            inheritance_info.subpass = 0;
+            inheritance_info.framebuffer = framebuffer;
+
+            VkCommandBufferBeginInfo begin_info = {}; // initialise struct to 0's
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.pNext = nullptr;
+            begin_info.pInheritanceInfo = &inheritance_info;
+            begin_info.flags =
+                VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+
+            VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+            record_draws(command_buffer, first_draw, slice_draw_count);
+            VK_CHECK(vkEndCommandBuffer(command_buffer));
+        }));
+    }
+
+    for (std::future<void> &slice : recorded)
+    {
+        slice.get();
+    }
+
+    vkCmdExecuteCommands(primaryCommandBuffer, slice_count, frame.worker_command_buffers.data());
+}
+
+bool VulkanEngine::load_spirv(const char *filePath, std::vector<uint32_t> *outCode)
+{
+    // open the shader file with the cursor at the end (ios::ate) and in binary
+    // mode (ios::binary)
+    std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    // determine the file size by looking at the location of the cursor. Because
+    // the cursor is at the end of the file, we get the size directly in bytes
+    auto file_size = (size_t)file.tellg();
+
+    // SPIR-V is made of whole words, and anything else would overrun the buffer below
+    if (file_size % sizeof(uint32_t) != 0)
+    {
+        return false;
+    }
+
+    // spirv expects the bugger to be in uint32, so we need to make sure to
+    // reserve an int vector big enough for the entire shader file
+    std::vector<uint32_t> &buffer = *outCode;
+    buffer.resize(file_size / sizeof(uint32_t));
+
+    // reset cursor to beginning of file
+    file.seekg(0);
+
+    // load the entire file into the buffer. It may have been cut short since we looked at its size, e.g. while it is
+    // being rewritten
+    if (!file.read((char *)buffer.data(), file_size))
+    {
+        return false;
+    }
+
+    // now that the file is loaded into the buffer, we can close it like the tidy
+    // kiwi I am ;)
+    file.close();
+    return true;
+}
+
+bool VulkanEngine::map_spirv(const char *filePath, MappedFile *outFile)
+{
+    if (!outFile->open(filePath))
+    {
+        return false;
+    }
+
+    // the driver reads the mapped pages directly, so they have to be SPIR-V it can take as it is
+    std::string reason;
+    if (!is_valid_spirv(outFile->data(), outFile->size(), &reason))
+    {
+        std::cout << filePath << " can't be used as a shader: " << reason << std::endl;
+        outFile->close();
+        return false;
+    }
+
+    return true;
+}
+
+bool VulkanEngine::find_shader(const char *shaderName, MappedFile *outFile, std::vector<uint32_t> *outBuffer,
+                               const uint32_t **outCode, size_t *outSize) const
+{
+    auto compiled = _compiled_shaders.find(shaderName);
+    if (compiled != _compiled_shaders.end())
+    {
+        *outCode = compiled->second.data();
+        *outSize = compiled->second.size() * sizeof(uint32_t);
+        return true;
+    }
+
+    if (_config.use_embedded_shaders)
+    {
+        // glslang produced these at build time, so they need no checking
+        const EmbeddedShader *shader = find_embedded_shader(shaderName);
+        if (shader == nullptr)
+        {
+            std::cout << shaderName << " isn't one of the embedded shaders" << std::endl;
+            return false;
+        }
+
+        *outCode = shader->code;
+        *outSize = shader->size;
+        return true;
+    }
+
+    // the files we watch are rewritten in place by the compiler and editors, and touching a mapped page past the end
+    // of a file that has just been truncated kills the process with SIGBUS. So under hot reload they are copied, and a
+    // file caught half written fails the checks instead
+    if (_shader_watcher_enabled)
+    {
+        std::string reason;
+        const std::string file_path = shader_path(shaderName);
+        if (!load_spirv(file_path.c_str(), outBuffer))
+        {
+            return false;
+        }
+        if (!is_valid_spirv(outBuffer->data(), outBuffer->size() * sizeof(uint32_t), &reason))
+        {
+            std::cout << file_path << " can't be used as a shader: " << reason << std::endl;
+            return false;
+        }
+
+        *outCode = outBuffer->data();
+        *outSize = outBuffer->size() * sizeof(uint32_t);
+        return true;
+    }
+
+    // map the file instead of copying it into a buffer, the driver reads the code straight from the page cache
+    if (!map_spirv(shader_path(shaderName).c_str(), outFile))
+    {
+        return false;
+    }
+
+    *outCode = static_cast<const uint32_t *>(outFile->data());
+    *outSize = outFile->size();
+    return true;
+}
+
+bool VulkanEngine::load_shader_module(const char *shaderName, VkShaderModule *outShaderModule)
+{
+    MappedFile file;
+    std::vector<uint32_t> buffer;
+    const uint32_t *code;
+    size_t code_size;
+    if (!find_shader(shaderName, &file, &buffer, &code, &code_size))
+    {
+        return false;
+    }
+
+    // the same code loaded twice (e.g. by two materials) shares one module
+    return _shader_modules.acquire(code, code_size, outShaderModule);
+};
+
+void VulkanEngine::set_present_mode(VkPresentModeKHR presentMode)
+{
+    _config.present_mode = presentMode;
+    _swapchain_dirty = true;
+}
+
+void VulkanEngine::set_min_image_count(uint32_t minImageCount)
+{
+    _config.min_image_count = minImageCount;
+    _swapchain_dirty = true;
+}
+
+bool VulkanEngine::is_present_mode_supported(VkPresentModeKHR presentMode) const
+{
+    uint32_t mode_count = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(_chosen_gpu, _surface, &mode_count, nullptr);
+    std::vector<VkPresentModeKHR> modes(mode_count);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(_chosen_gpu, _surface, &mode_count, modes.data());
+
+    return std::find(modes.begin(), modes.end(), presentMode) != modes.end();
+}
+
+void VulkanEngine::read_frame_timestamps(FrameData &frame)
+{
+    if (!frame.timestamps_written)
+    {
+        return;
+    }
+
+    // the frame's fence (or timeline value) has been waited on, so the results are ready and we don't need to wait
+    uint64_t timestamps[2];
+    if (vkGetQueryPoolResults(_device, frame.timestamp_pool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+    {
+        // only the low timestampValidBits of each timestamp are meaningful, so mask the delta to them, which also
+        // copes with the counter wrapping between the two writes. timestampPeriod is the number of nanoseconds per
+        // timestamp tick
+        const uint64_t valid_mask = _timestamp_valid_bits >= 64 ? ~0ull : (1ull << _timestamp_valid_bits) - 1;
+        const uint64_t ticks = (timestamps[1] - timestamps[0]) & valid_mask;
+        const double gpu_time = ticks * _gpu_properties.limits.timestampPeriod / 1000000.0;
+        _stats_total.gpu_frame_ms += gpu_time;
+        _stats_total.gpu_samples++;
+        _stats_window.gpu_frame_ms += gpu_time;
+        _stats_window.gpu_samples++;
+    }
+
+    frame.timestamps_written = false;
+}
+
+FrameData &VulkanEngine::get_current_frame()
+{
+    return _frames[_frame_number % _frames_in_flight];
+}
+
+VkSemaphore &VulkanEngine::get_acquire_semaphore(int64_t frameNumber)
+{
+    return _acquire_semaphores[frameNumber % (_frames_in_flight + 1)];
+}
+
+VkResult VulkanEngine::acquire_next_image(VkSemaphore semaphore, uint32_t *outImageIndex)
+{
+    if (!_present_thread_enabled)
+    {
+        return vkAcquireNextImageKHR(_device, _swapchain, 1000000000 /*ns*/, semaphore, nullptr, outImageIndex);
+    }
+
+    // usually the previous frame already asked for this image as soon as it was submitted
+    if (!_acquire_pending)
+    {
+        _present_thread.request_acquire(_swapchain, semaphore);
+    }
+
+    const AcquireResult result = _present_thread.wait_for_acquire();
+    _acquire_pending = false;
+
+    *outImageIndex = result.image_index;
+    return result.result;
+}
+
+void VulkanEngine::drain_present_thread()
+{
+    // once idle, the present thread has finished every present and acquire we gave it
+    _present_thread.wait_idle();
+
+    if (!_acquire_pending)
+    {
+        return;
+    }
+
+    const AcquireResult result = _present_thread.wait_for_acquire();
+    _acquire_pending = false;
+    if (result.result != VK_SUCCESS && result.result != VK_SUBOPTIMAL_KHR)
+    {
+        // nothing was acquired, so the semaphore was never signalled
+        return;
+    }
+
+    // the early acquired image is simply dropped along with the old swapchain, but its semaphore is going to be
+    // signalled regardless. An empty submission consumes that signal, and the semaphore is swapped for a fresh one so
+    // this frame doesn't have to wait for the submission before reusing the slot
+    VkSemaphore &acquire_semaphore = get_acquire_semaphore(_frame_number);
+
+    VkSubmitInfo submit = {}; // initialise struct to 0's
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.pNext = nullptr;
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    submit.pWaitDstStageMask = &wait_stage;
+
+    submit.waitSemaphoreCount = 1;
+    submit.pWaitSemaphores = &acquire_semaphore;
+
+    {
+        std::lock_guard<std::mutex> lock(_graphics_queue_mutex);
+        VK_CHECK(vkQueueSubmit(_graphics_queue, 1, &submit, VK_NULL_HANDLE));
+    }
+
+    // queue submissions complete in order, so the empty submission is done once this frame is
+    _deletion_queue.push(_frame_number, [device = _device, semaphore = acquire_semaphore]() {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    });
+
+    VkSemaphoreCreateInfo semaphore_info = {}; // initialise structure with 0's
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = nullptr;
+    semaphore_info.flags = 0;
+    VK_CHECK(vkCreateSemaphore(_device, &semaphore_info, nullptr, &acquire_semaphore));
+}
+
+void VulkanEngine::report_frame_stats()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now - _last_report_time < std::chrono::seconds(1))
+    {
+        return;
+    }
+
+    if (_stats_window.frames == 0)
+    {
+        return;
+    }
+
+    // presented FPS is capped by the present mode, the CPU and GPU frame costs show what the engine could do uncapped
+    const std::chrono::duration<double> elapsed = now - _last_report_time;
+    const double frames = _stats_window.frames;
+    std::cout << present_mode_name(_present_mode) << ", " << _swapchain_images.size() << " images, "
+              << _frames_in_flight << " frames in flight, " << _draw_list.size() << " draws recorded on "
+              << std::max(_recording_threads, 1u) << " thread(s) | presented: " << frames / elapsed.count()
+              << " fps | CPU frame: " << _stats_window.cpu_frame_ms / frames << " ms | GPU frame: "
+              << (_stats_window.gpu_samples > 0 ? _stats_window.gpu_frame_ms / _stats_window.gpu_samples : 0.0)
+              << " ms | blocked in " << (_timeline_semaphores_enabled ? "vkWaitSemaphores" : "vkWaitForFences")
+              << ": " << _stats_window.gpu_wait_ms / frames << " ms";
+    if (_cached_command_pool != VK_NULL_HANDLE)
+    {
+        std::cout << " | re-recorded: " << _stats_window.cache_misses << "/" << _stats_window.frames << " frames";
+    }
+    std::cout << std::endl;
+
+    _stats_window = {};
+    _last_report_time = now;
+}
 } // namespace vulkan_engine
\ No newline at end of file
@@ -1,21 +1,89 @@
 ﻿#pragma once
 
+#include "DeletionQueue.h"
+#include "ExtendedDynamicState.h"
+#include "FrameAllocator.h"
+#include "GpuAllocator.h"
+#include "GraphicsPipelineLibrary.h"
+#include "MappedFile.h"
+#include "PipelineCache.h"
+#include "PipelineLayoutCache.h"
+#include "PipelinePermutations.h"
+#include "PipelineRegistry.h"
+#include "PresentThread.h"
+#include "ShaderCompiler.h"
+#include "ShaderModuleCache.h"
+#include "ShaderObjects.h"
+#include "ShaderWatcher.h"
+#include "ThreadPool.h"
+#include "TimelineScheduler.h"
+#include "UploadManager.h"
 #include "VulkanTypes.h"
 
 #include <SDL_video.h>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace vulkan_engine
 {
 
+// everything that is needed to record and submit a single frame. We keep a ring of these so the CPU can record frame
+// N+1 while the GPU is still busy executing frame N
+struct FrameData
+{
+    VkCommandPool command_pool;
+    VkCommandBuffer main_command_buffer; // the buffer that we will record into
+
+    // one pool and secondary buffer per recording slice, so worker threads never share a pool
+    std::vector<VkCommandPool> worker_command_pools;
+    std::vector<VkCommandBuffer> worker_command_buffers;
+
+    VkFence render_fence{VK_NULL_HANDLE}; // only used when timeline semaphores are unavailable
+
+    uint64_t timeline_value{0}; // graphics timeline value signalled by this frame's last submission
+
+    VkQueryPool timestamp_pool{VK_NULL_HANDLE}; // GPU timestamps at the start and end of the frame
+    bool timestamps_written{false};            // true once a submitted frame has written the above queries
+};
+
+// a command buffer pre-recorded for one swapchain image, reused for as long as nothing it depends on changes
+struct CachedCommandBuffer
+{
+    VkCommandBuffer command_buffer{VK_NULL_HANDLE};
+    uint64_t generation{0};       // the cache generation this was recorded for
+    int64_t last_used_frame{-1}; // the last frame that submitted it
+};
+
+// a pipeline build queued on a worker thread, and the shader modules it holds a reference to until it has finished
+struct PendingPipelineBuild
+{
+    PipelineHandle handle;
+    std::vector<VkShaderModule> shader_modules;
+};
+
+// running totals used for the periodic performance report. Blocking waits are kept separate from the CPU frame cost
+// so that the uncapped cost of a frame is visible even when presentation is throttled by vsync
+struct FrameStats
+{
+    int frames{0};
+    double gpu_wait_ms{0};  // CPU time blocked waiting for the GPU to release a frame slot
+    double cpu_frame_ms{0}; // CPU time spent recording and submitting a frame
+    double gpu_frame_ms{0}; // GPU time spent executing a frame, from timestamp queries
+    int gpu_samples{0};     // how many frames contributed to gpu_frame_ms
+    int cache_misses{0};    // cached command buffers that had to be (re-)recorded
+};
+
 class VulkanEngine
 {
   public:
     // initializes everything in the engine
-    void init();
+    void init(const EngineConfig &config);
 
     // shuts down the engine
-    void cleanup() const;
+    void cleanup();
 
     // draw loop
     void draw();
@@ -23,11 +91,22 @@ class VulkanEngine
     // run main loop
     void run();
 
+    // change how frames are presented (FIFO, FIFO_RELAXED, MAILBOX or IMMEDIATE). The swapchain is rebuilt before the
+    // next frame, falling back to FIFO if the surface doesn't support the mode
+    void set_present_mode(VkPresentModeKHR presentMode);
+
+    // ask for at least this many swapchain images, 0 lets the driver decide. The swapchain is rebuilt before the
+    // next frame
+    void set_min_image_count(uint32_t minImageCount);
+
   private:
     void init_vulcan();
 
     void init_swapchain();
 
+    // rebuild the swapchain (and its framebuffers) for the current window size without stalling the GPU
+    void recreate_swapchain();
+
     void init_commands();
 
     void init_default_render_pass();
@@ -40,9 +119,160 @@ class VulkanEngine
 
     void init_sync_structures();
 
+    // one render semaphore per image of the current swapchain
+    void init_render_semaphores();
+
+    void init_timestamp_queries();
+
+    void init_present_thread();
+
+    // the frame allocator the shaders' per-draw data comes from, and the descriptor pool its sets are allocated from
+    void init_frame_data();
+
+    // the upload manager everything reaches the GPU's own memory through
+    void init_uploads();
+
     void init_pipelines();
 
-    bool load_shader_module(const char *filePath, VkShaderModule *outShaderModule);
+    // fill the draw list with the currently selected triangle
+    void build_draw_list();
+
+    // swap in any pipelines that have finished compiling in the background
+    void poll_async_pipelines();
+
+    // set builder up for the current raster state, keeping count of the distinct permutations asked for
+    void configure_raster_pipeline(PipelineBuilder &builder);
+
+    // fetch (or build) the pipelines for the current raster state
+    void update_raster_pipelines();
+
+    // get the triangle pipelines again from the current shaders, raster state and render pass
+    void rebuild_triangle_pipelines();
+
+    // get both triangle variants from _triangle_builder, optionally leaving the rainbow one to compile in the
+    // background. False (and still drawing with the old pipelines) if either fails to build
+    bool build_triangle_pipelines(bool rainbowInBackground);
+
+    // compile the triangle shaders from GLSL on the worker threads, or fetch them from the shader cache. Any that fail
+    // are loaded prebuilt as usual
+    void compile_shaders();
+
+    // give builder the pipeline layout and vertex input the triangle shaders' reflections ask for, false when no layout
+    // can be made for them
+    bool lay_out_triangle_pipeline(PipelineBuilder &builder);
+
+    // load the triangle shaders from disk (getting the same modules back while anything still holds them) and point
+    // _triangle_builder at them, laid out to match. They replace the modules held before, which are kept if the new
+    // ones fail to load or lay out. Only called at start-up and when the shader watcher reports a change
+    bool load_triangle_shaders();
+
+    // give back the modules load_triangle_shaders() is holding, at shutdown
+    void release_triangle_shaders();
+
+    // queue a variant of _triangle_builder on the compile pool. The build holds its shader modules until it finishes.
+    // outKey, when given, is set to the variant's permutation key
+    PipelineHandle build_triangle_async(const SpecialisationValues &values, std::string *outKey = nullptr);
+
+    // give back the shader modules held by background builds that have finished
+    void release_finished_builds();
+
+    // create the triangle variants as shader objects, which need no pipelines at all
+    bool create_triangle_shader_objects(GraphicsShaders *outRainbowShaders, GraphicsShaders *outRedShaders,
+                                        VkPipelineLayout *outLayout);
+
+    // reload any shaders that changed on disk, swapping in their rebuilt pipelines once they are ready
+    void poll_shader_reloads();
+
+    // load the triangle shaders again and start rebuilding their pipelines in the background
+    void reload_triangle_shaders();
+
+    // destroy whatever a reload that can't be swapped in built, leaving the pipelines we draw with alone
+    void discard_reloaded_pipelines();
+
+    // time recording bind + draw pairs with pipelines against doing the same with shader objects
+    void run_bind_benchmark();
+
+    // time creating a shader module from every .spv file in a directory, reading the files into buffers against
+    // mapping them
+    void run_shader_load_benchmark();
+
+    // time creating many small buffers through the allocator's pools, and count the device memory allocations behind
+    // them
+    void run_allocation_benchmark();
+
+    // time uploading many small pieces of buffer data, and whole images, through the upload manager
+    void run_upload_benchmark();
+
+    // read a SPIR-V file into outCode
+    static bool load_spirv(const char *filePath, std::vector<uint32_t> *outCode);
+
+    // map a SPIR-V file and check that it can be handed to the driver as it is
+    static bool map_spirv(const char *filePath, MappedFile *outFile);
+
+    // the SPIR-V for one of our shaders (e.g. "triangle.vert.spv"): compiled at start-up, from the embedded bundle or
+    // from the shaders directory depending on the config. Files are mapped, with outFile owning the mapping, except
+    // under hot reload, where they are read into outBuffer. Either way outCode is only valid while that holds it
+    bool find_shader(const char *shaderName, MappedFile *outFile, std::vector<uint32_t> *outBuffer,
+                     const uint32_t **outCode, size_t *outSize) const;
+
+    // load one of our shaders through the module cache, which takes a reference that must be released once no
+    // pipeline build needs the module anymore
+    bool load_shader_module(const char *shaderName, VkShaderModule *outShaderModule);
+
+    // the frame slot that the current _frame_number records into
+    FrameData &get_current_frame();
+
+    // the semaphore signalled when the image for the given frame has been acquired
+    VkSemaphore &get_acquire_semaphore(int64_t frameNumber);
+
+    // acquire the next swapchain image, either directly or through the present thread
+    VkResult acquire_next_image(VkSemaphore semaphore, uint32_t *outImageIndex);
+
+    // make sure the present thread is finished with the current swapchain, giving back any image it acquired early
+    void drain_present_thread();
+
+    bool is_present_mode_supported(VkPresentModeKHR presentMode) const;
+
+    // collect the GPU timestamps written by the frame that last used this slot
+    void read_frame_timestamps(FrameData &frame);
+
+    // record the main render pass into commandBuffer. Recording is split across the worker threads when workerFrame
+    // (whose per-thread pools are used) is given, otherwise it happens inline
+    void record_render_pass(VkCommandBuffer commandBuffer, uint32_t swapchainImageIndex, const VkClearValue &clearValue,
+                            FrameData *workerFrame);
+
+    // the command buffer pre-recorded for this swapchain image, re-recorded first if anything it uses has changed
+    VkCommandBuffer get_cached_command_buffer(uint32_t swapchainImageIndex, const VkClearValue &clearValue);
+
+    // free a cached command buffer once the GPU is done with it
+    void retire_cached_command_buffer(CachedCommandBuffer &cached);
+
+    // record a range of the draw list into a command buffer that is inside the main render pass
+    void record_draws(VkCommandBuffer commandBuffer, size_t firstDraw, size_t drawCount);
+
+    // bind a draw's data, copying it into the frame allocator first unless it was written ahead of time. False when
+    // this frame has run out of room for it
+    bool bind_draw_data(VkCommandBuffer commandBuffer, const DrawCommand &draw);
+
+    // the descriptor set pointing at the frame allocator for pipelines with this layout, null if they read no data
+    VkDescriptorSet frame_data_set(VkPipelineLayout layout);
+
+    // allocate a set for the draw data of pipelines with this layout, pointing at buffer, from the pool outPool is set
+    // to. Null if they read no data
+    VkDescriptorSet allocate_draw_data_set(VkPipelineLayout layout, VkBuffer buffer, VkDescriptorPool *outPool);
+
+    // the pool sets of this layout are allocated from, created sized for the layout the first time it is asked for
+    VkDescriptorPool descriptor_pool(VkDescriptorSetLayout setLayout);
+
+    // write the draw list's data into a buffer of its own, for cached command buffers to replay
+    void write_cached_draw_data();
+
+    // split the draw list across the worker threads, each recording a secondary command buffer, and execute them all
+    // from the primary
+    void record_draws_parallel(FrameData &frame, VkCommandBuffer primaryCommandBuffer, VkFramebuffer framebuffer);
+
+    // periodically print presented FPS, CPU/GPU frame cost and how long the CPU spent blocked on the GPU
+    void report_frame_stats();
 
   private:
     VkInstance _instance;                      // Vulkan library handle
@@ -50,32 +280,177 @@ class VulkanEngine
     VkPhysicalDevice _chosen_gpu;              // GPU chosen as the default hardware device
     VkDevice _device;                          // Logical Vulkan device for commands
     VkSurfaceKHR _surface;                     // Vulkan window service
+    VkPhysicalDeviceProperties _gpu_properties; // limits and identifiers of the chosen GPU
 
-    VkSwapchainKHR _swapchain;
+    VkSwapchainKHR _swapchain{VK_NULL_HANDLE};
     VkFormat _swapchain_image_format; // image format expected by the windowing system
     std::vector<VkImage> _swapchain_images;
     std::vector<VkImageView> _swapchain_image_views;
+    bool _swapchain_dirty{false}; // set when the swapchain no longer matches the window and needs rebuilding
+    VkPresentModeKHR _present_mode{VK_PRESENT_MODE_FIFO_KHR}; // the mode the current swapchain actually uses
 
     VkQueue _graphics_queue;         // queue that all render jobs will be submitted to
     uint32_t _graphics_queue_family; // the above queue's family type
+    std::mutex _graphics_queue_mutex; // Vulkan queues need external synchronisation once the present thread runs
+
+    // the queue uploads are copied on: one from a transfer-only family when the device has one, otherwise one from
+    // any other family that supports transfers but not graphics, otherwise the graphics queue itself. Only the upload
+    // manager submits to it
+    VkQueue _transfer_queue;
+    uint32_t _transfer_queue_family;
+
+    // optionally acquire and present on a separate thread, with the next image requested as soon as a frame is
+    // submitted
+    bool _present_thread_enabled{false};
+    PresentThread _present_thread;
+    bool _acquire_pending{false}; // the present thread has been asked for an image that we haven't collected yet
 
-    VkCommandPool _command_pool;
-    VkCommandBuffer _main_command_buffer; // the buffer that we will record into
+    // when enabled, frames (and anything else submitted to the graphics queue) are tracked with timeline values
+    // instead of fences
+    bool _timeline_semaphores_enabled{false};
+    TimelineScheduler _graphics_timeline;
+
+    FrameData _frames[MAX_FRAMES_IN_FLIGHT];
+    uint32_t _frames_in_flight{2}; // how many of the above frames are actually in use
+
+    // image acquire semaphores are kept in their own ring, one longer than the frame ring, so the next frame's image
+    // can be acquired before we have waited for its frame slot
+    VkSemaphore _acquire_semaphores[MAX_FRAMES_IN_FLIGHT + 1];
+
+    // signalled when a frame's rendering is done and waited on by its present. They belong to swapchain images rather
+    // than frame slots: the frame fence doesn't cover the present, but an image can't be acquired again (and its
+    // semaphore signalled again) until the present that waited on it has been consumed
+    std::vector<VkSemaphore> _render_semaphores;
 
     VkRenderPass _render_pass;
     std::vector<VkFramebuffer> _framebuffers;
 
-    VkSemaphore _present_semaphore, _render_semaphore;
-    VkFence _render_fence;
+    // shared by every pipeline we build, and persisted between runs
+    PipelineCache _pipeline_cache;
+
+    // every pipeline is requested through here, so identical state is only ever built once
+    PipelineRegistry _pipeline_registry;
+
+    // linking pipelines from separately compiled parts, when enabled and supported
+    GraphicsPipelineLibrary _graphics_pipeline_library;
+    bool _pipeline_libraries_enabled{false};
+
+    // background pipeline compiles and optimised links. Until a pipeline is ready, draws use the red triangle pipeline
+    // in its place
+    ThreadPool _compile_pool;
+    PipelineHandle _rainbow_triangle_request;
 
-    VkPipelineLayout _triangle_pipeline_layout;
-    VkPipeline _rainbow_triangle_pipeline;
-    VkPipeline _red_triangle_pipeline;
+    // the raster state the triangles are drawn with, and which parts of it can be set without a new pipeline
+    RasterState _raster_state;
+    ExtendedDynamicState _extended_dynamic_state;
+    bool _wireframe_supported{false};
+
+    // the builder behind the triangle pipelines, kept so variants can be requested when the raster state changes
+    PipelineBuilder _triangle_builder;
+
+    // the rainbow and red triangles, and every raster state they have been drawn with, as variants of one pipeline
+    PipelinePermutations _triangle_permutations;
+
+    // every fully baked pipeline state requested so far, compared against how many pipelines we actually built
+    std::unordered_set<std::string> _raster_permutations;
+
+    // drawing with shader objects instead of pipelines, when enabled and supported
+    ShaderObjects _shader_objects;
+    bool _shader_objects_enabled{false};
+    GraphicsShaders _rainbow_triangle_shaders;
+    GraphicsShaders _red_triangle_shaders;
+
+    // every buffer and image gets its memory from here
+    GpuAllocator _gpu_allocator;
+
+    // and its contents, when it lives in device local memory, from here
+    UploadManager _upload_manager;
+
+    // every shader module is shared through here, by the hash of its code
+    ShaderModuleCache _shader_modules;
+
+    // shaders compiled from GLSL at start-up, by the name of the .spv file they stand in for
+    ShaderCompiler _shader_compiler;
+    std::unordered_map<std::string, std::vector<uint32_t>> _compiled_shaders;
+
+    // pipeline and descriptor set layouts made from shader reflection, shared between pipelines with the same
+    // interface
+    PipelineLayoutCache _pipeline_layouts;
+
+    // the modules _triangle_builder points at, held for as long as they are the current triangle shaders, so
+    // pipelines can be requested from the builder without going back to disk. Background builds hold theirs until
+    // they finish, so a replaced module is destroyed as soon as no build needs it
+    VkShaderModule _triangle_vertex_shader{VK_NULL_HANDLE};
+    VkShaderModule _triangle_fragment_shader{VK_NULL_HANDLE};
+    std::vector<PendingPipelineBuild> _pending_builds;
+
+    // rebuilding the triangles when their shaders change on disk. Only the triangle shaders are watched for, as they
+    // are the only ones anything is built from. Pipelines evicted while we still draw with them (e.g. by a reload) are
+    // held on to until new ones are swapped in
+    ShaderWatcher _shader_watcher;
+    bool _shader_watcher_enabled{false};
+    PipelineHandle _rainbow_reload_request;
+    PipelineHandle _red_reload_request;
+    std::string _rainbow_reload_key;
+    std::string _red_reload_key;
+    std::vector<VkPipeline> _reload_retired_pipelines;
+    bool _reload_trim_pending{false};
+
+    VkPipeline _rainbow_triangle_pipeline{VK_NULL_HANDLE};
+    VkPipeline _red_triangle_pipeline{VK_NULL_HANDLE};
+
+    // the layout of the triangle pipelines (or shader objects) we are drawing with. During a shader reload this is the
+    // old one until the new pipelines are swapped in
+    VkPipelineLayout _triangle_layout{VK_NULL_HANDLE};
+
+    std::vector<DrawCommand> _draw_list;
+
+    // per-draw data is allocated from here every frame and bound with dynamic offsets, through one descriptor set per
+    // pipeline layout
+    FrameAllocator _frame_allocator;
+    std::unordered_map<VkDescriptorSetLayout, VkDescriptorPool> _descriptor_pools;
+    std::unordered_map<VkPipelineLayout, VkDescriptorSet> _frame_data_sets;
+
+    // cached command buffers replay the same offsets frame after frame, which the frame allocator reuses, so their
+    // data is written once per draw list into a buffer of its own
+    AllocatedBuffer _cached_draw_data;
+    VkDescriptorSet _cached_draw_data_set{VK_NULL_HANDLE};
+    VkDescriptorPool _cached_draw_data_pool{VK_NULL_HANDLE};
+
+    // the clear colour flashes unless paused, which static frames want so their command buffers can be reused
+    bool _animate_clear_colour{true};
+    int _clear_colour_frame{0};
+
+    // one pre-recorded command buffer per swapchain image. Anything that changes what they would record bumps the
+    // generation, so that each one is re-recorded the next time its image comes round
+    VkCommandPool _cached_command_pool{VK_NULL_HANDLE};
+    std::vector<CachedCommandBuffer> _cached_command_buffers;
+    uint64_t _cache_generation{1};
+    VkClearValue _cached_clear_value{};
+
+    // worker threads for recording secondary command buffers, unused when recording on the main thread
+    uint32_t _recording_threads{0};
+    ThreadPool _recording_pool;
+
+    EngineConfig _config;
 
     VkExtent2D _window_extent{640, 320};
     SDL_Window *_window{nullptr};
     bool _is_initialized{false};
     int _frame_number{0};
     int _selected_shader{0};
+
+    // GPU objects waiting for the frames that use them to retire
+    DeletionQueue _deletion_queue;
+    int64_t _last_completed_frame{-1}; // every frame up to and including this one has finished on the GPU
+
+    // GPU timestamps are only used when the graphics queue supports them
+    bool _timestamps_supported{false};
+    uint32_t _timestamp_valid_bits{0}; // how many low bits of the graphics queue's timestamps are meaningful
+
+    // performance stats, both for the whole run and since the last report
+    FrameStats _stats_total;
+    FrameStats _stats_window;
+    std::chrono::steady_clock::time_point _last_report_time;
 };
 } // namespace vulkan_engine
\ No newline at end of file
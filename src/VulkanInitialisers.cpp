@@ -34,8 +34,21 @@ VkCommandBufferAllocateInfo command_buffer_allocate_info(
     return command_alloc_info;
 }
 
+VkShaderModuleCreateInfo shader_module_create_info(const uint32_t *code, size_t codeSize)
+{
+    VkShaderModuleCreateInfo shader_module_info = {}; // initialise entire struct to 0's
+    shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shader_module_info.pNext = nullptr;
+
+    // codeSize has to be in bytes
+    shader_module_info.codeSize = codeSize;
+    shader_module_info.pCode = code;
+    return shader_module_info;
+}
+
 VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info(VkShaderStageFlagBits stage,
-                                                                  VkShaderModule shaderModule)
+                                                                  VkShaderModule shaderModule,
+                                                                  const VkSpecializationInfo *specialisationInfo)
 {
     VkPipelineShaderStageCreateInfo shader_stage_info = {}; // initialise entire struct to 0's
     shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -43,6 +56,9 @@ VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info(VkShaderStageF
     shader_stage_info.stage = stage;         // shader stage
     shader_stage_info.module = shaderModule; // module containing the code for this shader stage
     shader_stage_info.pName = "main";        // the entry point of the shader
+
+    // values for the shader's specialisation constants, if it has any
+    shader_stage_info.pSpecializationInfo = specialisationInfo;
     return shader_stage_info;
 }
 
@@ -114,6 +130,26 @@ VkPipelineMultisampleStateCreateInfo multisampling_state_create_info()
     return multisample_state_info;
 }
 
+VkPipelineDepthStencilStateCreateInfo depth_stencil_create_info(bool depthTest, bool depthWrite, VkCompareOp compareOp)
+{
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_info = {}; // initialise entire struct to 0's
+    depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil_info.pNext = nullptr;
+
+    depth_stencil_info.depthTestEnable = depthTest ? VK_TRUE : VK_FALSE;
+    depth_stencil_info.depthWriteEnable = depthWrite ? VK_TRUE : VK_FALSE;
+
+    // the compare op only matters when depth testing is on
+    depth_stencil_info.depthCompareOp = depthTest ? compareOp : VK_COMPARE_OP_ALWAYS;
+
+    // no depth bounds or stencil testing
+    depth_stencil_info.depthBoundsTestEnable = VK_FALSE;
+    depth_stencil_info.minDepthBounds = 0.0f;
+    depth_stencil_info.maxDepthBounds = 1.0f;
+    depth_stencil_info.stencilTestEnable = VK_FALSE;
+    return depth_stencil_info;
+}
+
 VkPipelineColorBlendAttachmentState color_blend_attachment_state()
 {
     VkPipelineColorBlendAttachmentState color_blend_attachment = {}; // initialise entire struct to 0's
@@ -10,8 +10,10 @@ VkCommandPoolCreateInfo command_pool_create_info(uint32_t queueFamilyIndex, VkCo
 VkCommandBufferAllocateInfo command_buffer_allocate_info(VkCommandPool pool, uint32_t count = 1,
                                                          VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
-VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info(VkShaderStageFlagBits stage,
-                                                                  VkShaderModule shaderModule);
+VkShaderModuleCreateInfo shader_module_create_info(const uint32_t *code, size_t codeSize);
+
+VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info(
+    VkShaderStageFlagBits stage, VkShaderModule shaderModule, const VkSpecializationInfo *specialisationInfo = nullptr);
 
 VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info();
 
@@ -21,6 +23,8 @@ VkPipelineRasterizationStateCreateInfo rasterisation_state_create_info(VkPolygon
 
 VkPipelineMultisampleStateCreateInfo multisampling_state_create_info();
 
+VkPipelineDepthStencilStateCreateInfo depth_stencil_create_info(bool depthTest, bool depthWrite, VkCompareOp compareOp);
+
 VkPipelineColorBlendAttachmentState color_blend_attachment_state();
 
 VkPipelineLayoutCreateInfo pipeline_layout_create_info();
@@ -2,7 +2,135 @@
 
 #include "vulkan/vulkan.h"
 
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
 namespace vulkan_engine
 {
+// We want to immediately abort when there is an error. In normal engines this
+// would give an error message to the user, or perform a dump of state.
+#define VK_CHECK(x)                                                                                                    \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        VkResult err = x;                                                                                              \
+        if (err)                                                                                                       \
+        {                                                                                                              \
+            std::cout << "Detected Vulkan Error: " << err << std::endl;                                                \
+            abort();                                                                                                   \
+        }                                                                                                              \
+    } while (0)
+
 // add main reusable types here
+
+// the most frames we ever allow to be recorded / in flight on the GPU at the same time
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+// what the triangle shaders read for each draw, laid out like their DrawData uniform block
+struct DrawData
+{
+    float offset[2]{0.0f, 0.0f}; // in clip space
+    float scale[2]{1.0f, 1.0f};
+};
+
+// a single draw from the scene's draw list
+struct DrawCommand
+{
+    VkPipeline pipeline;
+    uint32_t vertex_count;
+    uint32_t first_vertex;
+
+    // bound instead of the pipeline when drawing with shader objects
+    VkShaderEXT vertex_shader{VK_NULL_HANDLE};
+    VkShaderEXT fragment_shader{VK_NULL_HANDLE};
+
+    // the draw's data is bound through data_set (null when its shaders read none) with a dynamic offset. It is copied
+    // into the frame allocator as the draw is recorded, unless it was written ahead of time at data_offset
+    VkPipelineLayout layout{VK_NULL_HANDLE};
+    VkDescriptorSet data_set{VK_NULL_HANDLE};
+    DrawData data;
+    bool static_data{false};
+    uint32_t data_offset{0};
+};
+
+// start-up options for the engine, usually filled in from the command line
+struct EngineConfig
+{
+    // how many frames the CPU may record ahead of the GPU (clamped to [2, MAX_FRAMES_IN_FLIGHT])
+    uint32_t frames_in_flight{2};
+
+    // track GPU progress with a Vulkan 1.2 timeline semaphore instead of per-frame fences, when the device supports it
+    bool use_timeline_semaphores{false};
+
+    // FIFO is vsync, use MAILBOX or IMMEDIATE to measure uncapped throughput. Falls back to FIFO when unsupported
+    VkPresentModeKHR present_mode{VK_PRESENT_MODE_FIFO_KHR};
+
+    // minimum number of swapchain images to ask for, 0 lets the driver decide
+    uint32_t min_image_count{0};
+
+    // acquire and present swapchain images on a dedicated thread, so a throttled presentation engine never blocks the
+    // main thread
+    bool use_present_thread{false};
+
+    // record the draw list into secondary command buffers on this many worker threads, 0 records on the main thread
+    uint32_t recording_threads{0};
+
+    // how many times the scene's triangle is drawn each frame, to stress test command recording
+    uint32_t draw_count{1};
+
+    // record one command buffer per swapchain image and resubmit it until something it depends on changes
+    bool use_cached_command_buffers{false};
+
+    // where compiled pipelines are kept between runs, empty disables the on-disk pipeline cache
+    std::string pipeline_cache_path{"pipeline_cache.bin"};
+
+    // compile the rainbow triangle pipeline on a worker thread, drawing with the red triangle until it is ready
+    bool use_async_pipelines{false};
+
+    // how many shader permutations (specialisation constants and raster state) stay compiled before the least recently
+    // used ones are destroyed
+    uint32_t pipeline_permutation_capacity{8};
+
+    // link pipelines from VK_EXT_graphics_pipeline_library parts, so a new combination of known parts appears without
+    // a hitch, and optimise them in the background. Falls back to whole pipelines when unsupported
+    bool use_pipeline_libraries{false};
+
+    // draw with VK_EXT_shader_object instead of pipelines, setting all of the state while recording. Falls back to
+    // pipelines when unsupported
+    bool use_shader_objects{false};
+
+    // at start-up, record this many bind + draw pairs with pipelines and again with shader objects and report what
+    // each costs. 0 skips the benchmark
+    uint32_t bind_benchmark_draws{0};
+
+    // at start-up, load every .spv file in this directory by reading it into a buffer and again by mapping it, and
+    // report what each costs. Empty skips the benchmark
+    std::string shader_load_benchmark_path;
+
+    // at start-up, create this many small vertex and uniform buffers, one at a time, and report how many device memory
+    // allocations they took and how long. 0 skips the benchmark
+    uint32_t allocation_benchmark_buffers{0};
+
+    // at start-up, upload this many MiB into a buffer in small pieces and again as whole images, and report the
+    // throughput of each. 0 skips the benchmark
+    uint32_t upload_benchmark_mib{0};
+
+    // watch the shaders directory and rebuild whatever uses a shader when its .spv file is rewritten, e.g. by building
+    // the Shaders target, swapping the results in without a restart
+    bool hot_reload_shaders{false};
+
+    // compile the shaders from their GLSL sources instead of loading prebuilt SPIR-V, keeping the results in
+    // shader_cache_path so later runs (and the same shader requested again) skip the compiler
+    bool compile_shaders{false};
+    std::string shader_cache_path{"shader_cache"};
+
+    // load shaders from the bundle compiled into the executable instead of the shaders directory, so start-up reads no
+    // shader files and works from any directory. Hot reload watches the files, so it always loads from disk
+#ifdef EMBEDDED_SHADERS_BY_DEFAULT
+    bool use_embedded_shaders{true};
+#else
+    bool use_embedded_shaders{false};
+#endif
+};
 }
\ No newline at end of file
@@ -1,12 +1,155 @@
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #include "VulkanEngine.h"
 
-int main()
+// map the command line spelling of a present mode onto the Vulkan enum
+static bool parse_present_mode(const char *name, VkPresentModeKHR *outPresentMode)
 {
+    if (std::strcmp(name, "fifo") == 0)
+    {
+        *outPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    }
+    else if (std::strcmp(name, "fifo-relaxed") == 0)
+    {
+        *outPresentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    }
+    else if (std::strcmp(name, "mailbox") == 0)
+    {
+        *outPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    }
+    else if (std::strcmp(name, "immediate") == 0)
+    {
+        *outPresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// fill in the engine config from the command line, e.g. `cpp-vulkan --frames-in-flight 3`
+static vulkan_engine::EngineConfig parse_arguments(int argc, char *argv[])
+{
+    vulkan_engine::EngineConfig config;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+        {
+            config.frames_in_flight = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--timeline-semaphores") == 0)
+        {
+            config.use_timeline_semaphores = true;
+        }
+        else if (std::strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc)
+        {
+            if (!parse_present_mode(argv[++i], &config.present_mode))
+            {
+                std::cout << "Unknown present mode " << argv[i] << ", expected fifo, fifo-relaxed, mailbox or immediate"
+                          << std::endl;
+            }
+        }
+        else if (std::strcmp(argv[i], "--image-count") == 0 && i + 1 < argc)
+        {
+            config.min_image_count = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--present-thread") == 0)
+        {
+            config.use_present_thread = true;
+        }
+        else if (std::strcmp(argv[i], "--recording-threads") == 0 && i + 1 < argc)
+        {
+            config.recording_threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--draw-count") == 0 && i + 1 < argc)
+        {
+            config.draw_count = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--cached-command-buffers") == 0)
+        {
+            config.use_cached_command_buffers = true;
+        }
+        else if (std::strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc)
+        {
+            config.pipeline_cache_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--no-pipeline-cache") == 0)
+        {
+            config.pipeline_cache_path.clear();
+        }
+        else if (std::strcmp(argv[i], "--async-pipelines") == 0)
+        {
+            config.use_async_pipelines = true;
+        }
+        else if (std::strcmp(argv[i], "--pipeline-libraries") == 0)
+        {
+            config.use_pipeline_libraries = true;
+        }
+        else if (std::strcmp(argv[i], "--permutation-capacity") == 0 && i + 1 < argc)
+        {
+            config.pipeline_permutation_capacity = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--shader-objects") == 0)
+        {
+            config.use_shader_objects = true;
+        }
+        else if (std::strcmp(argv[i], "--bind-benchmark") == 0 && i + 1 < argc)
+        {
+            config.bind_benchmark_draws = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--shader-load-benchmark") == 0 && i + 1 < argc)
+        {
+            config.shader_load_benchmark_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--allocation-benchmark") == 0 && i + 1 < argc)
+        {
+            config.allocation_benchmark_buffers = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--upload-benchmark") == 0 && i + 1 < argc)
+        {
+            config.upload_benchmark_mib = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--hot-reload") == 0)
+        {
+            config.hot_reload_shaders = true;
+        }
+        else if (std::strcmp(argv[i], "--compile-shaders") == 0)
+        {
+            config.compile_shaders = true;
+        }
+        else if (std::strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc)
+        {
+            config.shader_cache_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--embedded-shaders") == 0)
+        {
+            config.use_embedded_shaders = true;
+        }
+        else if (std::strcmp(argv[i], "--shaders-from-disk") == 0)
+        {
+            config.use_embedded_shaders = false;
+        }
+        else
+        {
+            std::cout << "Ignoring unknown argument: " << argv[i] << std::endl;
+        }
+    }
+
+    return config;
+}
+
+int main(int argc, char *argv[])
+{
+    vulkan_engine::EngineConfig config = parse_arguments(argc, argv);
+
     std::cout << "Starting engine" << std::endl;
     vulkan_engine::VulkanEngine engine;
-    engine.init();
+    engine.init(config);
 
     std::cout << "Running engine" << std::endl;
     engine.run();
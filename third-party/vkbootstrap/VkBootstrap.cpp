@@ -1569,6 +1569,11 @@ detail::Result<Swapchain> SwapchainBuilder::build () const {
 	auto surface_support = surface_support_ret.value ();
 
 	uint32_t image_count = surface_support.capabilities.minImageCount + 1;
+	if (info.min_image_count > 0) {
+		image_count = info.min_image_count;
+		if (image_count < surface_support.capabilities.minImageCount)
+			image_count = surface_support.capabilities.minImageCount;
+	}
 	if (surface_support.capabilities.maxImageCount > 0 && image_count > surface_support.capabilities.maxImageCount) {
 		image_count = surface_support.capabilities.maxImageCount;
 	}
@@ -1693,6 +1698,10 @@ SwapchainBuilder& SwapchainBuilder::set_desired_extent (uint32_t width, uint32_t
 	info.desired_height = height;
 	return *this;
 }
+SwapchainBuilder& SwapchainBuilder::set_desired_min_image_count (uint32_t min_image_count) {
+	info.min_image_count = min_image_count;
+	return *this;
+}
 SwapchainBuilder& SwapchainBuilder::set_desired_format (VkSurfaceFormatKHR format) {
 	info.desired_formats.insert (info.desired_formats.begin (), format);
 	return *this;
@@ -570,6 +570,10 @@ class SwapchainBuilder {
 	// of the window being drawn to.
 	SwapchainBuilder& set_desired_extent (uint32_t width, uint32_t height);
 
+	// Sets the desired minimum image count for the swapchain. Defaults to the surface's minImageCount + 1.
+	// The count is clamped to what the surface supports, and the presentation engine is free to create more images.
+	SwapchainBuilder& set_desired_min_image_count (uint32_t min_image_count);
+
 	// When determining the surface format, make this the first to be used if supported.
 	SwapchainBuilder& set_desired_format (VkSurfaceFormatKHR format);
 	// Add this swapchain format to the end of the list of formats selected from.
@@ -641,6 +645,7 @@ class SwapchainBuilder {
 		std::vector<VkPresentModeKHR> desired_present_modes;
 		bool clipped = true;
 		VkSwapchainKHR old_swapchain = VK_NULL_HANDLE;
+		uint32_t min_image_count = 0;
 		VkAllocationCallbacks* allocation_callbacks = VK_NULL_HANDLE;
 	} info;
 };